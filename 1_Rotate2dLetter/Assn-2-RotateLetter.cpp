@@ -8,12 +8,24 @@
 #include <glfw3.h>    // GL toolkit (create window + context for it)
 #include "GLXtras.h"  // convenience routines
 #include "VecMat.h"   // library for vector/matrix operations
+#include "Program.h"  // Program, Uniform, Attribute
+#include "IndexBuffer.h" // IndexBuffer
+#include "Redraw.h"   // Redraw
 
 vec2 mouseNow; // current mouse position in pixels
 
 // GPU identifiers
 GLuint VAO = 0, VBO = 0, EBO = 0;    // vertex array, vertex buffer, element buffer
-GLuint program = 0;                  // shader program ID
+IndexBuffer indices;                 // triangles in EBO, 16-bit
+Program program;                     // shader program, reflected at link time
+
+// uniforms and attributes, located once the program is linked
+struct {
+    Uniform<mat4> view;
+} uniforms;
+struct {
+    Attribute point, color;
+} attributes;
 
 // 2D locations of letter's vertices
 vec2 points[] = {
@@ -107,25 +119,17 @@ void Display() {
     glClearColor(1, 1, 1, 1); // set background to white
     glClear(GL_COLOR_BUFFER_BIT); // clear screen
 
-    // access GPU buffers, activate shader program
-    glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    // activate shader program and the vertex array (attributes and
+    // triangles, set up by BufferGPU)
+    program.Use();
+    Binds().BindVertexArray(VAO);
 
     // compute rotation matrix based on mouse position
     mat4 view = RotateY(mouseNow.x) * RotateX(mouseNow.y);
-    SetUniform(program, "view", view); // pass matrix to shader
-
-    // associate position input to shader with position array in vertex buffer
-    VertexAttribPointer(program, "point", 2, 0, (void *) 0);
-
-    // associate color input to shader with color array in vertex buffer
-    VertexAttribPointer(program, "color", 3, 0, (void *) sizeof(points));
+    uniforms.view.Set(view); // pass matrix to shader
 
     // draw elements using EBO
-    int nVertices = sizeof(triangles) / sizeof(int);
-    glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, 0);
-    // last arg 0 means use EBO
+    indices.Draw();
 
     glFlush(); // ensure all commands are completed
 }
@@ -148,13 +152,17 @@ void BufferGPU() {
     // copy color data to the GPU
     glBufferSubData(GL_ARRAY_BUFFER, sPoints, sColors, colors);
 
+    // associate position and color inputs to shader with their arrays in
+    // the vertex buffer, recorded in the VAO
+    attributes.point.Pointer(2, 0, (void *) 0);
+    attributes.color.Pointer(3, 0, (void *) (size_t) sPoints);
+
     // make EBO to store triangles, set to active
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-    // copy triangle index data to GPU
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangles) * sizeof(int),
-                 triangles, GL_STATIC_DRAW);
+    // copy triangle index data to GPU (as 16-bit indices: few vertices)
+    indices.Buffer(triangles, sizeof(triangles) / sizeof(int3), nPoints, NULL);
 }
 
 void StandardizePoints(float s = 1) {
@@ -169,19 +177,23 @@ void StandardizePoints(float s = 1) {
 
 // mouse movement callback
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
-    if (leftDown)
+    if (leftDown) {
         mouseNow = vec2(x, y);
+        Redraw().Dirty();
+    }
 }
 
 
 int main() {
     GLFWwindow *w = InitGLFW(100, 100, 800, 800, "Rotate Letter");
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
-    if (!program) {
+    if (!program.Link(&vertexShader, &pixelShader)) {
         printf("can't init shader program\n");
         getchar();
         return 0;
     }
+    uniforms.view = program.GetUniform<mat4>("view");
+    attributes.point = program.GetAttribute("point");
+    attributes.color = program.GetAttribute("color");
     // register mouse movement callback
     RegisterMouseMove(MouseMove);
 
@@ -192,11 +204,17 @@ int main() {
     BufferGPU();
 
     // event loop
+    Redraw().Attach(w);
     while (!glfwWindowShouldClose(w)) {
+        Redraw().Wait(); // until input changes the view
+        if (!Redraw().Due())
+            continue;
         Display();
         glfwSwapBuffers(w);
-        glfwPollEvents();
+        Binds().EndFrame();
     }
+    Binds().Report();
+    Redraw().Report();
 
     // unbind vertex buffer, free GPU memory
     glBindBuffer(GL_ARRAY_BUFFER, 0);
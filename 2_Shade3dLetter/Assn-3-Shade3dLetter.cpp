@@ -10,10 +10,22 @@
 #include "GLXtras.h"  // convenience routines
 #include "VecMat.h"   // library for vector/matrix operations
 #include "Camera.h"   // camera class
+#include "Program.h"  // Program, Uniform, Attribute
+#include "IndexBuffer.h" // IndexBuffer
+#include "Redraw.h"   // Redraw
 
 // GPU identifiers
 GLuint VAO = 0, VBO = 0, EBO = 0;    // vertex array, vertex buffer, element buffer
-GLuint program = 0;                  // shader program ID
+IndexBuffer indices;                 // triangles in EBO, 16-bit
+Program program;                     // shader program, reflected at link time
+
+// uniforms and attributes, located once the program is linked
+struct {
+    Uniform<mat4> modelview, persp;
+} uniforms;
+struct {
+    Attribute point, color;
+} attributes;
 
 // window size
 int winWidth = 800;
@@ -223,25 +235,17 @@ void Display() {
     glClearColor(1, 1, 1, 1); // set background to white
     glClear(GL_COLOR_BUFFER_BIT); // clear screen
 
-    // access GPU buffers, activate shader program
-    glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    // activate shader program and the vertex array (attributes and
+    // triangles, set up by BufferGPU)
+    program.Use();
+    Binds().BindVertexArray(VAO);
 
     // set modelview and perspective matrices in vertex shader
-    SetUniform(program, "modelview", camera.modelview);
-    SetUniform(program, "persp", camera.persp);
-
-    // associate position input to shader with position array in vertex buffer
-    VertexAttribPointer(program, "point", 3, 0, (void *) 0);
-
-    // associate color input to shader with color array in vertex buffer
-    VertexAttribPointer(program, "color", 3, 0, (void *) sizeof(points));
+    uniforms.modelview.Set(camera.modelview);
+    uniforms.persp.Set(camera.persp);
 
     // draw elements using EBO
-    int nVertices = sizeof(triangles) / sizeof(int);
-    glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, 0);
-    // last arg 0 means use EBO
+    indices.Draw();
 
    // Draw arcball to control camera rotation
     glDisable(GL_DEPTH_TEST);
@@ -270,13 +274,17 @@ void BufferGPU() {
     // copy color data to the GPU
     glBufferSubData(GL_ARRAY_BUFFER, sPoints, sColors, colors);
 
+    // associate position and color inputs to shader with their arrays in
+    // the vertex buffer, recorded in the VAO
+    attributes.point.Pointer(3, 0, (void *) 0);
+    attributes.color.Pointer(3, 0, (void *) (size_t) sPoints);
+
     // make EBO to store triangles, set to active
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-    // copy triangle index data to GPU
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangles) * sizeof(int),
-                 triangles, GL_STATIC_DRAW);
+    // copy triangle index data to GPU (as 16-bit indices: few vertices)
+    indices.Buffer(triangles, sizeof(triangles) / sizeof(int3), nPoints, points);
 }
 
 void StandardizePoints(float s = 1) {
@@ -293,31 +301,39 @@ void MouseButton(float x, float y, bool left, bool down) {
     if (left && down)
         camera.Down(x, y, Shift(), Control());
     else camera.Up();
+    Redraw().Dirty();
 }
 
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
-    if (leftDown)
+    if (leftDown) {
         camera.Drag(x, y);
+        Redraw().Dirty();
+    }
 }
 
 void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
+    Redraw().Dirty();
 }
 
 // update GL + camera when resize app
 void Resize(int width, int height) {
     glViewport(0, 0, width, height);
     camera.Resize(width, height);
+    Redraw().Dirty();
 }
 
 int main() {
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight, "Shade 3d Letter");
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
-    if (!program) {
+    if (!program.Link(&vertexShader, &pixelShader)) {
         printf("can't init shader program\n");
         getchar();
         return 0;
     }
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    attributes.point = program.GetAttribute("point");
+    attributes.color = program.GetAttribute("color");
 
     // register callbacks
     RegisterMouseMove(MouseMove);
@@ -332,11 +348,17 @@ int main() {
     BufferGPU();
 
     // event loop
+    Redraw().Attach(w);
     while (!glfwWindowShouldClose(w)) {
+        Redraw().Wait(); // until input changes the view
+        if (!Redraw().Due())
+            continue;
         Display();
         glfwSwapBuffers(w);
-        glfwPollEvents();
+        Binds().EndFrame();
     }
+    Binds().Report();
+    Redraw().Report();
 
     // unbind vertex buffer, free GPU memory
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -10,12 +10,28 @@
 #include "VecMat.h"   // library for vector/matrix operations
 #include "Camera.h"   // camera class
 #include "Draw.h"     // Screen drawing, Star
-#include "IO.h"       // ReadTexture
+#include "TextureCache.h" // CachedTexture, BenchmarkTextureCache, TextureStats
+#include "SelfCheck.h" // RunSelfChecks
 #include "Widgets.h"  // Mover
+#include "Program.h"  // Program, Uniform, Attribute
+#include "IndexBuffer.h" // IndexBuffer
+#include "LightBlock.h" // LightBlock
+#include "ClusteredLights.h" // ClusteredLights, AddLightCode
+#include "Redraw.h"   // Redraw
 
 // GPU identifiers
 GLuint VAO = 0, VBO = 0, EBO = 0;    // vertex array, vertex buffer, element buffer
-GLuint program = 0;                  // shader program ID
+IndexBuffer indices;                 // triangles in EBO, 16-bit
+Program program;                     // shader program, reflected at link time
+
+// uniforms and attributes, located once the program is linked
+struct {
+    Uniform<mat4> modelview, persp;
+    Uniform<int> textureImage;
+} uniforms;
+struct {
+    Attribute point, uv;
+} attributes;
 
 // window size
 int winWidth = 800;
@@ -161,7 +177,7 @@ int3 triangles[] = {
 // texture image
 const char *textureFilename =
         "/Users/nadin/Documents/Graphics/Apps/Textures/christmas-tree-574742_1920.jpg";
-GLuint textureName = 0; // id for texture image, set by ReadTexture
+GLuint textureName = 0; // id for texture image, set by CachedTexture
 int textureUnit = 0; // id for GPU image buffer, may be freely set
 
 // Moving lights
@@ -172,6 +188,8 @@ void *picked = NULL; // user selection (&mover or &camera)
 vec3 lights[] = {{.5, 0, 1},
                  {1,  1, 0}};
 const int nLights = sizeof(lights) / sizeof(vec3);
+LightBlock lightBlock; // the lights, in a uniform buffer shared by programs
+ClusteredLights clusters; // or, with -lights N or K, listed per cell of the view volume
 
 // vertex shader: operations before the rasterizer
 const char *vertexShader = R"(
@@ -197,8 +215,6 @@ const char *pixelShader = R"(
 	#version 330 core
 
     uniform sampler2D textureImage;       // access to 2D texture image
-    uniform int nLights = 0;              // number of lights in scene
-    uniform vec3 lights[20];              // array of light (max = 20)
 
     uniform float amb = 0.3;             // ambient term
     uniform float dif = 0.8;             // diffuse weight
@@ -212,20 +228,27 @@ const char *pixelShader = R"(
         vec3 dx = dFdx(vPoint), dy = dFdy(vPoint); // vPoint change, horizontally/vertically
         vec3 N = normalize(cross(dx, dy)); // unit-length surface normal
         vec3 E = normalize(vPoint);         // eye direction
-        float diffuseTotal = 0;
-        float specularTotal = 0;
-
-        for (int i = 0; i < nLights; i++) {
-            vec3 L = normalize(lights[i] - vPoint); // unit-length light vector
+        vec3 diffuseTotal = vec3(0);
+        vec3 specularTotal = vec3(0);
+
+        int first, n = LightCount(vPoint, first);
+        for (int k = 0; k < n; k++) {
+            Light light = GetLight(first, k);
+            vec3 l = light.position.xyz - vPoint;
+            float range = light.position.w;
+            float a = light.color.a;           // intensity, faded by range
+            if (range > 0) a *= pow(clamp(1 - length(l) / range, 0, 1), 2);
+            vec3 c = a * light.color.rgb;      // light color
+            vec3 L = normalize(l);              // unit-length light vector
             vec3 R = reflect(-L, N);            // reflection vector
             float d = abs(dot(N, L)); // diffuse term
-            diffuseTotal += d;
+            diffuseTotal += c * d;
             float h = max(0.0, dot(R, E));      // highlight term
             float s = pow(h, 100.0);            // specular term
-            specularTotal += s;
+            specularTotal += c * s;
         }
 
-        float intensity = min(1, amb + dif * diffuseTotal) + spc * specularTotal; // weighted sum
+        vec3 intensity = min(vec3(1), amb + dif * diffuseTotal) + spc * specularTotal; // weighted sum
         vec3 col = texture(textureImage, vUv).rgb; // vUv is parametric texture map location
 		pColor = vec4(intensity * col, 1); // opaque
 	}
@@ -241,32 +264,26 @@ void Display() {
     glClearColor(1, 1, 1, 1); // set background to white
     glClear(GL_COLOR_BUFFER_BIT); // clear screen
 
-    // access GPU buffers, activate shader program
-    glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    // activate shader program and the vertex array (attributes and
+    // triangles, set up by BufferGPU)
+    program.Use();
+    Binds().BindVertexArray(VAO);
 
     // set modelview and perspective matrices in vertex shader
-    SetUniform(program, "modelview", camera.modelview);
-    SetUniform(program, "persp", camera.persp);
-
-    // associate vertex positions with the 'point' attribute in vertex shader
-    VertexAttribPointer(program, "point", 3, 0, (void *) 0);
-
-    // associate uv coordinates with the 'uv' attribute in vertex shader
-    VertexAttribPointer(program, "uv", 2, 0, (void *) sizeof(points));
+    uniforms.modelview.Set(camera.modelview);
+    uniforms.persp.Set(camera.persp);
 
     // inform pixel shader which image buffer to read from
-    SetUniform(program, "textureImage", textureUnit);
+    uniforms.textureImage.Set(textureUnit);
 
     // bind 2D texture, activate appropriate texture unit (enable GPU buffer)
-    glBindTexture(GL_TEXTURE_2D, textureName);
-    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    Binds().BindTexture(textureUnit, textureName);
+
+    // transform lights to eye space, if they or the camera moved
+    clusters.Update(lightBlock, lights, nLights, camera.modelview, camera.persp);
 
     // draw elements using EBO
-    int nVertices = sizeof(triangles) / sizeof(int);
-    glDrawElements(GL_TRIANGLES, nVertices, GL_UNSIGNED_INT, 0);
-    // last arg 0 means use EBO
+    indices.Draw();
 
     // draw arcball to control camera rotation
     glDisable(GL_DEPTH_TEST); // disable depth testing before drawing
@@ -275,11 +292,6 @@ void Display() {
         camera.arcball.Draw(Control());
     }
 
-    // update/transform lights
-    SetUniform(program, "nLights", nLights);
-    SetUniform3v(program, "lights", nLights, (float *) lights,
-                 camera.modelview);
-
     // draw each light as a golden asterisk
     UseDrawShader(camera.fullview); // use draw shader for rendering
     for (int i = 0; i < nLights; i++)
@@ -307,13 +319,17 @@ void BufferGPU() {
     // copy uv data to the GPU
     glBufferSubData(GL_ARRAY_BUFFER, sPoints, sUvs, uvs);
 
+    // associate vertex positions and uv coordinates with the 'point' and
+    // 'uv' attributes in vertex shader, recorded in the VAO
+    attributes.point.Pointer(3, 0, (void *) 0);
+    attributes.uv.Pointer(2, 0, (void *) (size_t) sPoints);
+
     // make EBO to store triangles, set to active
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-    // copy triangle index data to GPU
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangles) * sizeof(int),
-                 triangles, GL_STATIC_DRAW);
+    // copy triangle index data to GPU (as 16-bit indices: few vertices)
+    indices.Buffer(triangles, sizeof(triangles) / sizeof(int3), nPoints, points);
 }
 
 void StandardizePoints(float s = 1) {
@@ -339,6 +355,7 @@ void MouseButton(float x, float y, bool left, bool down) {
         picked = &camera;
         camera.Down(x, y, Shift(), Control());
     }
+    Redraw().Dirty();
 }
 
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
@@ -348,37 +365,75 @@ void MouseMove(float x, float y, bool leftDown, bool rightDown) {
         } else if (picked == &camera) {
             camera.Drag(x, y);
         }
+        Redraw().Dirty();
     }
 }
 
 void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
+    Redraw().Dirty();
+}
+
+void Keyboard(int k, bool press, bool shift, bool control) {
+    if (press) {
+        if (k == 'K') {
+            clusters.enabled = !clusters.enabled;
+            printf("clustered lights %s\n", clusters.enabled ? "on" : "off");
+        }
+        Redraw().Dirty();
+    }
 }
 
 // update GL + camera when resize app
 void Resize(int width, int height) {
     glViewport(0, 0, width, height);
     camera.Resize(width, height);
+    Redraw().Dirty();
 }
 
-int main() {
+int main(int ac, char **av) {
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight,
                              "Texture 3d Letter");
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
-    if (!program) {
+    std::string pixelCode = AddLightCode(pixelShader); // with LightCount, GetLight
+    const char *pixelLit = pixelCode.c_str();
+    if (!program.Link(&vertexShader, &pixelLit)) {
         printf("can't init shader program\n");
         getchar();
         return 0;
     }
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    uniforms.textureImage = program.GetUniform<int>("textureImage");
+    lightBlock.Attach(program);
+    clusters.Attach(program);
+    attributes.point = program.GetAttribute("point");
+    attributes.uv = program.GetAttribute("uv");
 
     // register callbacks
     RegisterMouseMove(MouseMove);
     RegisterMouseButton(MouseButton);
     RegisterMouseWheel(MouseWheel);
     RegisterResize(Resize);
+    RegisterKeyboard(Keyboard);
+    printf("Usage:\n    K: toggle clustered lights\n    Run with -lights N to add N lights with a range\n"
+           "    Run with -texbench to time the texture cache against decoding\n");
+    if (int n = LightsArg(ac, av)) {
+        clusters.Scatter(n, vec3(-1, -1, -1), vec3(1, 1, 1));
+        clusters.enabled = true;
+    }
+
+    // compare decoding the texture image with uploading its cache, check, then quit
+    for (int i = 1; i < ac; i++)
+        if (!strcmp(av[i], "-texbench")) {
+            BenchmarkTextureCache(textureFilename);
+            bool ok = RunSelfChecks();
+            glfwDestroyWindow(w);
+            glfwTerminate();
+            return ok ? 0 : 1;
+        }
 
-    // read texture image from file
-    ReadTexture(textureFilename, &textureName);
+    // read texture image from its cache (decoded and compressed on first run)
+    textureName = CachedTexture(textureFilename);
 
     // initialize uv coordinates
     SetUvs();
@@ -390,15 +445,26 @@ int main() {
     BufferGPU();
 
     // event loop
+    Redraw().Attach(w);
     while (!glfwWindowShouldClose(w)) {
+        Redraw().Wait(); // until input changes the view
+        if (!Redraw().Due())
+            continue;
         Display();
         glfwSwapBuffers(w);
-        glfwPollEvents();
+        Binds().EndFrame();
     }
+    Binds().Report();
+    lightBlock.Report();
+    clusters.Report();
+    Redraw().Report();
+    TextureStats().Report();
 
     // unbind vertex buffer, free GPU memory
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glDeleteBuffers(1, &VBO);
+    lightBlock.Release();
+    clusters.Release();
     glfwDestroyWindow(w);
     glfwTerminate();
 }
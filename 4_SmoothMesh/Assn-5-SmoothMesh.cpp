@@ -7,25 +7,56 @@
 #include <glfw3.h>    // GL toolkit (create window + rendering context for it)
 #include "GLXtras.h"  // convenience routines
 #include "VecMat.h"   // library for vector/matrix operations
+#include "Program.h"  // Program, Uniform
 #include "Camera.h"   // camera class
 #include "Draw.h"     // Screen drawing, Star
 #include "IO.h"       // ReadTexture
 #include "Widgets.h"  // Mover
+#include "MeshCache.h" // LoadCachedMesh
+#include "VertexLayout.h" // BufferMeshVertices, VertexFormatArg
+#include "IndexBuffer.h" // IndexBuffer
+#include "MeshStream.h" // StreamCachedMesh
+#include "AssetCache.h" // AssetCache, MeshAsset, TextureAsset
+#include "AsyncLoader.h" // AsyncLoader, AsyncArg
+#include "LightBlock.h" // LightBlock
+#include "ClusteredLights.h" // ClusteredLights, AddLightCode, LightsArg
+#include "Redraw.h"   // Redraw, ContinuousArg
+#include "SelfCheck.h" // RunSelfChecks
 #include <vector>     // Dynamic arrays for mesh
+#include <string.h>   // strcmp
+#include <chrono>     // steady_clock
 
 // GPU identifiers
 GLuint VAO = 0, VBO = 0, EBO = 0;    // vertex array, vertex buffer, element buffer
-GLuint program = 0;                  // shader program ID
+Program program;                     // shader program, reflected at link time
+
+// uniforms, located once the program is linked
+struct {
+    Uniform<mat4> modelview, persp;
+    Uniform<int> textureImage;
+} uniforms;
 
 // display
 int winWidth = 800, winHeight = 800;
 Camera camera(0, 0, winWidth, winHeight, vec3(15, -30, 0), vec3(0, 0, -5), 30);
 
-// dynamic arrays to read OBJ mesh file
-vector<vec3> points;    // vertex locations
-vector<vec3> normals;   // surface normals
-vector<vec2> uvs;       // texture coordinates
-vector<int3> triangles; // triplets of vertex indices
+// OBJ mesh on the GPU, from its binary cache: vertex locations, surface
+// normals, texture coordinates, and triangles as 16-bit meshlets where possible
+AssetCache assets;
+std::shared_ptr<MeshAsset> asset;
+
+// how vertices are packed in the VBO (see VertexFormatArg), and where
+VertexFormat vertexFormat = VertexFormat::Quantized;
+VertexLayout layout;
+
+// if run with -async, mesh and texture are read by a worker pool while
+// placeholders are drawn
+AsyncLoader loader(assets);
+bool async = false;
+
+// or, if run with -stream, mesh uploaded a chunk per frame, drawn as it arrives
+MeshStream stream;
+bool streaming = false;
 
 // OBJ filename
 const char *objFilename = "/Users/nadin/Documents/Graphics/Apps/Assets/pear.obj";
@@ -33,12 +64,14 @@ const char *objFilename = "/Users/nadin/Documents/Graphics/Apps/Assets/pear.obj"
 // texture image
 const char *textureFilename =
         "/Users/nadin/Documents/Graphics/Apps/Assets/pear_color.jpg";
-GLuint textureName = 0; // id for texture image, set by ReadTexture
+std::shared_ptr<TextureAsset> texture; // GPU texture image
 int textureUnit = 0; // id for GPU image buffer, may be freely set
 
 // movable lights
 vec3 lights[] = { {.5, 0, 1}, {1, 1, 0} };
 const int nLights = sizeof(lights)/sizeof(vec3);
+LightBlock lightBlock; // the lights, in a uniform buffer shared by programs
+ClusteredLights clusters; // or, with -lights N or K, listed per cell of the view volume
 
 // interaction
 void *picked = NULL;	// if non-null: light or camera
@@ -47,18 +80,22 @@ Mover mover;
 // Shaders
 const char *vertexShader = R"(
 	#version 330
-	in vec3 point;
-    in vec3 normal;
-	in vec2 uv;
+	layout(location = 0) in vec3 point;
+	layout(location = 1) in vec3 normal;
+	layout(location = 2) in vec2 uv;
 
 	out vec3 vPoint;
 	out vec2 vUv;
     out vec3 vNormal;
 	uniform mat4 modelview, persp;
+	uniform vec3 pointScale = vec3(1), pointOffset = vec3(0); // undo quantization
+	uniform bool octNormals = false;                           // normal.xy octahedral
 
 	void main() {
-		vPoint = (modelview * vec4(point, 1)).xyz;
-        vNormal = (modelview * vec4(normal,0)).xyz;
+		vec3 p = pointOffset + pointScale * point;
+		vec3 n = octNormals ? OctDecode(normal.xy) : normal;
+		vPoint = (modelview * vec4(p, 1)).xyz;
+        vNormal = (modelview * vec4(n,0)).xyz;
 		gl_Position = persp * vec4(vPoint, 1);
 		vUv = uv;
 	}
@@ -71,21 +108,26 @@ const char *pixelShader = R"(
     in vec3 vNormal;
 	out vec4 pColor;
 	uniform sampler2D textureImage;
-	uniform int nLights = 0;
-	uniform vec3 lights[20];
 	uniform float amb = .1, dif = .8, spc =.7;					// ambient, diffuse, specular
 	void main() {
-		float d = 0, s = 0;
+		vec3 d = vec3(0), s = vec3(0);
 		vec3 N = normalize(vNormal);						    // unit-length normal
 		vec3 E = normalize(vPoint);								// eye vector
-		for (int i = 0; i < nLights; i++) {
-			vec3 L = normalize(lights[i]-vPoint);				// light vector
+		int first, n = LightCount(vPoint, first);
+		for (int k = 0; k < n; k++) {
+			Light light = GetLight(first, k);
+			vec3 l = light.position.xyz-vPoint;
+			float range = light.position.w;
+			float a = light.color.a;						// intensity, faded by range
+			if (range > 0) a *= pow(clamp(1-length(l)/range, 0, 1), 2);
+			vec3 c = a*light.color.rgb;
+			vec3 L = normalize(l);								// light vector
 			vec3 R = reflect(L, N);					      	    // highlight vector
-			d += max(0, dot(N, L));								// one-sided diffuse
+			d += c*max(0, dot(N, L));							// one-sided diffuse
 			float h = max(0, dot(R, E));						// highlight term
-			s += pow(h, 100);									// specular term
+			s += c*pow(h, 100);									// specular term
 		}
-		float ads = clamp(amb+dif*d+spc*s, 0, 1);
+		vec3 ads = clamp(amb+dif*d+spc*s, 0, 1);
 		pColor = vec4(ads*texture(textureImage, vUv).rgb, 1);
 	}
 )";
@@ -100,29 +142,30 @@ void Display(GLFWwindow *w) {
     glClearColor(1, 1, 1, 1); // set background to white
     glClear(GL_COLOR_BUFFER_BIT); // clear screen
 
-    // access GPU buffers, activate shader program
-    glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    // upload another chunk of a streamed mesh
+    if (streaming)
+        stream.Step();
 
-    // set pointers
-    VertexAttribPointer(program, "point", 3, 0, (void*)0);
-    VertexAttribPointer(program, "uv", 2, 0, (void*)(points.size() * sizeof(vec3)));
-    VertexAttribPointer(program, "normal", 3, 0, (void*)((points.size() * sizeof(vec3)) + (uvs.size() * sizeof(vec2))));
+    // activate shader program and the mesh's vertex array (attributes and
+    // triangles, captured at upload); set dequantization
+    program.Use();
+    Binds().BindVertexArray(VAO);
+    layout.SetUniforms(program);
 
     // update matrices and light
-    SetUniform(program, "modelview", camera.modelview);
-    SetUniform(program, "persp", camera.persp);
-    SetUniform(program, "nLights", nLights);
-    SetUniform3v(program, "lights", nLights, (float *) lights, camera.modelview);
+    uniforms.modelview.Set(camera.modelview);
+    uniforms.persp.Set(camera.persp);
+    clusters.Update(lightBlock, lights, nLights, camera.modelview, camera.persp); // if moved
 
     // bind 2D texture, activate appropriate texture unit (enable GPU buffer)
-    glActiveTexture(GL_TEXTURE0 + textureUnit);
-    glBindTexture(GL_TEXTURE_2D, textureName);
-    SetUniform(program, "textureImage", textureUnit);
+    Binds().BindTexture(textureUnit, texture ? texture->textureName : 0);
+    uniforms.textureImage.Set(textureUnit);
 
     // render for MAC
-     glDrawElements(GL_TRIANGLES, triangles.size() *3, GL_UNSIGNED_INT, 0);
+    if (streaming)
+        glDrawElements(GL_TRIANGLES, stream.nDrawable * 3, GL_UNSIGNED_INT, 0);
+    else if (asset)
+        asset->indices.Draw();
 
     glDisable(GL_DEPTH_TEST);
     UseDrawShader(camera.fullview);
@@ -149,6 +192,7 @@ void MouseButton(float x, float y, bool left, bool down) {
         }
     }
     else camera.Up();
+    Redraw().Dirty();
 }
 
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
@@ -157,87 +201,187 @@ void MouseMove(float x, float y, bool leftDown, bool rightDown) {
             mover.Drag((int) x, (int) y, camera.modelview, camera.persp);
         if (picked == &camera)
             camera.Drag(x, y);
+        Redraw().Dirty();
     }
 }
 
 void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
+    Redraw().Dirty();
+}
+
+void Keyboard(int k, bool press, bool shift, bool control) {
+    if (press && k == 'K') {
+        clusters.enabled = !clusters.enabled;
+        printf("clustered lights %s\n", clusters.enabled ? "on" : "off");
+        Redraw().Dirty();
+    }
+}
+
+// ms per frame lit by 1 to 10,000 lights scattered about the mesh, their
+// ranges shrinking so that a point is lit by a few: forward (every pixel
+// loops over all the lights, at most 256) and clustered, with the time to
+// assign them to clusters and the lights listed per cluster; each frame
+// updates the lights as a moving camera would
+void BenchmarkLights(GLFWwindow *w) {
+    const int counts[] = {1, 10, 100, 1000, 10000}, nFrames = 20;
+    auto TimeFrames = [w](bool clustered) {
+        typedef std::chrono::steady_clock Clock;
+        clusters.enabled = clustered;
+        Clock::time_point start;
+        for (int f = -3; f < nFrames; f++) {
+            if (!f) {
+                glFinish();
+                start = Clock::now();
+            }
+            // as with a moving camera: lights re-sent, and reassigned if clustered
+            clusters.Dirty();
+            Display(w);
+        }
+        glFinish();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / nFrames;
+    };
+    printf("%7s %10s %10s %10s (ms per frame) %10s\n", "lights", "forward", "clustered", "assign",
+           "per cluster");
+    for (int n : counts) {
+        clusters.Scatter(n, vec3(-1, -1, -1), vec3(1, 1, 1));
+        double forward = TimeFrames(false), clustered = TimeFrames(true);
+        printf("%7d %10.2f%s %9.2f %10.3f %25.1f\n", n, forward, n > LightBlock::maxLights ? "*" : " ",
+               clustered, clusters.AssignMs(), clusters.LightsPerCluster());
+    }
+    printf("* lit by the first %d lights only\n", LightBlock::maxLights);
+    clusters.Scatter(0, vec3(), vec3());
+    clusters.enabled = false;
 }
 
 // Initialization
-void BufferVertices() {
-    // make GPU buffers for points and colors, set to active
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    // allocate/load memory for points, uvs, normals
-    size_t sPoints = points.size()*sizeof(vec3);
-    size_t sUvs = uvs.size()*sizeof(vec2);
-    size_t sNormals = normals.size()*sizeof(vec3);
-    size_t sTotal = sPoints + sUvs + sNormals;
-    glBufferData(GL_ARRAY_BUFFER, sTotal, NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sPoints, points.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sPoints, sUvs, uvs.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sPoints+sUvs, sNormals, normals.data());
-
-    // make EBO to store triangles, set to active
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-    // copy triangle index data to GPU
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(int3),
-                 triangles.data(), GL_STATIC_DRAW);
+bool UseMesh(std::shared_ptr<MeshAsset> a) {
+    // draw with the asset's buffers: points, normals, uvs packed per
+    // vertexFormat, triangle indices 16-bit where they fit
+    if (!a)
+        return false;
+    asset = a;
+    VAO = a->VAO, VBO = a->VBO, EBO = a->EBO;
+    layout = a->layout;
+    return true;
 }
 
 void Resize(int width, int height) {
     camera.Resize(width, height);
     glViewport(0, 0, width, height);
+    Redraw().Dirty();
 }
 
 // Application
 int main(int ac, char **av) {
-    // read OBJ file
-    if (!ReadAsciiObj(objFilename, points, triangles, &normals, &uvs))
-        printf("can’t read %s\n", objFilename);
-
-    // if normals are missing, generate them
-    if (normals.empty()) {
-        SetVertexNormals(points, triangles, normals);
+    // generate normals if missing, fit model into the window (baked into cache)
+    MeshLoadOptions opts;
+    opts.standardize = .8f;
+    vertexFormat = VertexFormatArg(ac, av);
+    async = AsyncArg(ac, av);
+    Redraw().onDemand = !ContinuousArg(ac, av);
+
+    // compare cold ASCII load with warm mapped load, check, then quit
+    if (ac > 1 && !strcmp(av[1], "-bench")) {
+        BenchmarkMeshCache(objFilename, opts);
+        return RunSelfChecks(objFilename, opts) ? 0 : 1;
     }
 
+    streaming = ac > 1 && !strcmp(av[1], "-stream");
+
     // enable anti-alias, init app window and GL context
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight, "Smooth Mesh");
 
     // init shader program, set GPU buffer, read texture image
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
-
-    // fit modal into the window
-    Standardize(points.data(), points.size(), .8f);
-
-    // allocate vertex memory in the GPU
-    BufferVertices();
+    std::string vertexCode = AddOctCode(vertexShader); // with OctDecode
+    std::string pixelCode = AddLightCode(pixelShader); // with LightCount, GetLight
+    const char *vertexOct = vertexCode.c_str(), *pixelLit = pixelCode.c_str();
+    program.Link(&vertexOct, &pixelLit);
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    lightBlock.Attach(program);
+    clusters.Attach(program);
+    uniforms.textureImage = program.GetUniform<int>("textureImage");
+
+    // allocate vertex memory in the GPU (if streaming, filled by Display)
+    if (streaming) {
+        if (!StreamCachedMesh(objFilename, stream, opts))
+            printf("can’t read %s\n", objFilename);
+        VAO = stream.VAO, VBO = stream.VBO, EBO = stream.EBO;
+        // streamed as the cache stores it
+        layout = SeparateLayout(stream.nPoints, stream.hasNormals, stream.hasUvs, stream.hasTangents);
+        glBindVertexArray(VAO);
+        layout.Capture(VBO);
+    }
+    else if (async) {
+        // placeholder until the worker pool has read the mesh
+        UseMesh(assets.PlaceholderMesh());
+        loader.Mesh(objFilename, opts, vertexFormat, 1, UseMesh);
+    }
+    // map cached mesh (parse OBJ and write the cache on first run)
+    else if (!UseMesh(assets.Mesh(objFilename, opts, vertexFormat)))
+        printf("can’t read %s\n", objFilename);
 
-    // read texture
-    ReadTexture(textureFilename, &textureName);
+    // read texture (if async, decoded by the worker pool, a placeholder meanwhile)
+    if (async) {
+        texture = assets.PlaceholderTexture();
+        loader.Texture(textureFilename, [](std::shared_ptr<TextureAsset> t) { if (t) texture = t; });
+    }
+    else
+        texture = assets.Texture(textureFilename);
 
     // callbacks
     RegisterMouseMove(MouseMove);
     RegisterMouseButton(MouseButton);
     RegisterMouseWheel(MouseWheel);
     RegisterResize(Resize);
+    RegisterKeyboard(Keyboard);
+    printf("Usage:\n    K: toggle clustered lights\n    Run with -lights N to add N lights with a range\n"
+           "    Run with -lightbench to time forward and clustered lighting, 1 to 10,000 lights\n");
+    if (int n = LightsArg(ac, av)) {
+        clusters.Scatter(n, vec3(-1, -1, -1), vec3(1, 1, 1));
+        clusters.enabled = true;
+    }
+    if (ac > 1 && !strcmp(av[1], "-lightbench") && asset) {
+        BenchmarkLights(w);
+        asset = NULL;
+        texture = NULL;
+        lightBlock.Release();
+        clusters.Release();
+        glfwDestroyWindow(w);
+        glfwTerminate();
+        return 0;
+    }
 
     // event loop
+    Redraw().Attach(w);
     while (!glfwWindowShouldClose(w)) {
-        glfwPollEvents();
+        // until input changes the view, unless a stream or assets loading change the mesh
+        bool busy = (streaming && !stream.Done() && !stream.failed) || loader.Pending() > 0;
+        Redraw().Wait(busy);
+        if (loader.Update()) // upload and swap in what the worker pool has read
+            Redraw().Dirty();
+        if (!Redraw().Due(busy))
+            continue;
         Display(w);
         glfwSwapBuffers(w);
+        loader.FrameDone();
+        Binds().EndFrame();
     }
+    Binds().Report();
+    lightBlock.Report();
+    clusters.Report();
+    Redraw().Report();
+    TextureStats().Report();
 
-    // unbind vertex buffer, free GPU memory
+    // unbind vertex buffer, free GPU memory (the stream's VAO, VBO and EBO)
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &VBO);
+    if (streaming)
+        stream.Close();
+    asset = NULL;
+    texture = NULL;
+    lightBlock.Release();
+    clusters.Release();
     glfwDestroyWindow(w);
     glfwTerminate();
 }
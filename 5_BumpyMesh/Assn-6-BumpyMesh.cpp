@@ -7,44 +7,78 @@
 #include <glfw3.h>    // GL toolkit (create window + rendering context for it)
 #include "GLXtras.h"  // convenience routines
 #include "VecMat.h"   // library for vector/matrix operations
+#include "Program.h"  // Program, Uniform
 #include "Camera.h"   // camera class
 #include "Draw.h"     // Screen drawing, Star
 #include "IO.h"       // ReadTexture
 #include "Widgets.h"  // Mover
+#include "MeshCache.h" // LoadCachedMesh
+#include "VertexLayout.h" // BufferMeshVertices, VertexFormatArg
+#include "IndexBuffer.h" // IndexBuffer
+#include "AssetCache.h" // AssetCache, MeshAsset, TextureAsset
+#include "AsyncLoader.h" // AsyncLoader, AsyncArg
+#include "LightBlock.h" // LightBlock
+#include "ClusteredLights.h" // ClusteredLights, AddLightCode, LightsArg
+#include "Redraw.h"   // Redraw, ContinuousArg
+#include "GpuProfiler.h" // GpuProfiler, GpuCsvArg
+#include "SelfCheck.h" // RunSelfChecks
 #include <vector>     // Dynamic arrays for mesh
+#include <string.h>   // strcmp
 
 // GPU identifiers
 GLuint VAO = 0, VBO = 0, EBO = 0;    // vertex array, vertex buffer, element buffer
-GLuint program = 0;                  // shader program ID
+Program program;                     // shader program, reflected at link time
+
+// uniforms, located once the program is linked
+struct {
+    Uniform<mat4> modelview, persp;
+    Uniform<int> textureImage, bumpMap;
+} uniforms;
 
 // display
 int winWidth = 800, winHeight = 800;
 Camera camera(0, 0, winWidth, winHeight, vec3(15, -15, 0), vec3(0, 0, -5), 30);
 
-// dynamic arrays to read OBJ mesh file
-vector<vec3> points;    // vertex locations
-vector<vec3> normals;   // surface normals
-vector<vec2> uvs;       // texture coordinates
-vector<int3> triangles; // triplets of vertex indices
+// OBJ mesh on the GPU, from its binary cache: vertex locations, surface
+// normals, texture coordinates, and triangles as 16-bit meshlets where possible
+AssetCache assets;
+std::shared_ptr<MeshAsset> asset;
+
+// how vertices are packed in the VBO (see VertexFormatArg), and where
+VertexFormat vertexFormat = VertexFormat::Quantized;
+VertexLayout layout;
+
+// if run with -async, mesh and images are read by a worker pool while
+// placeholders are drawn
+AsyncLoader loader(assets);
+bool async = false;
 
 // OBJ filename
 const char *objFilename = "/Users/nadin/Documents/Graphics/Apps/Assets/pear.obj";
 
-// bump map filename, GL identifiers
+// bump map filename, GPU image: converted to a normal map (x and y, z
+// rebuilt in the pixel shader), cached as pear_bump.jpg.<hash>.nmap; BC5 unless
+// run with -rg8
 const char *bumpFilename = "/Users/nadin/Documents/Graphics/Apps/Assets/pear_bump.jpg";
-GLuint bumpName = 0;
+std::shared_ptr<TextureAsset> bumpMap;
+NormalMapOptions bumpOptions;
 int bumpUnit = 1;
 
 // texture image
 const char *textureFilename =
         "/Users/nadin/Documents/Graphics/Apps/Assets/pear_color.jpg";
-GLuint textureName = 0; // id for texture image, set by ReadTexture
+std::shared_ptr<TextureAsset> texture; // GPU texture image
 int textureUnit = 0; // id for GPU image buffer, may be freely set
 
 // movable lights
 vec3 lights[] = {{.5, 0, 1},
                  {1,  1, 0}};
 const int nLights = sizeof(lights) / sizeof(vec3);
+LightBlock lightBlock; // the lights, in a uniform buffer shared by programs
+ClusteredLights clusters; // or, with -lights N or K, listed per cell of the view volume
+
+// GPU time per pass
+GpuProfiler gpu;
 
 // interaction
 void *picked = NULL;    // if non-null: light or camera
@@ -53,18 +87,25 @@ Mover mover;
 // Shaders
 const char *vertexShader = R"(
 	#version 330
-	in vec3 point;
-    in vec3 normal;
-	in vec2 uv;
+	layout(location = 0) in vec3 point;
+	layout(location = 1) in vec3 normal;
+	layout(location = 2) in vec2 uv;
+	layout(location = 10) in vec4 tangent;		// w: handedness
 
 	out vec3 vPoint;
 	out vec2 vUv;
     out vec3 vNormal;
+    out vec4 vTangent;
 	uniform mat4 modelview, persp;
+	uniform vec3 pointScale = vec3(1), pointOffset = vec3(0); // undo quantization
+	uniform bool octNormals = false;                           // normal.xy octahedral
 
 	void main() {
-		vPoint = (modelview * vec4(point, 1)).xyz;
-        vNormal = (modelview * vec4(normal,0)).xyz;
+		vec3 p = pointOffset + pointScale * point;
+		vec3 n = octNormals ? OctDecode(normal.xy) : normal;
+		vPoint = (modelview * vec4(p, 1)).xyz;
+        vNormal = (modelview * vec4(n,0)).xyz;
+        vTangent = vec4((modelview * vec4(tangent.xyz, 0)).xyz, tangent.w < 0 ? -1 : 1);
 		gl_Position = persp * vec4(vPoint, 1);
 		vUv = uv;
 	}
@@ -75,34 +116,43 @@ const char *pixelShader = R"(
 	in vec3 vPoint;
 	in vec2 vUv;
     in vec3 vNormal;
+    in vec4 vTangent;
 	out vec4 pColor;
 	uniform sampler2D textureImage;
     uniform sampler2D bumpMap;
-	uniform int nLights = 0;
-	uniform vec3 lights[20];
 	uniform float amb = .1, dif = .8, spc =.7; // ambient, diffuse, specular
 	void main() {
         vec3 N = normalize(vNormal); // (Z) unit-length normal
 
-        vec3 dx = dFdx(vPoint), dy = dFdy(vPoint);
-        vec2 du = dFdx(vUv), dv = dFdy(vUv);
-        vec3 U = normalize(du.x * dx + du.y * dy); // (X)
-        vec3 V = normalize(dv.x * dx + dv.y * dy); // (Y)
+        // tangent frame from the mesh (as MikkTSpace), re-orthogonalized
+        // after interpolation; none on the placeholder mesh
+        vec3 T = vTangent.xyz - N * dot(N, vTangent.xyz);
+        if (dot(T, T) < 1e-12)
+            T = cross(N, abs(N.x) < .9 ? vec3(1, 0, 0) : vec3(0, 1, 0));
+        vec3 U = normalize(T);                      // (X)
+        vec3 V = vTangent.w * cross(N, U);          // (Y)
 
-        vec4 bTex = texture(bumpMap, vUv);
-        vec3 b = vec3(1.5 * (2 * bTex.r-1), 1.5 *(2 * bTex.g-1), bTex.b);
+        vec2 xy = 2 * texture(bumpMap, vUv).rg - 1;
+        vec3 b = vec3(xy, sqrt(max(0, 1 - dot(xy, xy))));
         vec3 BN = normalize(b.x * U + b.y * V + b.z * N);
 
         vec3 E = normalize(vPoint);	// eye vector
-        float d = 0, s = 0;
-		for (int i = 0; i < nLights; i++) {
-			vec3 L = normalize(lights[i]-vPoint);	// light vector
+        vec3 d = vec3(0), s = vec3(0);
+		int first, n = LightCount(vPoint, first);
+		for (int k = 0; k < n; k++) {
+			Light light = GetLight(first, k);
+			vec3 l = light.position.xyz-vPoint;
+			float range = light.position.w;
+			float a = light.color.a;			// intensity, faded by range
+			if (range > 0) a *= pow(clamp(1-length(l)/range, 0, 1), 2);
+			vec3 c = a*light.color.rgb;
+			vec3 L = normalize(l);					// light vector
 			vec3 R = reflect(L, BN);				// highlight vector
-			d += max(0, dot(BN, L));				// one-sided diffuse
+			d += c*max(0, dot(BN, L));				// one-sided diffuse
 			float h = max(0, dot(R, E));			// highlight term
-			s += pow(h, 100);						// specular term
+			s += c*pow(h, 100);						// specular term
 		}
-		float ads = clamp(amb + dif*d + spc*s, 0, 1);
+		vec3 ads = clamp(amb + dif*d + spc*s, 0, 1);
 		pColor = vec4(ads * texture(textureImage, vUv).rgb, 1);
 	}
 )";
@@ -117,45 +167,39 @@ void Display(GLFWwindow *w) {
     glClearColor(1, 1, 1, 1); // set background to white
     glClear(GL_COLOR_BUFFER_BIT); // clear screen
 
-    // access GPU buffers, activate shader program
-    glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-    // set pointers
-    VertexAttribPointer(program, "point", 3, 0, (void *) 0);
-    VertexAttribPointer(program, "uv", 2, 0,
-                        (void *) (points.size() * sizeof(vec3)));
-    VertexAttribPointer(program, "normal", 3, 0,
-                        (void *) ((points.size() * sizeof(vec3)) +
-                                  (uvs.size() * sizeof(vec2))));
+    // activate shader program and the mesh's vertex array (attributes and
+    // triangles, captured at upload); set dequantization
+    program.Use();
+    Binds().BindVertexArray(VAO);
+    layout.SetUniforms(program);
 
     // update matrices and light
-    SetUniform(program, "modelview", camera.modelview);
-    SetUniform(program, "persp", camera.persp);
-    SetUniform(program, "nLights", nLights);
-    SetUniform3v(program, "lights", nLights, (float *) lights,
-                 camera.modelview);
+    uniforms.modelview.Set(camera.modelview);
+    uniforms.persp.Set(camera.persp);
+    clusters.Update(lightBlock, lights, nLights, camera.modelview, camera.persp); // if moved
 
     // bind 2D texture, activate appropriate texture unit (enable GPU buffer)
-    glActiveTexture(GL_TEXTURE0 + textureUnit);
-    glBindTexture(GL_TEXTURE_2D, textureName);
-    SetUniform(program, "textureImage", textureUnit);
+    Binds().BindTexture(textureUnit, texture ? texture->textureName : 0);
+    uniforms.textureImage.Set(textureUnit);
 
     // enable bump map, made available for pixel shader
-    glActiveTexture(GL_TEXTURE0 + bumpUnit);
-    glBindTexture(GL_TEXTURE_2D, bumpName);
-    SetUniform(program, "bumpMap", bumpUnit);
+    Binds().BindTexture(bumpUnit, bumpMap ? bumpMap->textureName : 0);
+    uniforms.bumpMap.Set(bumpUnit);
 
     // render for MAC
-    glDrawElements(GL_TRIANGLES, triangles.size() * 3, GL_UNSIGNED_INT, 0);
+    gpu.Begin("bumpy mesh", GpuPrimitives);
+    if (asset)
+        asset->indices.Draw();
+    gpu.End();
 
     glDisable(GL_DEPTH_TEST);
+    gpu.Begin("overlay");
     UseDrawShader(camera.fullview);
     for (int i = 0; i < nLights; i++)
         Star(lights[i], 8, vec3(1, .8f, 0), vec3(0, 0, 1));
     if (picked == &camera && !Shift())
         camera.arcball.Draw(Control());
+    gpu.End();
     glFlush();
 }
 
@@ -175,6 +219,7 @@ void MouseButton(float x, float y, bool left, bool down) {
             camera.Down(x, y, Shift(), Control());
         }
     } else camera.Up();
+    Redraw().Dirty();
 }
 
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
@@ -183,88 +228,148 @@ void MouseMove(float x, float y, bool leftDown, bool rightDown) {
             mover.Drag((int) x, (int) y, camera.modelview, camera.persp);
         if (picked == &camera)
             camera.Drag(x, y);
+        Redraw().Dirty();
     }
 }
 
 void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
+    Redraw().Dirty();
+}
+
+void Keyboard(int k, bool press, bool shift, bool control) {
+    if (press && k == 'G')
+        gpu.Report();
+    if (press && k == 'K') {
+        clusters.enabled = !clusters.enabled;
+        printf("clustered lights %s\n", clusters.enabled ? "on" : "off");
+        Redraw().Dirty();
+    }
 }
 
 // Initialization
-void BufferVertices() {
-    // make GPU buffers for points and colors, set to active
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    // allocate/load memory for points, uvs, normals
-    size_t sPoints = points.size() * sizeof(vec3);
-    size_t sUvs = uvs.size() * sizeof(vec2);
-    size_t sNormals = normals.size() * sizeof(vec3);
-    size_t sTotal = sPoints + sUvs + sNormals;
-    glBufferData(GL_ARRAY_BUFFER, sTotal, NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sPoints, points.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sPoints, sUvs, uvs.data());
-    glBufferSubData(GL_ARRAY_BUFFER, sPoints + sUvs, sNormals, normals.data());
-
-    // make EBO to store triangles, set to active
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-    // copy triangle index data to GPU
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(int3),
-                 triangles.data(), GL_STATIC_DRAW);
+bool UseMesh(std::shared_ptr<MeshAsset> a) {
+    // draw with the asset's buffers: points, normals, uvs packed per
+    // vertexFormat, triangle indices 16-bit where they fit
+    if (!a)
+        return false;
+    asset = a;
+    VAO = a->VAO, VBO = a->VBO, EBO = a->EBO;
+    layout = a->layout;
+    return true;
 }
 
 void Resize(int width, int height) {
     camera.Resize(width, height);
     glViewport(0, 0, width, height);
+    Redraw().Dirty();
 }
 
 // Application
 int main(int ac, char **av) {
-    // read OBJ file
-    if (!ReadAsciiObj(objFilename, points, triangles, &normals, &uvs))
-        printf("can’t read %s\n", objFilename);
-
-    // if normals are missing, generate them
-    if (normals.empty()) {
-        SetVertexNormals(points, triangles, normals);
+    // generate normals if missing, fit model into the window (baked into cache)
+    MeshLoadOptions opts;
+    opts.standardize = .8f;
+    // per-vertex tangent frames for the bump map; these options name a cache
+    // of their own, apart from SmoothMesh's for the same OBJ
+    opts.setTangents = true;
+    vertexFormat = VertexFormatArg(ac, av);
+    async = AsyncArg(ac, av);
+    // the bump vectors' x and y were scaled by 1.5 in the shader
+    bumpOptions.strength = 1.5f;
+    for (int i = 1; i < ac; i++)
+        if (!strcmp(av[i], "-rg8"))
+            bumpOptions.compress = false;
+    Redraw().onDemand = !ContinuousArg(ac, av);
+
+    // compare cold ASCII load with warm mapped load, check, then quit
+    if (ac > 1 && !strcmp(av[1], "-bench")) {
+        BenchmarkMeshCache(objFilename, opts);
+        return RunSelfChecks(objFilename, opts) ? 0 : 1;
     }
 
     // enable anti-alias, init app window and GL context
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight, "Bumpy Mesh");
 
     // init shader program, set GPU buffer, read texture image
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
-
-    // fit modal into the window
-    Standardize(points.data(), points.size(), .8f);
-
-    // allocate vertex memory in the GPU
-    BufferVertices();
-
-    // read texture, bump map
-    ReadTexture(textureFilename, &textureName);
-    ReadTexture(bumpFilename, &bumpName);
+    std::string vertexCode = AddOctCode(vertexShader); // with OctDecode
+    std::string pixelCode = AddLightCode(pixelShader); // with LightCount, GetLight
+    const char *vertexOct = vertexCode.c_str(), *pixelLit = pixelCode.c_str();
+    program.Link(&vertexOct, &pixelLit);
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    lightBlock.Attach(program);
+    clusters.Attach(program);
+    uniforms.textureImage = program.GetUniform<int>("textureImage");
+    uniforms.bumpMap = program.GetUniform<int>("bumpMap");
+
+    if (async) {
+        // placeholders until the worker pool has read mesh, texture, bump map
+        UseMesh(assets.PlaceholderMesh());
+        texture = assets.PlaceholderTexture();
+        bumpMap = assets.PlaceholderTexture(vec3(.5f, .5f, 1)); // flat
+        loader.Mesh(objFilename, opts, vertexFormat, 1, UseMesh);
+        loader.Texture(textureFilename, [](std::shared_ptr<TextureAsset> t) { if (t) texture = t; });
+        loader.NormalMap(bumpFilename, bumpOptions, [](std::shared_ptr<TextureAsset> t) { if (t) bumpMap = t; });
+    }
+    else {
+        // map cached mesh (parse OBJ and write the cache on first run),
+        // allocate vertex memory in the GPU
+        if (!UseMesh(assets.Mesh(objFilename, opts, vertexFormat)))
+            printf("can’t read %s\n", objFilename);
+
+        // read texture, bump map
+        texture = assets.Texture(textureFilename);
+        bumpMap = assets.NormalMap(bumpFilename, bumpOptions);
+    }
 
     // callbacks
     RegisterMouseMove(MouseMove);
     RegisterMouseButton(MouseButton);
     RegisterMouseWheel(MouseWheel);
     RegisterResize(Resize);
+    RegisterKeyboard(Keyboard);
+    printf("Usage:\n    G: print GPU time per pass\n    K: toggle clustered lights\n"
+           "    Run with -lights N to add N lights with a range\n"
+           "    Run with -rg8 to keep the normal map uncompressed\n");
+    if (int n = LightsArg(ac, av)) {
+        clusters.Scatter(n, vec3(-1, -1, -1), vec3(1, 1, 1));
+        clusters.enabled = true;
+    }
+    if (const char *csv = GpuCsvArg(ac, av))
+        if (!gpu.WriteCsv(csv))
+            printf("can't write %s\n", csv);
 
     // event loop
+    Redraw().Attach(w);
     while (!glfwWindowShouldClose(w)) {
-        glfwPollEvents();
+        // until input changes the view, unless assets loading change the mesh
+        bool busy = loader.Pending() > 0;
+        Redraw().Wait(busy);
+        if (loader.Update()) // upload and swap in what the worker pool has read
+            Redraw().Dirty();
+        if (!Redraw().Due(busy))
+            continue;
         Display(w);
         glfwSwapBuffers(w);
+        gpu.EndFrame();
+        loader.FrameDone();
+        Binds().EndFrame();
     }
+    Binds().Report();
+    lightBlock.Report();
+    clusters.Report();
+    Redraw().Report();
+    TextureStats().Report();
+    gpu.Report();
 
     // unbind vertex buffer, free GPU memory
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &VBO);
+    asset = NULL;
+    texture = bumpMap = NULL;
+    lightBlock.Release();
+    clusters.Release();
+    gpu.Release();
     glfwDestroyWindow(w);
     glfwTerminate();
 }
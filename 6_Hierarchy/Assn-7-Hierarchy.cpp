@@ -10,8 +10,28 @@
 #include "Camera.h"
 #include "Draw.h"
 #include "GLXtras.h"
+#include "Program.h"
 #include "IO.h"
+#include "MeshCache.h"
+#include "MeshStream.h"
+#include "VertexLayout.h"
+#include "AssetCache.h"
+#include "AsyncLoader.h"
+#include "LightBlock.h"
+#include "ClusteredLights.h"
+#include "InstanceBuffer.h"
+#include "GeometryArena.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "Redraw.h"
+#include "GBuffer.h"
+#include "GpuProfiler.h"
+#include "Args.h"
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 #include <cmath>
+#include <functional>
 
 // preset matrices
 mat4 cameraM(-0.63f, 1.68f, 0.05f, -0.44f,
@@ -36,7 +56,7 @@ mat4 hatM(0.04f, 0.01f, 0.02f, -1.02f,
           0.00f, 0.00f, 0.00f, 1.00f);
 
 // GPU program, window, camera, colors
-GLuint program = 0;
+Program program;
 int winWidth = 1000, winHeight = 800;
 Camera camera(0, 0, winWidth, winHeight, cameraM);
 vec3 wht(1, 1, 1), red(1, 0, 0);
@@ -46,71 +66,292 @@ vec3 lights[] = {{1, -.2f,    .4f},
                  {-.7f, .8f,  1},
                  {-.5f, -.2f, 1}};
 int nLights = sizeof(lights) / sizeof(vec3);
+LightBlock lightBlock; // the lights, in a uniform buffer shared by programs
+ClusteredLights clusters; // or, with -lights N or K, listed per cell of the view volume
+
+// uniforms, located once the program is linked
+struct {
+    Uniform<mat4> modelview, persp;
+    Uniform<int> textureImage, instanced, arena, draws;
+} uniforms;
+
+// texture units: the mesh texture, arena draw data, clustered lights, then
+// the G-buffer
+const int textureUnit = 0, drawsUnit = 8, clusterUnit = 9, gbufferUnit = 12;
+
+// if deferred (toggle with D, or run with -deferred), meshes are drawn to a
+// G-buffer without lighting, then lit by one full-screen pass
+bool useDeferred = false;
+GBuffer gbuffer;
+Program lightProgram;
+GLuint lightVAO = 0; // empty: the pass's triangle is made from gl_VertexID
+struct {
+    Uniform<int> deferred;                // of program
+    Uniform<mat4> persp;                  // of lightProgram
+    Uniform<vec4> viewport;
+    Uniform<int> gAlbedo, gNormal, gDepth;
+} deferredUniforms;
+
+// GPU time of the forward pass, or of the geometry and lighting passes
+GpuProfiler gpu;
+
+// if run with -stream, meshes are uploaded a chunk per frame, drawn as they arrive
+bool streaming = false;
+
+// how vertices are packed in the VBOs (see VertexFormatArg)
+VertexFormat vertexFormat = VertexFormat::Quantized;
+
+// draw coarser levels of detail for meshes small on screen (toggle with L)
+bool useLod = true;
+
+// skip meshes and instances wholly outside the view (toggle with C); the
+// window title shows how many were drawn and culled last frame
+bool useCulling = true;
+CullStats cullStats;
+
+// skip draws hidden last frame behind the largest meshes, rasterized on a
+// worker thread while the GL thread draws (toggle with O)
+bool useOcclusion = true;
+OcclusionCuller occlusion;
+CullStats occlusionStats;
+
+// meshes and textures, shared by all HMeshes that use the same file
+AssetCache assets;
+
+// if run with -async, meshes and textures are read by a worker pool while
+// placeholders are drawn
+AsyncLoader loader(assets);
+bool async = false;
+
+// if run with -arena, meshes share the arena's buffers and are drawn by one
+// multi-draw
+GeometryArena arena;
+bool useArena = false;
 
 // meshes in hierarchy
 class HMesh {
 public:
-    vector<vec3> points, normals;     // vertices
-    vector<vec2> uvs;                 // texture
-    vector<int3> triangles;           // facets
+    std::shared_ptr<MeshAsset> asset; // vertices, facets, levels of detail on GPU
+    MeshStream stream;                // or the same, streamed
     GLuint VAO = 0, VBO = 0, EBO = 0; // vertex array object, vertex buffer, element buffer
-    GLuint textureName = 0;           // texture map
+    VertexLayout layout;              // attributes in VBO
+    std::shared_ptr<TextureAsset> texture; // texture map
     mat4 toWorld;                     // transformation to world space
     HMesh *child;                     // pointer to child mesh
+    // if any, the mesh is drawn once per instance transform (each applied
+    // before toWorld), with one instanced draw; tints are optional
+    vector<mat4> instanceToWorld;
+    vector<vec4> instanceTints;
+    InstanceBuffer instances;         // the above, streamed to the GPU
+    SphereBvh instanceBounds;         // their bounding spheres, in model space
+    std::shared_ptr<const vector<mat4>> instanceCopy; // and transforms, for the occlusion worker
+    bool boundsDirty = true;          // instances or mesh changed since built
+    vector<int> visible;              // instances in view this frame
+    vector<mat4> visibleToWorld;      // and their transforms and tints
+    vector<vec4> visibleTints;
+    ArenaMesh arenaMesh;              // or vertices and facets in the arena
     void Init(const char *dir, const char *objName, const char *texName,
               HMesh *parent) {
         // assign this mesh as a child to parent mesh
         if (parent)
             parent->child = this;
-        // load mesh data from obj file
+        // map standardized mesh from cache (same initial size for all objects)
         string objFilename(string(dir) + string(objName));
-        if (!ReadAsciiObj(objFilename.c_str(), points, triangles, &normals,
-                          &uvs))
-            printf("can't read %s\n", objFilename.c_str());
-        else {
-            // same initial size for all objects
-            Standardize(points.data(), points.size());
-            // create vertex array object and buffer object
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
+        if (useArena) {
+            // sub-allocated in the arena's buffers
+            MeshData data;
+            if (!PrepareMesh(objFilename.c_str(), MeshLoadOptions(), 8, data) ||
+                !arena.Add(data.mesh, data.lods, arenaMesh))
+                printf("can't read %s\n", objFilename.c_str());
+        }
+        else if (streaming) {
+            // allocate GPU buffers, Render fills them
+            if (!StreamCachedMesh(objFilename.c_str(), stream))
+                printf("can't read %s\n", objFilename.c_str());
+            VAO = stream.VAO, VBO = stream.VBO, EBO = stream.EBO;
+            layout = SeparateLayout(stream.nPoints, stream.hasNormals, stream.hasUvs, stream.hasTangents);
             glBindVertexArray(VAO);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            // allocate memory for vertex points, colors, and normals
-            size_t sPts = points.size() * sizeof(vec3), sNrms =
-                    normals.size() * sizeof(vec3), sUvs =
-                    uvs.size() * sizeof(vec2);
-            glBufferData(GL_ARRAY_BUFFER, sPts + sNrms + sUvs, NULL,
-                         GL_STATIC_DRAW);
-            // load data
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sPts, points.data());
-            glBufferSubData(GL_ARRAY_BUFFER, sPts, sNrms, normals.data());
-            glBufferSubData(GL_ARRAY_BUFFER, sPts + sNrms, sUvs, uvs.data());
-            // copy triangle data to GPU
-            glGenBuffers(1, &EBO);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         triangles.size() * sizeof(int3), triangles.data(),
-                         GL_STATIC_DRAW);
+            layout.Capture(VBO);
+        }
+        else if (async) {
+            // placeholder until the worker pool has read the mesh
+            UseMesh(assets.PlaceholderMesh());
+            loader.Mesh(objFilename.c_str(), MeshLoadOptions(), vertexFormat, 8,
+                        [this](std::shared_ptr<MeshAsset> a) { UseMesh(a); });
         }
-        // load texture data
+        // shared GPU buffers: vertices packed per vertexFormat, triangles
+        // of all levels of detail, 16-bit where indices fit
+        else if (!UseMesh(assets.Mesh(objFilename.c_str(), MeshLoadOptions(), vertexFormat, 8)))
+            printf("can't read %s\n", objFilename.c_str());
+        // shared texture
         string texFilename(string(dir) + string(texName));
-        ReadTexture(texFilename.c_str(), &textureName);
+        if (async) {
+            texture = assets.PlaceholderTexture();
+            loader.Texture(texFilename.c_str(), [this](std::shared_ptr<TextureAsset> t) {
+                if (t)
+                    texture = t;
+            });
+        }
+        else
+            texture = assets.Texture(texFilename.c_str());
+    }
+
+    // draw with a shared mesh, report its levels of detail
+    bool UseMesh(std::shared_ptr<MeshAsset> a) {
+        if (!a)
+            return false;
+        asset = a;
+        boundsDirty = true;
+        VAO = a->VAO, VBO = a->VBO, EBO = a->EBO;
+        layout = a->layout;
+        if (a->lods.Levels() > 1) {
+            printf("%s: levels of detail", a->filename.c_str());
+            for (int n : a->lods.counts)
+                printf(" %d", n);
+            printf(" triangles\n");
+        }
+        return true;
+    }
+
+    // let go of shared assets and any stream
+    void Release() {
+        asset = NULL;
+        texture = NULL;
+        stream.Close();
+        instances.Release();
+    }
+
+    // bounding sphere of each instance, in model space, in a hierarchy;
+    // a copy of the transforms the occlusion worker may read as they change
+    void BuildInstanceBounds() {
+        const LodChain &lods = asset->lods;
+        int n = (int) instanceToWorld.size();
+        vector<vec3> centers(n);
+        vector<float> radii(n);
+        for (int i = 0; i < n; i++)
+            TransformSphere(instanceToWorld[i], lods.center, lods.radius, centers[i], radii[i]);
+        instanceBounds.Build(centers.data(), radii.data(), n);
+        instanceCopy = std::make_shared<const vector<mat4>>(instanceToWorld);
+        boundsDirty = false;
+    }
+
+    // gather the instances at least partly inside frustum (in model space),
+    // if culling, less any hidden last frame, if first (their first draw in
+    // occlusion) isn't -1
+    void CullInstances(const Frustum &frustum, int first) {
+        int n = (int) instanceToWorld.size();
+        if (useCulling) {
+            instanceBounds.Cull(frustum, visible);
+            cullStats.Count((int) visible.size(), n);
+            // in order, for the same draw order as unculled
+            std::sort(visible.begin(), visible.end());
+        }
+        else {
+            visible.resize(n);
+            for (int i = 0; i < n; i++)
+                visible[i] = i;
+        }
+        if (first >= 0) {
+            int nTested = (int) visible.size();
+            visible.erase(std::remove_if(visible.begin(), visible.end(),
+                                         [first](int i) { return occlusion.Occluded(first + i); }),
+                          visible.end());
+            occlusionStats.Count((int) visible.size(), nTested);
+        }
+        bool tinted = instanceTints.size() == instanceToWorld.size();
+        visibleToWorld.resize(visible.size());
+        visibleTints.resize(tinted ? visible.size() : 0);
+        for (size_t i = 0; i < visible.size(); i++) {
+            visibleToWorld[i] = instanceToWorld[visible[i]];
+            if (tinted)
+                visibleTints[i] = instanceTints[visible[i]];
+        }
     }
 
     // render mesh
-    void Render(mat4 modelview) {
-        size_t sPts = points.size() * sizeof(vec3), sNrms =
-                normals.size() * sizeof(vec3);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        VertexAttribPointer(program, "point", 3, 0, (void *) 0);
-        VertexAttribPointer(program, "normal", 3, 0, (void *) sPts);
-        VertexAttribPointer(program, "uv", 2, 0, (void *) (sPts + sNrms));
-        SetUniform(program, "modelview", modelview * toWorld);
-        SetUniform(program, "textureName", textureName);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureName);
-        glDrawElements(GL_TRIANGLES, 3 * triangles.size(), GL_UNSIGNED_INT, 0);
+    void Render(mat4 modelview, int viewportHeight) {
+        // upload another chunk of a streamed mesh
+        if (streaming)
+            stream.Step();
+        // the view volume in model space, where the bounds were found at load
+        // (a streamed mesh has none, and is always drawn)
+        mat4 m = modelview * toWorld;
+        Frustum frustum(camera.persp * m);
+        int nInstances = (int) instanceToWorld.size();
+        const mat4 *instanceData = instanceToWorld.data();
+        const vec4 *tintData = instanceTints.size() == instanceToWorld.size() ? instanceTints.data() : NULL;
+        bool bounded = asset && !streaming;
+        if (bounded && nInstances && boundsDirty)
+            BuildInstanceBounds();
+        // this frame's draws to the occlusion worker; those it hid last frame
+        int first = -1;
+        if (useOcclusion && bounded)
+            first = occlusion.Add(m, asset->lods, asset->occluder, nInstances ? instanceCopy : NULL);
+        if (bounded && nInstances && (useCulling || first >= 0)) {
+            CullInstances(frustum, first);
+            nInstances = (int) visible.size();
+            instanceData = visibleToWorld.data();
+            tintData = tintData ? visibleTints.data() : NULL;
+            if (!nInstances)
+                return;
+        }
+        else if (bounded && !nInstances) {
+            const LodChain &lods = asset->lods;
+            if (useCulling) {
+                bool inView = frustum.Visible(lods.lo, lods.hi, lods.center, lods.radius);
+                cullStats.Count(inView ? 1 : 0, 1);
+                if (!inView)
+                    return;
+            }
+            if (first >= 0) {
+                bool hidden = occlusion.Occluded(first);
+                occlusionStats.Count(hidden ? 0 : 1, 1);
+                if (hidden)
+                    return;
+            }
+        }
+        // attributes and triangles captured in the VAO at upload
+        Binds().BindVertexArray(VAO);
+        layout.SetUniforms(program);
+        uniforms.modelview.Set(m);
+        Binds().BindTexture(textureUnit, texture ? texture->textureName : 0);
+        // instance transforms to the next part of the ring, read by the draw
+        uniforms.instanced.Set(nInstances ? 1 : 0);
+        if (nInstances) {
+            instances.Write(instanceData, tintData, nInstances);
+            instances.Attach();
+        }
+        if (streaming)
+            glDrawElementsInstanced(GL_TRIANGLES, 3 * stream.nDrawable, GL_UNSIGNED_INT, 0,
+                                    nInstances ? nInstances : 1);
+        else if (asset) {
+            // coarsest level whose error stays under a pixel, for the nearest
+            // instance drawn
+            const LodChain &lods = asset->lods;
+            float r = 0;
+            if (useLod && nInstances)
+                for (int i = 0; i < nInstances; i++)
+                    r = std::max(r, ProjectedRadius(lods.center, lods.radius, m * instanceData[i],
+                                                    camera.persp, viewportHeight));
+            else if (useLod)
+                r = ProjectedRadius(lods.center, lods.radius, m, camera.persp, viewportHeight);
+            asset->indices.Draw(-1, useLod ? lods.Select(r) : 0, nInstances ? nInstances : 1);
+        }
+    }
+
+    // add the mesh to the arena's commands, with modelview and material
+    // (its index in meshes, whose texture is bound for its group)
+    void Queue(mat4 modelview, int viewportHeight, int material) {
+        const LodChain &lods = arenaMesh.lods;
+        mat4 m = modelview * toWorld;
+        if (useCulling && lods.Levels()) {
+            bool inView = Frustum(camera.persp * m).Visible(lods.lo, lods.hi, lods.center, lods.radius);
+            cullStats.Count(inView ? 1 : 0, 1);
+            if (!inView)
+                return;
+        }
+        float r = useLod ? ProjectedRadius(lods.center, lods.radius, m, camera.persp, viewportHeight) : 0;
+        arena.Draw(arenaMesh, useLod ? lods.Select(r) : 0, m, material);
     }
 
     // apply transformation to mesh and its children(if any)
@@ -135,62 +376,176 @@ public:
 // define meshes with their transform matrices
 HMesh dog(dogM), bird(birdM), hat(hatM), *meshes[] = {&dog, &bird,
                                                       &hat}, *pickedMesh = NULL;
+const int nMeshes = sizeof(meshes) / sizeof(HMesh *);
 
 // shaders
 const char *vertexShader = R"(
 	#version 410 core
-	in vec3 point, normal;
-	in vec2 uv;
+	layout(location = 0) in vec3 point;
+	layout(location = 1) in vec3 normal;
+	layout(location = 2) in vec2 uv;
+	layout(location = 4) in mat4 instance;			// per instance, if instanced
+	layout(location = 8) in vec4 instanceTint;
+	layout(location = 9) in int drawId;				// per draw, if in the arena
 	out vec3 vPoint, vNormal;
 	out vec2 vUv;
+	out vec4 vTint;
 	uniform mat4 modelview, persp;
+	uniform bool instanced = false;
+	uniform bool arena = false;
+	uniform samplerBuffer draws;					// per draw: modelview columns
+	uniform vec3 pointScale = vec3(1), pointOffset = vec3(0); // undo quantization
+	uniform bool octNormals = false;                           // normal.xy octahedral
 	void main() {
-		vPoint = (modelview*vec4(point, 1)).xyz;
-		vNormal = (modelview*vec4(normal, 0)).xyz;
+		vec3 p = pointOffset + pointScale*point;
+		vec3 n = octNormals ? OctDecode(normal.xy) : normal;
+		mat4 m = instanced ? modelview*instance : modelview;
+		if (arena) {
+			int d = 5*drawId;
+			m = mat4(texelFetch(draws, d), texelFetch(draws, d+1),
+					 texelFetch(draws, d+2), texelFetch(draws, d+3));
+		}
+		vPoint = (m*vec4(p, 1)).xyz;
+		vNormal = (m*vec4(n, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 		vUv = uv;
+		vTint = instanced ? instanceTint : vec4(1);
 	}
 )";
 const char *pixelShader = R"(
 	#version 410 core
 	in vec3 vPoint, vNormal;
 	in vec2 vUv;
-	uniform int nLights = 0;
-	uniform vec3 lights[20];
-	uniform sampler2D textureName;
-	out vec4 pColor;
+	in vec4 vTint;
+	uniform sampler2D textureImage;
+	uniform bool deferred = false;					// to the G-buffer, unlit
+	layout(location = 0) out vec4 pColor;
+	layout(location = 1) out vec2 gNormal;
 	void main() {
-		float d = 0, s = 0;							// diffuse, specular terms
+		vec3 c = texture(textureImage, vUv).rgb*vTint.rgb;
 		vec3 N = normalize(vNormal);
+		if (deferred) {
+			pColor = vec4(c, 1);
+			gNormal = OctEncode(N);
+			return;
+		}
+		vec3 d = vec3(0), s = vec3(0);			// diffuse, specular terms
 		vec3 E = normalize(vPoint);					// eye vector
-		for (int i = 0; i < nLights; i++) {
-			vec3 L = normalize(lights[i]-vPoint);	// light vector
+		int first, n = LightCount(vPoint, first);
+		for (int k = 0; k < n; k++) {
+			Light light = GetLight(first, k);
+			vec3 l = light.position.xyz-vPoint;
+			float range = light.position.w;
+			float a = light.color.a;			// intensity, faded by range
+			if (range > 0) a *= pow(clamp(1-length(l)/range, 0, 1), 2);
+			vec3 c = a*light.color.rgb;
+			vec3 L = normalize(l);					// light vector
 			vec3 R = reflect(L, N);					// highlight vector
-			d += max(0, dot(N, L));					// one-sided diffuse
+			d += c*max(0, dot(N, L));				// one-sided diffuse
 			float h = max(0, dot(R, E));			// highlight term
-			s += pow(h, 100);						// specular term
+			s += c*pow(h, 100);						// specular term
 		}
-		float ads = clamp(.1+.7*d+.7*s, 0, 1);
-		vec3 c = texture(textureName, vUv).rgb;
+		vec3 ads = clamp(.1+.7*d+.7*s, 0, 1);
 		pColor = vec4(ads*c, 1);
 	}
 )";
 
+// deferred lighting: a triangle over the viewport, each pixel lit as by
+// pixelShader, from the G-buffer; with clustered lights, the pixel's screen
+// tile and depth slice give its lights
+const char *lightVertexShader = R"(
+	#version 410 core
+	void main() {
+		vec2 p = vec2((gl_VertexID&1)*4-1, (gl_VertexID&2)*2-1);
+		gl_Position = vec4(p, 0, 1);
+	}
+)";
+const char *lightPixelShader = R"(
+	#version 410 core
+	out vec4 pColor;
+	void main() {
+		vec3 p, N, albedo;
+		if (!GetPixel(p, N, albedo))
+			discard;							// background
+		vec3 d = vec3(0), s = vec3(0);
+		vec3 E = normalize(p);
+		int first, n = LightCount(p, first);
+		for (int k = 0; k < n; k++) {
+			Light light = GetLight(first, k);
+			vec3 l = light.position.xyz-p;
+			float range = light.position.w;
+			float a = light.color.a;
+			if (range > 0) a *= pow(clamp(1-length(l)/range, 0, 1), 2);
+			vec3 c = a*light.color.rgb;
+			vec3 L = normalize(l);
+			vec3 R = reflect(L, N);
+			d += c*max(0, dot(N, L));
+			float h = max(0, dot(R, E));
+			s += c*pow(h, 100);
+		}
+		vec3 ads = clamp(.1+.7*d+.7*s, 0, 1);
+		pColor = vec4(ads*albedo, 1);
+	}
+)";
+
+// the scene, lit per pixel by the G-buffer; the window's background shows
+// where nothing was drawn
+void LightPass() {
+    lightProgram.Use();
+    clusters.Use();
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    deferredUniforms.persp.Set(camera.persp);
+    deferredUniforms.viewport.Set(vec4((float) viewport[0], (float) viewport[1], (float) viewport[2],
+                                       (float) viewport[3]));
+    gbuffer.BindTextures(gbufferUnit);
+    Binds().BindVertexArray(lightVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
 // Display
 void Display() {
     // background, z-buffer
     glClearColor(.4f, .4f, .8f, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
-    glUseProgram(program);
-    // lights
-    SetUniform(program, "nLights", nLights);
-    SetUniform3v(program, "lights", nLights, (float *) lights,
-                 camera.modelview);
-    // scene
-    SetUniform(program, "persp", camera.persp);
-    for (HMesh *m: meshes)
-        m->Render(camera.modelview);
+    program.Use();
+    // lights, sent if they or the camera moved
+    clusters.Update(lightBlock, lights, nLights, camera.modelview, camera.persp);
+    // scene, lit or to the G-buffer
+    bool deferred = useDeferred && gbuffer.Begin();
+    gpu.Begin(deferred ? "geometry" : "forward");
+    deferredUniforms.deferred.Set(deferred ? 1 : 0);
+    uniforms.persp.Set(camera.persp);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    uniforms.arena.Set((int) useArena);
+    if (useArena) {
+        // a command per mesh, drawn by a multi-draw per material (mesh i's
+        // texture, bound before its group)
+        arena.Begin();
+        for (int i = 0; i < nMeshes; i++)
+            meshes[i]->Queue(camera.modelview, viewport[3], i);
+        arena.Submit(drawsUnit, [](int material) {
+            HMesh *m = meshes[material];
+            Binds().BindTexture(textureUnit, m->texture ? m->texture->textureName : 0);
+        });
+    }
+    else {
+        // results of the occlusion worker's last frame, then this frame to it
+        occlusion.Begin();
+        for (HMesh *m: meshes)
+            m->Render(camera.modelview, viewport[3]);
+        occlusion.Submit(camera.persp, viewport[2], viewport[3]);
+    }
+    gpu.End();
+    if (deferred) {
+        gbuffer.End();
+        gpu.Begin("lighting");
+        glDisable(GL_DEPTH_TEST);
+        LightPass();
+        gpu.End();
+    }
     // markings
     glDisable(GL_DEPTH_TEST);
     UseDrawShader(camera.fullview);
@@ -203,6 +558,19 @@ void Display() {
     glFlush();
 }
 
+// meshes (or instances) culled by the frustum, hidden by occluders, and
+// drawn, in the window title when they change
+void ShowCullStats(GLFWwindow *w) {
+    bool changed = cullStats.EndFrame();
+    if (!occlusionStats.EndFrame() && !changed)
+        return;
+    char title[100];
+    int drawn = useOcclusion ? occlusionStats.lastVisible : cullStats.lastVisible;
+    snprintf(title, sizeof(title), "Hierarchy: %d drawn, %d culled, %d occluded", drawn,
+             cullStats.lastCulled, occlusionStats.lastCulled);
+    glfwSetWindowTitle(w, title);
+}
+
 // Mouse
 void MouseButton(float x, float y, bool left, bool down) {
     if (left && down)
@@ -215,24 +583,29 @@ void MouseButton(float x, float y, bool left, bool down) {
             if (MouseOver(x, y, m->Origin(), camera.fullview))
                 pickedMesh = m;
     }
+    Redraw().Dirty();
 }
 
 void MouseMove(float x, float y, bool leftDown, bool rightDown) {
-    if (leftDown)
+    if (leftDown) {
         camera.Drag(x, y);
+        Redraw().Dirty();
+    }
 }
 
 void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
+    Redraw().Dirty();
 }
 
 // Keyboard
 // hold X, Y, or Z: LEFT/RIGHT arrows: move, UP/DOWN arrows: rotate
 // s: scale larger, S: smaller
-void TestKey() {
+// true if the picked mesh moved (then the keys are polled again next frame)
+bool TestKey() {
     //  call KeyDown() to test keys per usage message
     //  compute transformation and apply to picked mesh
-    if (!pickedMesh) return;
+    if (!pickedMesh) return false;
     mat4 mT = mat4(1);
 
     // determine state of keys
@@ -288,6 +661,7 @@ void TestKey() {
     }
     // apply transformation matrix to picked mesh
     pickedMesh->ApplyTransform(mT);
+    return ((x || y || z) && (l || r || u || d)) || s;
 }
 
 void MWrite(mat4 m, const char *name) {
@@ -298,9 +672,35 @@ void MWrite(mat4 m, const char *name) {
 }
 
 void Keyboard(int k, bool press, bool shift, bool control) {
+    Redraw().Dirty();
     if (press) {
         if (k == 'R')
             dog.toWorld = bird.toWorld = hat.toWorld = mat4(1);
+        if (k == 'L') {
+            useLod = !useLod;
+            printf("levels of detail %s\n", useLod ? "on" : "off");
+        }
+        if (k == 'M')
+            assets.Report();
+        if (k == 'K') {
+            clusters.enabled = !clusters.enabled;
+            printf("clustered lights %s\n", clusters.enabled ? "on" : "off");
+        }
+        if (k == 'D') {
+            useDeferred = !useDeferred;
+            printf("%s shading\n", useDeferred ? "deferred" : "forward");
+        }
+        if (k == 'G')
+            gpu.Report();
+        if (k == 'C') {
+            useCulling = !useCulling;
+            printf("culling %s\n", useCulling ? "on" : "off");
+        }
+        if (k == 'O') {
+            useOcclusion = !useOcclusion;
+            Redraw().trailing = useOcclusion ? 1 : 0;
+            printf("occlusion culling %s\n", useOcclusion ? "on" : "off");
+        }
         if (k == 'P') {
             MWrite(dog.toWorld, "dog");
             MWrite(bird.toWorld, "bird");
@@ -310,10 +710,92 @@ void Keyboard(int k, bool press, bool shift, bool control) {
     }
 }
 
+// Instances
+
+// n copies of mesh m on a grid, the first untransformed (so m's children
+// stay on it), tinted if tint
+void SetInstances(HMesh &m, int n, bool tint) {
+    m.instanceToWorld.resize(n);
+    m.instanceTints.resize(tint ? n : 0);
+    m.boundsDirty = true;
+    int side = (int) ceil(cbrt((double) n));
+    for (int i = 0; i < n; i++) {
+        int x = i % side, y = (i / side) % side, z = i / (side * side);
+        m.instanceToWorld[i] = Translate(1.2f * x, 1.2f * y, 1.2f * z);
+        if (tint) {
+            unsigned h = 2654435761u * (unsigned) i; // scattered, 0 for the first
+            m.instanceTints[i] = vec4(1 - (h >> 24) / 600.f, 1 - ((h >> 16) & 255) / 600.f,
+                                      1 - ((h >> 8) & 255) / 600.f, 1);
+        }
+    }
+}
+
+// ms per frame of draw, after a few frames to warm up
+double TimeFrames(int nFrames, std::function<void()> draw) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start;
+    for (int f = -3; f < nFrames; f++) {
+        if (!f) {
+            glFinish();
+            start = Clock::now();
+        }
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        program.Use();
+        clusters.Update(lightBlock, lights, nLights, camera.modelview, camera.persp);
+        uniforms.persp.Set(camera.persp);
+        draw();
+    }
+    glFinish();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / nFrames;
+}
+
+// frame times drawing n dogs as n separate draws (a modelview upload and
+// a draw call each) and as n instances (one draw call), n from 1 to 100,000,
+// all in view; then the time to cull the instances, and how many remain
+void Benchmark() {
+    const int counts[] = {1, 10, 100, 1000, 10000, 100000}, nFrames = 10;
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glEnable(GL_DEPTH_TEST);
+    mat4 toWorld = dog.toWorld;
+    bool culling = useCulling, occluding = useOcclusion;
+    useCulling = useOcclusion = false;
+    Frustum frustum(camera.persp * camera.modelview * toWorld);
+    printf("%9s %12s %13s %10s (ms per frame) %8s\n", "instances", "separate", "instanced", "cull",
+           "in view");
+    for (int n : counts) {
+        SetInstances(dog, n, false);
+        vector<mat4> grid;
+        grid.swap(dog.instanceToWorld);
+        double separate = TimeFrames(nFrames, [&]() {
+            for (const mat4 &g : grid) {
+                dog.toWorld = toWorld * g;
+                dog.Render(camera.modelview, viewport[3]);
+            }
+        });
+        dog.toWorld = toWorld;
+        grid.swap(dog.instanceToWorld);
+        double instanced = TimeFrames(nFrames, [&]() { dog.Render(camera.modelview, viewport[3]); });
+        // the bounds hierarchy was built by the first instanced frame
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        useCulling = true;
+        for (int f = 0; f < nFrames; f++)
+            dog.CullInstances(frustum, -1);
+        useCulling = false;
+        double cull = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / nFrames;
+        printf("%9d %12.2f %13.2f %10.3f %22d\n", n, separate, instanced, cull, (int) dog.visible.size());
+    }
+    dog.instanceToWorld.clear();
+    useCulling = culling;
+    useOcclusion = occluding;
+}
+
 // Application
 void Resize(int width, int height) {
     camera.Resize(width, height);
     glViewport(0, 0, width, height);
+    Redraw().Dirty();
 }
 
 const char *usage = R"(
@@ -325,19 +807,101 @@ const char *usage = R"(
         s/S: scale
     R: set matrices to identity
     P: print matrices
+    L: toggle levels of detail
+    C: toggle view frustum culling
+    O: toggle occlusion culling
+    M: report GPU memory per asset
+    K: toggle clustered lights
+    D: toggle deferred shading
+    G: print GPU times (forward, or geometry and lighting passes)
+    Run with -stream to upload meshes progressively
+    Run with -async to read meshes and textures in the background
+    Run with -separate, -interleaved or -quantized to pick the vertex format
+    Run with -instances N to draw N tinted dogs, instanced
+    Run with -lights N to add N lights with a range, clustered
+    Run with -deferred to start with deferred shading
+    Run with -gpucsv file to write GPU times per frame
+    Run with -bench to time separate and instanced draws, 1 to 100,000 dogs
+    Run with -arena to draw all meshes from shared buffers with one multi-draw
+    Run with -continuous to draw every frame, not just when the view changes
 )";
 
 int main(int ac, char **av) {
     // init app, GPU program
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight, "Hierarchy");
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
-    // read models, textures, set hierarchy
+    std::string vertexCode = AddOctCode(vertexShader); // with OctDecode
+    std::string pixelCode = AddLightCode(AddOctCode(pixelShader).c_str()); // and LightCount, GetLight
+    const char *vertexOct = vertexCode.c_str(), *pixelLit = pixelCode.c_str();
+    program.Link(&vertexOct, &pixelLit);
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    lightBlock.Attach(program);
+    clusters.Attach(program, clusterUnit);
+    uniforms.textureImage = program.GetUniform<int>("textureImage");
+    uniforms.instanced = program.GetUniform<int>("instanced");
+    uniforms.arena = program.GetUniform<int>("arena");
+    uniforms.draws = program.GetUniform<int>("draws");
+    deferredUniforms.deferred = program.GetUniform<int>("deferred");
+    // deferred lighting pass, lit by the same lights
+    std::string lightCode = AddLightCode(AddGBufferCode(lightPixelShader).c_str());
+    const char *lightPixel = lightCode.c_str();
+    lightProgram.Link(&lightVertexShader, &lightPixel);
+    lightBlock.Attach(lightProgram);
+    clusters.Attach(lightProgram, clusterUnit);
+    deferredUniforms.persp = lightProgram.GetUniform<mat4>("persp");
+    deferredUniforms.viewport = lightProgram.GetUniform<vec4>("viewport");
+    deferredUniforms.gAlbedo = lightProgram.GetUniform<int>("gAlbedo");
+    deferredUniforms.gNormal = lightProgram.GetUniform<int>("gNormal");
+    deferredUniforms.gDepth = lightProgram.GetUniform<int>("gDepth");
+    lightProgram.Use();
+    deferredUniforms.gAlbedo.Set(gbufferUnit);
+    deferredUniforms.gNormal.Set(gbufferUnit + 1);
+    deferredUniforms.gDepth.Set(gbufferUnit + 2);
+    glGenVertexArrays(1, &lightVAO);
+    useDeferred = FlagArg(ac, av, "-deferred");
+    if (const char *csv = GpuCsvArg(ac, av))
+        if (!gpu.WriteCsv(csv))
+            printf("can't write %s\n", csv);
+    // samplers keep to their units
+    program.Use();
+    uniforms.textureImage.Set(textureUnit);
+    uniforms.draws.Set(drawsUnit);
+    // the benchmark and the arena need meshes whole, at once
+    bool bench = FlagArg(ac, av, "-bench");
+    useArena = FlagArg(ac, av, "-arena") && !bench;
+    streaming = ac > 1 && !strcmp(av[1], "-stream") && !bench && !useArena;
+    vertexFormat = VertexFormatArg(ac, av);
+    async = AsyncArg(ac, av) && !bench && !useArena;
+    Redraw().onDemand = !ContinuousArg(ac, av);
+    // occlusion results are a frame behind: draw once more after a change
+    Redraw().trailing = useOcclusion ? 1 : 0;
+    // read models, textures, set hierarchy; meshes keep occluders for the culler
+    assets.keepOccluders = true;
     dog.Init("/Users/nadin/Documents/Graphics/Apps/Assets/", "Dog1.obj",
              "Dog1.jpg", NULL);
     bird.Init("/Users/nadin/Documents/Graphics/Apps/Assets/", "Bird.obj",
               "Bird.jpg", &dog);
     hat.Init("/Users/nadin/Documents/Graphics/Apps/Assets/", "Hat.obj",
              "Hat.png", &bird);
+    if (!async)
+        assets.Report();
+    int n = useArena ? 0 : IntArg(ac, av, "-instances", 0);
+    if (n)
+        SetInstances(dog, n, true);
+    if (int nScattered = LightsArg(ac, av)) {
+        clusters.Scatter(nScattered, vec3(-2, -1, -1), vec3(1, 1, 1));
+        clusters.enabled = true;
+    }
+    if (bench) {
+        Benchmark();
+        for (HMesh *m: meshes)
+            m->Release();
+        lightBlock.Release();
+        clusters.Release();
+        glfwDestroyWindow(w);
+        glfwTerminate();
+        return 0;
+    }
     // callbacks
     RegisterMouseMove(MouseMove);
     RegisterMouseButton(MouseButton);
@@ -346,10 +910,48 @@ int main(int ac, char **av) {
     RegisterKeyboard(Keyboard);
     printf("Usage:%s", usage);
     // event loop
+    Redraw().Attach(w);
     while (!glfwWindowShouldClose(w)) {
-        TestKey();
+        // until input changes the view, unless streams or assets loading
+        // change meshes
+        bool busy = loader.Pending() > 0;
+        for (HMesh *m: meshes)
+            busy = busy || (streaming && !m->stream.Done());
+        Redraw().Wait(busy);
+        if (TestKey())
+            Redraw().Dirty();
+        if (loader.Update()) // upload and swap in what the worker pool has read
+            Redraw().Dirty();
+        if (!Redraw().Due(busy))
+            continue;
         Display();
         glfwSwapBuffers(w);
-        glfwPollEvents();
+        gpu.EndFrame();
+        loader.FrameDone();
+        Binds().EndFrame();
+        ShowCullStats(w);
     }
+    Binds().Report();
+    Redraw().Report();
+    lightBlock.Report();
+    clusters.Report();
+    gpu.Report();
+    if (gbuffer.width)
+        gbuffer.Report();
+    cullStats.Report();
+    TextureStats().Report();
+    occlusionStats.Report("occlusion culling");
+    if (useArena)
+        arena.Report();
+    // free GPU memory while the context is current
+    for (HMesh *m: meshes)
+        m->Release();
+    lightBlock.Release();
+    clusters.Release();
+    arena.Release();
+    gbuffer.Release();
+    gpu.Release();
+    glDeleteVertexArrays(1, &lightVAO);
+    glfwDestroyWindow(w);
+    glfwTerminate();
 }
\ No newline at end of file
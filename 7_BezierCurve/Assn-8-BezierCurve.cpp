@@ -11,7 +11,7 @@
 #include "Draw.h"     // Screen drawing, Star
 #include "Widgets.h"  // Mover
 #include <vector>     // Dynamic arrays for mesh
-#include <time.h>     // for ability to animate over time
+#include "Timing.h"   // SimClock
 
 // GPU identifiers
 GLuint VAO = 0, VBO = 0, EBO = 0;    // vertex array, vertex buffer, element buffer
@@ -21,7 +21,7 @@ GLuint program = 0;                  // shader program ID
 int winWidth = 800, winHeight = 800;
 Camera camera(0, 0, winWidth, winHeight, vec3(15, -15, 0), vec3(0, 0, -5), 30);
 
-time_t startTime = clock();
+SimClock simClock;  // wall time, paused, scaled or stepped by keys
 float duration = 4; // seconds for animated dot back and forth
 
 // Bezier curve class
@@ -90,7 +90,7 @@ public:
 
     // draw moving dot along the curve
     void DrawMovingDot() {
-        float elapsedTime = (float) (clock() - startTime) / CLOCKS_PER_SEC;
+        float elapsedTime = (float) simClock.RenderTime();
         float alpha =
                 (float) (sin(2 * 3.1415f * elapsedTime / duration) + 1) / 2;
         Disk(ComputePointOnCurve(alpha), DIAM_POINT, COLOR_DOT);
@@ -119,10 +119,9 @@ void Display(GLFWwindow *w) {
     glClearColor(1, 1, 1, 1); // set background to white
     glClear(GL_COLOR_BUFFER_BIT); // clear screen
 
-    // access GPU buffers, activate shader program
+    // activate shader program (the curve is drawn by Draw.h, with its own
+    // vertex arrays)
     glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
     // draw Bezier curve, polygon, control points and moving dot along curve
     Bezier curve(points);
@@ -165,6 +164,11 @@ void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
 }
 
+void Keyboard(int k, bool press, bool shift, bool control) {
+    if (press)
+        SimClockKey(simClock, k);
+}
+
 void Resize(int width, int height) {
     camera.Resize(width, height);
     glViewport(0, 0, width, height);
@@ -182,13 +186,17 @@ int main(int ac, char **av) {
     RegisterMouseButton(MouseButton);
     RegisterMouseWheel(MouseWheel);
     RegisterResize(Resize);
+    RegisterKeyboard(Keyboard);
+    printf("Usage:%s", SimClockUsage());
 
     // event loop
     while (!glfwWindowShouldClose(w)) {
         glfwPollEvents();
+        simClock.Tick(); // the dot is a function of time: no state to step
         Display(w);
         glfwSwapBuffers(w);
     }
+    simClock.frames.Report();
 
     // unbind vertex buffer, free GPU memory
     glBindBuffer(GL_ARRAY_BUFFER, 0);
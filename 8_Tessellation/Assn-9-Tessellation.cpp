@@ -8,15 +8,26 @@
 #include "glfw3.h"    // GL toolkit (create window + rendering context for it)
 #include "GLXtras.h"  // Convenience routines
 #include "VecMat.h"   // Library for vector/matrix operations
+#include "Program.h"  // Program, Uniform
 #include "Camera.h"   // Camera control
 #include "Draw.h"     // Screen drawing, Star
 #include "IO.h"       // Input/output handling
 #include "Widgets.h"  // mover, arcball
-#include <time.h>     // for ability to animate over time
+#include "Timing.h"   // SimClock
+#include "GpuProfiler.h" // GpuProfiler, GpuCsvArg
+#include "TextureCache.h" // CachedTexture, TextureStats
 
 // GPU identifiers
-GLuint VBO = 0, EBO = 0; // vertex and element buffers
-GLuint program = 0;      // shader program ID
+GLuint VAO = 0;          // vertex array (empty: the patch is made by the shaders)
+Program program;         // shader program, reflected at link time
+
+// uniforms, located once the program is linked
+struct {
+    Uniform<float> alpha;
+    Uniform<mat4> modelview, persp;
+    Uniform<vec3> light;
+    Uniform<int> textureMap;
+} uniforms;
 
 // display parameters
 int winWidth = 800, winHeight = 600;
@@ -34,10 +45,13 @@ void *picked = NULL;          // if non-null: light or camera
 Mover mover;
 
 // time of animation
-time_t startTime = clock();
+SimClock simClock;     // wall time, paused, scaled or stepped by keys
 float PI = 3.141592;
 float duration = 4.0; // duration of interpolation
 
+// GPU time, primitives and tessellation evaluations per pass
+GpuProfiler gpu;
+
 // vertex shader (no operations)
 const char *vShader = R"(
 	#version 410 core
@@ -126,7 +140,7 @@ const char *pShader = R"(
 // display
 
 void Display() {
-    float elapsedTime = (float)(clock() - startTime) / CLOCKS_PER_SEC;
+    float elapsedTime = (float) simClock.RenderTime();
     float alpha = (float)(sin(2 * PI * elapsedTime / duration) + 1) / 2;
 
     // background, zbuffer, anti-alias lines
@@ -135,22 +149,20 @@ void Display() {
     glEnable(GL_DEPTH_TEST);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
-    glUseProgram(program);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    program.Use();
+    Binds().BindVertexArray(VAO);
 
     // send alpha and matrices to tessellation shader
-    SetUniform(program, "alpha", alpha);
-    SetUniform(program, "modelview", camera.modelview);
-    SetUniform(program, "persp", camera.persp);
+    uniforms.alpha.Set(alpha);
+    uniforms.modelview.Set(camera.modelview);
+    uniforms.persp.Set(camera.persp);
 
     // send transformed light to pixel shader
-    SetUniform3v(program, "light", 1, (float *) &light, camera.modelview);
+    uniforms.light.Set(&light, 1, camera.modelview);
 
     // set texture
-    glActiveTexture(GL_TEXTURE0 + textureUnit); // active texture corresponds with textureUnit
-    glBindTexture(GL_TEXTURE_2D, textureName); // bind active texture to textureName
-    SetUniform(program, "textureMap", textureUnit);
+    Binds().BindTexture(textureUnit, textureName); // textureName on textureUnit
+    uniforms.textureMap.Set(textureUnit);
 
     // draw 4-sided, tessellated patch
     glPatchParameteri(GL_PATCH_VERTICES, 4);
@@ -158,14 +170,18 @@ void Display() {
                                                                            res};
     glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, outerLevels);
     glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, innerLevels);
+    gpu.Begin("patch", GpuPrimitives | GpuTessellation);
     glDrawArrays(GL_PATCHES, 0, 4);
+    gpu.End();
 
     // draw arcball, light
     glDisable(GL_DEPTH_TEST);
+    gpu.Begin("overlay");
     if (picked == &camera && !camera.shift)
         camera.arcball.Draw(camera.control);
     UseDrawShader(camera.fullview);
     Star(light, 9, red, blu);
+    gpu.End();
     glFlush();
 }
 
@@ -198,6 +214,10 @@ void MouseWheel(float spin) {
     camera.Wheel(spin, Shift());
 }
 
+void Keyboard(int k, bool press, bool shift, bool control) {
+    if (press && !SimClockKey(simClock, k) && k == 'G')
+        gpu.Report();
+}
 
 void Resize(int width, int height) {
     camera.Resize(winWidth = width, winHeight = height);
@@ -209,24 +229,43 @@ int main(int ac, char **av) {
     // init app window, OpenGL, shader program, texture
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight,
                              "Tessellate Cone and Torus");
-    program = LinkProgramViaCode(&vShader, NULL, &teShader, NULL, &pShader);
-    ReadTexture(textureFilename, &textureName);
+    program.Link(&vShader, NULL, &teShader, NULL, &pShader);
+    uniforms.alpha = program.GetUniform<float>("alpha");
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    uniforms.light = program.GetUniform<vec3>("light");
+    uniforms.textureMap = program.GetUniform<int>("textureMap");
+    textureName = CachedTexture(textureFilename);
+    glGenVertexArrays(1, &VAO);
+    if (const char *csv = GpuCsvArg(ac, av))
+        if (!gpu.WriteCsv(csv))
+            printf("can't write %s\n", csv);
 
     // callbacks
     RegisterMouseMove(MouseMove);
     RegisterMouseButton(MouseButton);
     RegisterMouseWheel(MouseWheel);
     RegisterResize(Resize);
+    RegisterKeyboard(Keyboard);
+    printf("Usage:%s    G: print GPU time per pass\n", SimClockUsage());
 
     // event loop
     while (!glfwWindowShouldClose(w)) {
+        simClock.Tick(); // the blend is a function of time: no state to step
         Display();
         glfwPollEvents();
         glfwSwapBuffers(w);
+        gpu.EndFrame();
+        Binds().EndFrame();
     }
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &VBO);
+    Binds().Report();
+    simClock.frames.Report();
+    gpu.Report();
+    TextureStats().Report();
+    gpu.Release();
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &VAO);
     glfwDestroyWindow(w);
     glfwTerminate();
 }
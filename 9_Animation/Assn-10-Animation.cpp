@@ -6,17 +6,26 @@
 #include "glad.h"
 #include "glfw3.h"
 #include "GLXtras.h"
+#include "Program.h"
 #include "Camera.h"
 #include "Draw.h"
 #include "IO.h"
+#include "MeshCache.h"
+#include "VertexLayout.h"
+#include "IndexBuffer.h"
+#include "AssetCache.h"
+#include "AsyncLoader.h"
+#include "LightBlock.h"
+#include "ClusteredLights.h"
+#include "Frustum.h"
 #include <stdio.h>
 #include <vector>
-#include <time.h>
+#include "Timing.h"   // SimClock
 #include <cmath>
 
 
 // GPU program, window, camera
-GLuint program = 0;
+Program program;
 int winWidth = 800, winHeight = 800;
 Camera camera(0, 0, winWidth, winHeight, vec3(15, -15, 0), vec3(0, 0, -5), 30);
 
@@ -25,58 +34,82 @@ vec3 lights[] = {{1,    -.2f, .4f},
                  {-.7f, .8f,  1},
                  {-.5f, -.2f, 1}};
 int nLights = sizeof(lights) / sizeof(vec3);
+LightBlock lightBlock; // the lights, in a uniform buffer shared by programs
+ClusteredLights clusters; // or, with -lights N or K, listed per cell of the view volume
 
+// uniforms, located once the program is linked
+struct {
+    Uniform<mat4> modelview, persp;
+    Uniform<vec3> color;
+} uniforms;
+
+// how vertices are packed in the VBOs (see VertexFormatArg)
+VertexFormat vertexFormat = VertexFormat::Quantized;
+
+// meshes on the GPU; if run with -async, read by a worker pool while
+// placeholders are drawn
+AssetCache assets;
+AsyncLoader loader(assets);
+bool async = false;
+
+// meshes wholly outside the view are skipped; counts printed on exit
+CullStats cullStats;
 
 // meshes
 class HMesh {
 public:
-    vector<vec3> points, normals;     // vertices, normals
-    vector<int3> triangles;           // facets
-    GLuint VAO = 0, VBO = 0, EBO = 0; // vertex array object, vertex buffer, element buffer
+    std::shared_ptr<MeshAsset> asset; // vertices, normals, facets on GPU
+    GLuint VAO = 0, VBO = 0;          // vertex array object, vertex buffer
+    VertexLayout layout;              // attributes in VBO
     mat4 toWorld;                     // transformation to world space
 
     // read obj file, initialize GPU for rendering
     void Read(const char *dir, const char *objName) {
-        // load mesh data from obj file
+        // map mesh from cache, points kept as modeled
         string objFilename(string(dir) + string(objName));
-        if (!ReadAsciiObj(objFilename.c_str(), points, triangles, &normals))
-            printf("can't read %s\n", objFilename.c_str());
-        else {
-            // create vertex array object and buffer object
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
-            glBindVertexArray(VAO);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-            // allocate memory for vertex points and normals
-            size_t sPts = points.size() * sizeof(vec3);
-            size_t sNrms = normals.size() * sizeof(vec3);
-            glBufferData(GL_ARRAY_BUFFER, sPts + sNrms, NULL,
-                         GL_STATIC_DRAW);
-            // load data
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sPts, points.data());
-            glBufferSubData(GL_ARRAY_BUFFER, sPts, sNrms, normals.data());
-
-            // copy triangle data to GPU
-            glGenBuffers(1, &EBO);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         triangles.size() * sizeof(int3), triangles.data(),
-                         GL_STATIC_DRAW);
+        MeshLoadOptions opts;
+        opts.standardize = 0;
+        if (async) {
+            // placeholder until the worker pool has read the mesh
+            UseMesh(assets.PlaceholderMesh());
+            loader.Mesh(objFilename.c_str(), opts, vertexFormat, 1,
+                        [this](std::shared_ptr<MeshAsset> a) { UseMesh(a); });
         }
+        // vertex points and normals packed per vertexFormat, triangles
+        // 16-bit where indices fit
+        else if (!UseMesh(assets.Mesh(objFilename.c_str(), opts, vertexFormat)))
+            printf("can't read %s\n", objFilename.c_str());
+    }
+
+    // draw with a shared mesh
+    bool UseMesh(std::shared_ptr<MeshAsset> a) {
+        if (!a)
+            return false;
+        asset = a;
+        VAO = a->VAO, VBO = a->VBO;
+        layout = a->layout;
+        return true;
     }
 
     // render mesh
     void Render(const vec3 &color) {
-        size_t sPts = points.size() * sizeof(vec3);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        VertexAttribPointer(program, "point", 3, 0, (void *) 0);
-        VertexAttribPointer(program, "normal", 3, 0, (void *) sPts);
-        SetUniform(program, "color", color);
-        SetUniform(program, "modelview", camera.modelview * toWorld);
-        SetUniform(program, "persp", camera.persp);
-        glDrawElements(GL_TRIANGLES, 3 * triangles.size(), GL_UNSIGNED_INT, 0);
+        // bounds, found at load, against the view volume in model space
+        mat4 m = camera.modelview * toWorld;
+        if (asset) {
+            const LodChain &b = asset->lods;
+            bool inView = Frustum(camera.persp * m).Visible(b.lo, b.hi, b.center, b.radius);
+            cullStats.Count(inView ? 1 : 0, 1);
+            if (!inView)
+                return;
+        }
+        // attributes and triangles captured in the VAO at upload
+        Binds().BindVertexArray(VAO);
+        layout.SetUniforms(program);
+        uniforms.color.Set(color);
+        uniforms.modelview.Set(m);
+        uniforms.persp.Set(camera.persp);
+        if (asset)
+            asset->indices.Draw();
     }
 
     // constructor, initializes transformation matrix
@@ -167,33 +200,52 @@ Bezier bezier[] = {Bezier(&path[0]), Bezier(&path[3]), Bezier(&path[6]),
                    Bezier(&path[9])};
 const int nBezier = sizeof(bezier) / sizeof(Bezier);
 
-time_t startTime = clock();
+SimClock simClock; // wall time, paused, scaled or stepped by keys
 float duration = 3;
 Mover mover;
 
+// flight state, advanced in fixed steps: distance along the path (in
+// curves) and propeller angle (in degrees); drawn between the last two
+struct Flight {
+    double beta = 0, spin = 0;
+} flight, lastFlight;
+
+void Simulate(double dt) {
+    lastFlight = flight;
+    flight.beta += nBezier * dt / duration;
+    flight.spin += 1500 * dt;
+}
+
 void Animate() {
-    float elapsed = (float) (clock() - startTime) / CLOCKS_PER_SEC;
-    float alpha = nBezier * elapsed / duration;
-    float beta = fmod(alpha, (float) nBezier);
+    for (int n = simClock.Tick(); n > 0; n--)
+        Simulate(simClock.step);
+    double a = simClock.Alpha();
+    float beta = (float) fmod(lastFlight.beta + a * (flight.beta - lastFlight.beta), (double) nBezier);
+    float spin = (float) fmod(lastFlight.spin + a * (flight.spin - lastFlight.spin), 360.);
     float t = beta - floor(beta);
     int i = (int) floor(beta);
     mat4 f = bezier[i].Frame(t);
     body.toWorld = f * Scale(.35f) * RotateY(-90);
     prop.toWorld =
             body.toWorld * Translate(-.6f, 0, 0) * RotateY(-90) * Scale(.25f) *
-            RotateZ(1500 * elapsed);
+            RotateZ(spin);
 }
 
 
 // shaders
 const char *vertexShader = R"(
 	#version 410 core
-	in vec3 point, normal;
+	layout(location = 0) in vec3 point;
+	layout(location = 1) in vec3 normal;
 	out vec3 vPoint, vNormal;
 	uniform mat4 modelview, persp;
+	uniform vec3 pointScale = vec3(1), pointOffset = vec3(0); // undo quantization
+	uniform bool octNormals = false;                           // normal.xy octahedral
 	void main() {
-		vPoint = (modelview*vec4(point, 1)).xyz;
-		vNormal = (modelview*vec4(normal, 0)).xyz;
+		vec3 p = pointOffset + pointScale*point;
+		vec3 n = octNormals ? OctDecode(normal.xy) : normal;
+		vPoint = (modelview*vec4(p, 1)).xyz;
+		vNormal = (modelview*vec4(n, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 	}
 )";
@@ -201,22 +253,27 @@ const char *vertexShader = R"(
 const char *pixelShader = R"(
 	#version 410 core
 	in vec3 vPoint, vNormal;
-	uniform int nLights = 0;
-	uniform vec3 lights[20];
 	uniform vec3 color;
 	out vec4 pColor;
 	void main() {
-		float d = 0, s = 0;							// diffuse, specular terms
+		vec3 d = vec3(0), s = vec3(0);			// diffuse, specular terms
 		vec3 N = normalize(vNormal);
 		vec3 E = normalize(vPoint);					// eye vector
-		for (int i = 0; i < nLights; i++) {
-			vec3 L = normalize(lights[i]-vPoint);	// light vector
+		int first, n = LightCount(vPoint, first);
+		for (int k = 0; k < n; k++) {
+			Light light = GetLight(first, k);
+			vec3 l = light.position.xyz-vPoint;
+			float range = light.position.w;
+			float a = light.color.a;			// intensity, faded by range
+			if (range > 0) a *= pow(clamp(1-length(l)/range, 0, 1), 2);
+			vec3 c = a*light.color.rgb;
+			vec3 L = normalize(l);					// light vector
 			vec3 R = reflect(L, N);					// highlight vector
-			d += max(0, dot(N, L));					// one-sided diffuse
+			d += c*max(0, dot(N, L));				// one-sided diffuse
 			float h = max(0, dot(R, E));			// highlight term
-			s += pow(h, 100);						// specular term
+			s += c*pow(h, 100);						// specular term
 		}
-		float ads = clamp(.1+.7*d+.7*s, 0, 1);
+		vec3 ads = clamp(.1+.7*d+.7*s, 0, 1);
 		pColor = vec4(ads*color, 1);
 	}
 )";
@@ -227,12 +284,10 @@ void Display() {
     glClearColor(1, 1, 1, 1);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
-    glUseProgram(program);
+    program.Use();
 
-    // lights
-    SetUniform(program, "nLights", nLights);
-    SetUniform3v(program, "lights", nLights, (float *) lights,
-                 camera.modelview);
+    // lights, sent if they or the camera moved
+    clusters.Update(lightBlock, lights, nLights, camera.modelview, camera.persp);
 
     // render plane and prop
     body.Render(bodyColor);
@@ -269,6 +324,11 @@ void Keyboard(int k, bool press, bool shift, bool control) {
     if (press) {
         if (k == 'P')
             isFlightPathDisplayed = !isFlightPathDisplayed;
+        if (k == 'K') {
+            clusters.enabled = !clusters.enabled;
+            printf("clustered lights %s\n", clusters.enabled ? "on" : "off");
+        }
+        SimClockKey(simClock, k);
     }
 }
 
@@ -282,7 +342,21 @@ int main(int ac, char **av) {
 
     // init app, GPU program
     GLFWwindow *w = InitGLFW(100, 100, winWidth, winHeight, "Aerial Animation");
-    program = LinkProgramViaCode(&vertexShader, &pixelShader);
+    std::string vertexCode = AddOctCode(vertexShader); // with OctDecode
+    std::string pixelCode = AddLightCode(pixelShader); // with LightCount, GetLight
+    const char *vertexOct = vertexCode.c_str(), *pixelLit = pixelCode.c_str();
+    program.Link(&vertexOct, &pixelLit);
+    uniforms.modelview = program.GetUniform<mat4>("modelview");
+    uniforms.persp = program.GetUniform<mat4>("persp");
+    uniforms.color = program.GetUniform<vec3>("color");
+    lightBlock.Attach(program);
+    clusters.Attach(program);
+    vertexFormat = VertexFormatArg(ac, av);
+    async = AsyncArg(ac, av);
+    if (int n = LightsArg(ac, av)) {
+        clusters.Scatter(n, vec3(-1, -1, -1), vec3(1, 1, 1));
+        clusters.enabled = true;
+    }
 
     // read models
     body.Read("/Users/nadin/Documents/Graphics/Apps/Assets/",
@@ -296,18 +370,31 @@ int main(int ac, char **av) {
     RegisterMouseWheel(MouseWheel);
     RegisterResize(Resize);
     RegisterKeyboard(Keyboard);
+    printf("Usage:\n    P: show or hide the flight path\n    K: toggle clustered lights%s"
+           "    Run with -lights N to add N lights with a range\n", SimClockUsage());
 
     // event loop
     while (!glfwWindowShouldClose(w)) {
         Animate();
+        loader.Update(); // upload and swap in what the worker pool has read
         Display();
         glfwSwapBuffers(w);
+        loader.FrameDone();
+        Binds().EndFrame();
+        cullStats.EndFrame();
         glfwPollEvents();
     }
+    Binds().Report();
+    lightBlock.Report();
+    clusters.Report();
+    cullStats.Report();
+    simClock.frames.Report();
 
     // unbind vertex buffer, free GPU memory
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &body.VBO);
+    body.asset = prop.asset = NULL;
+    lightBlock.Release();
+    clusters.Release();
     glfwDestroyWindow(w);
     glfwTerminate();
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+// Author: Nadezhda Chernova
+// File: Args.h
+// Date: 10/16/2026
+// Command-line flags and values shared by the apps' Arg helpers
+
+#ifndef ARGS_HDR
+#define ARGS_HDR
+
+#include <stdlib.h>
+#include <string.h>
+
+// name among command-line arguments
+inline bool FlagArg(int ac, char **av, const char *name) {
+    for (int i = 1; i < ac; i++)
+        if (!strcmp(av[i], name))
+            return true;
+    return false;
+}
+
+// value after name among command-line arguments, else def
+inline int IntArg(int ac, char **av, const char *name, int def) {
+    for (int i = 1; i + 1 < ac; i++)
+        if (!strcmp(av[i], name))
+            return atoi(av[i + 1]);
+    return def;
+}
+
+#endif
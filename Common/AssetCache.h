@@ -0,0 +1,313 @@
+// Author: Nadezhda Chernova
+// File: AssetCache.h
+// Date: 10/16/2026
+// Shared, reference-counted GPU meshes and textures, one per file and options
+
+#ifndef ASSET_CACHE_HDR
+#define ASSET_CACHE_HDR
+
+#include "glad.h"
+#include "MeshCache.h"    // CachedMesh, LoadCachedMesh
+#include "VertexLayout.h" // VertexLayout, BufferMeshVertices
+#include "IndexBuffer.h"  // IndexBuffer
+#include "MeshLod.h"      // LodChain, BuildLodChain
+#include "OcclusionCuller.h" // OccluderMesh, MakeOccluder
+#include "NormalMap.h"    // NormalMapOptions, LoadNormalMap
+#include "TextureFile.h"  // TextureFile
+#include "TextureCache.h" // LoadCachedTexture, HaveS3tc
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+// absolute path with links and . and .. resolved; filename if it doesn't exist
+inline string CanonicalPath(const char *filename) {
+#ifdef _WIN32
+    char path[_MAX_PATH];
+    if (_fullpath(path, filename, _MAX_PATH))
+        return path;
+#else
+    if (char *path = realpath(filename, NULL)) {
+        string s(path);
+        free(path);
+        return s;
+    }
+#endif
+    return filename;
+}
+
+// CPU side of a mesh asset: the mapped mesh and its levels of detail; may be
+// prepared on any thread, then uploaded on the GL thread by AssetCache::AddMesh
+class MeshData {
+public:
+    CachedMesh mesh;
+    LodChain lods;
+
+    MeshData() {}
+    MeshData(const MeshData &) = delete;
+    MeshData &operator=(const MeshData &) = delete;
+};
+
+// map (or parse and cache) objFilename, build levels levels of detail
+inline bool PrepareMesh(const char *objFilename, MeshLoadOptions opts, int levels,
+                        MeshData &data) {
+    if (!LoadCachedMesh(objFilename, data.mesh, opts))
+        return false;
+    const CachedMesh &m = data.mesh;
+    BuildLodChain(m.points, m.normals, m.nPoints, m.triangles, m.nTriangles, data.lods, levels);
+    return true;
+}
+
+// a mesh on the GPU; deleted with the last shared_ptr to it
+class MeshAsset {
+public:
+    string filename;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    VertexLayout layout;              // attributes in VBO
+    IndexBuffer indices;              // triangles in EBO, all levels of detail
+    LodChain lods;                    // level sizes, errors, bounding sphere
+    std::shared_ptr<const OccluderMesh> occluder; // coarsest level, on the CPU (see keepOccluders)
+    int nPoints = 0;
+
+    size_t VertexBytes() const { return nPoints * layout.vertexSize; }
+    size_t IndexBytes() const { return indices.Size(); }
+
+    MeshAsset() {}
+    MeshAsset(const MeshAsset &) = delete;
+    MeshAsset &operator=(const MeshAsset &) = delete;
+    ~MeshAsset() {
+        if (VBO) glDeleteBuffers(1, &VBO);
+        if (EBO) glDeleteBuffers(1, &EBO);
+        if (VAO) glDeleteVertexArrays(1, &VAO);
+    }
+};
+
+// a texture on the GPU; deleted with the last shared_ptr to it
+class TextureAsset {
+public:
+    string filename;
+    GLuint textureName = 0;
+    int width = 0, height = 0;
+    size_t bytes = 0;               // as uploaded, all levels
+
+    TextureAsset() {}
+    TextureAsset(const TextureAsset &) = delete;
+    TextureAsset &operator=(const TextureAsset &) = delete;
+    ~TextureAsset() {
+        if (textureName) glDeleteTextures(1, &textureName);
+    }
+};
+
+// registry of assets in use, keyed by canonical path and load options; an
+// asset is read and uploaded once however many meshes share it, and freed
+// when the last of them lets go
+class AssetCache {
+public:
+    // meshes added keep an occluder (for an OcclusionCuller); set before loading
+    bool keepOccluders = false;
+
+    // levels > 1 builds a level of detail chain (see BuildLodChain)
+    std::shared_ptr<MeshAsset> Mesh(const char *objFilename,
+                                    MeshLoadOptions opts = MeshLoadOptions(),
+                                    VertexFormat format = VertexFormat::Quantized,
+                                    int levels = 1) {
+        string key = MeshKey(objFilename, opts, format, levels);
+        if (std::shared_ptr<MeshAsset> a = FindMesh(key))
+            return a;
+        MeshData data;
+        if (!PrepareMesh(objFilename, opts, levels, data))
+            return NULL;
+        return AddMesh(key, objFilename, data, format);
+    }
+
+    // an image texture, block compressed with mipmaps and mapped from its
+    // cache (see LoadCachedTexture)
+    std::shared_ptr<TextureAsset> Texture(const char *filename) {
+        string key = CanonicalPath(filename);
+        if (std::shared_ptr<TextureAsset> a = FindTexture(key))
+            return a;
+        TextureFile file;
+        if (!LoadCachedTexture(filename, HaveS3tc(), file))
+            return NULL;
+        return AddTextureFile(key, filename, file);
+    }
+
+    // a normal map converted from a bump or height image, mapped from its
+    // cache (see LoadNormalMap)
+    std::shared_ptr<TextureAsset> NormalMap(const char *filename,
+                                            NormalMapOptions opts = NormalMapOptions()) {
+        string key = NormalMapKey(filename, opts);
+        if (std::shared_ptr<TextureAsset> a = FindTexture(key))
+            return a;
+        TextureFile file;
+        if (!LoadNormalMap(filename, opts, file))
+            return NULL;
+        return AddTextureFile(key, filename, file);
+    }
+
+    // the pieces of Mesh, Texture and NormalMap, for loaders that read files elsewhere
+
+    string NormalMapKey(const char *filename, const NormalMapOptions &opts) {
+        return CanonicalPath(filename) + "|" + NormalMapOptionString(opts);
+    }
+
+    string MeshKey(const char *objFilename, const MeshLoadOptions &opts, VertexFormat format,
+                   int levels) {
+        char options[100];
+        snprintf(options, sizeof(options), "|%g %d %d %d %d %d %d", opts.standardize,
+                 (int) opts.setNormals, (int) opts.normalWeight, (int) opts.optimize,
+                 (int) opts.setTangents, (int) format, levels);
+        return CanonicalPath(objFilename) + options;
+    }
+
+    std::shared_ptr<MeshAsset> FindMesh(const string &key) {
+        auto i = meshes.find(key);
+        return i == meshes.end() ? NULL : i->second.lock();
+    }
+
+    std::shared_ptr<TextureAsset> FindTexture(const string &key) {
+        auto i = textures.find(key);
+        return i == textures.end() ? NULL : i->second.lock();
+    }
+
+    // upload prepared mesh data, register it under key; on the GL thread
+    std::shared_ptr<MeshAsset> AddMesh(const string &key, const char *filename, MeshData &data,
+                                       VertexFormat format) {
+        const CachedMesh &mesh = data.mesh;
+        std::shared_ptr<MeshAsset> a = std::make_shared<MeshAsset>();
+        a->filename = filename;
+        a->nPoints = mesh.nPoints;
+        glGenVertexArrays(1, &a->VAO);
+        glBindVertexArray(a->VAO);
+        glGenBuffers(1, &a->VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, a->VBO);
+        a->layout = BufferMeshVertices(mesh, format);
+        glGenBuffers(1, &a->EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, a->EBO);
+        a->lods = std::move(data.lods);
+        a->indices.Buffer(a->lods.triangles.data(), a->lods.counts, mesh.nPoints, mesh.points);
+        if (keepOccluders)
+            a->occluder = MakeOccluder(mesh.points, mesh.normals, a->lods);
+        a->lods.triangles = vector<int3>(); // in the EBO now
+        a->layout.Capture(a->VBO);         // attributes in the VAO
+        meshes[key] = a;
+        return a;
+    }
+
+    // upload width x height RGBA pixels, bottom row first, with mipmaps;
+    // register under key; on the GL thread
+    std::shared_ptr<TextureAsset> AddTexture(const string &key, const char *filename,
+                                             const unsigned char *pixels, int width, int height) {
+        std::shared_ptr<TextureAsset> a = std::make_shared<TextureAsset>();
+        a->filename = filename;
+        a->width = width;
+        a->height = height;
+        glGenTextures(1, &a->textureName);
+        glBindTexture(GL_TEXTURE_2D, a->textureName);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        a->bytes = (size_t) width * height * 4 * 4 / 3;
+        textures[key] = a;
+        return a;
+    }
+
+    // upload the levels of a texture file as they are; on the GL thread
+    std::shared_ptr<TextureAsset> AddTextureFile(const string &key, const char *filename,
+                                                 const TextureFile &file) {
+        std::shared_ptr<TextureAsset> a = std::make_shared<TextureAsset>();
+        a->filename = filename;
+        a->width = file.width;
+        a->height = file.height;
+        a->textureName = file.Upload();
+        a->bytes = file.Bytes();
+        if (!a->textureName)
+            return NULL;
+        textures[key] = a;
+        return a;
+    }
+
+    // stand-ins drawn until assets arrive: an octahedron of the given radius
+    // with smooth normals, and a single texel of the given color (light gray,
+    // or for a bump map, a flat (.5, .5, 1))
+    std::shared_ptr<MeshAsset> PlaceholderMesh(float radius = .5f) {
+        char key[50];
+        snprintf(key, sizeof(key), "placeholder|%g", radius);
+        if (std::shared_ptr<MeshAsset> a = FindMesh(key))
+            return a;
+        vector<vec3> points, normals;
+        vector<vec2> uvs;
+        vector<int3> triangles;
+        for (int k = 0; k < 3; k++)
+            for (int s = -1; s <= 1; s += 2) {
+                vec3 n(0, 0, 0);
+                n[k] = (float) s;
+                normals.push_back(n);
+                points.push_back(radius * n);
+                uvs.push_back(vec2(.5f, .5f));
+            }
+        // +x -x +y -y +z -z; one triangle per octant, counter-clockwise seen from outside
+        for (int x = 0; x < 2; x++)
+            for (int y = 2; y < 4; y++)
+                for (int z = 4; z < 6; z++) {
+                    int flips = (x == 1) + (y == 3) + (z == 5);
+                    triangles.push_back(flips % 2 ? int3(x, z, y) : int3(x, y, z));
+                }
+        vector<vec4> tangents;
+        MeshData data;
+        data.mesh.Adopt(points, normals, uvs, tangents, triangles);
+        const CachedMesh &m = data.mesh;
+        BuildLodChain(m.points, m.normals, m.nPoints, m.triangles, m.nTriangles, data.lods, 1);
+        return AddMesh(key, "placeholder", data, VertexFormat::Separate);
+    }
+
+    std::shared_ptr<TextureAsset> PlaceholderTexture(vec3 color = vec3(.8f, .8f, .8f)) {
+        unsigned char texel[4] = {255, 255, 255, 255};
+        for (int k = 0; k < 3; k++)
+            texel[k] = (unsigned char) (255 * std::min(1.f, std::max(0.f, color[k])) + .5f);
+        char key[50];
+        snprintf(key, sizeof(key), "placeholder|%d %d %d", texel[0], texel[1], texel[2]);
+        if (std::shared_ptr<TextureAsset> a = FindTexture(key))
+            return a;
+        return AddTexture(key, "placeholder", texel, 1, 1);
+    }
+
+    // GPU memory per asset still in use, and the total
+    void Report() {
+        auto Name = [](const string &f) {
+            size_t slash = f.find_last_of("/\\");
+            return slash == string::npos ? f : f.substr(slash + 1);
+        };
+        auto Mb = [](size_t bytes) { return bytes / (1024. * 1024.); };
+        size_t total = 0;
+        printf("assets:\n");
+        for (auto &m : meshes)
+            if (std::shared_ptr<MeshAsset> a = m.second.lock()) {
+                printf("  %-24s %3ld users  vertices %7.3f MB  indices %7.3f MB (%s)\n",
+                       Name(a->filename).c_str(), a.use_count() - 1, Mb(a->VertexBytes()),
+                       Mb(a->IndexBytes()), a->indices.type == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit");
+                total += a->VertexBytes() + a->IndexBytes();
+            }
+        for (auto &t : textures)
+            if (std::shared_ptr<TextureAsset> a = t.second.lock()) {
+                printf("  %-24s %3ld users  texture  %7.3f MB (%dx%d)\n", Name(a->filename).c_str(),
+                       a.use_count() - 1, Mb(a->bytes), a->width, a->height);
+                total += a->bytes;
+            }
+        printf("  total %.3f MB\n", Mb(total));
+        TextureStats().Report();
+    }
+
+private:
+    std::map<string, std::weak_ptr<MeshAsset>> meshes;
+    std::map<string, std::weak_ptr<TextureAsset>> textures;
+};
+
+#endif
@@ -0,0 +1,212 @@
+// Author: Nadezhda Chernova
+// File: AsyncLoader.h
+// Date: 10/16/2026
+// Meshes and textures read by a worker pool while the app renders,
+// uploaded and swapped in on the GL thread
+
+#ifndef ASYNC_LOADER_HDR
+#define ASYNC_LOADER_HDR
+
+#include "AssetCache.h" // AssetCache, MeshData, PrepareMesh
+#include "WorkerPool.h" // WorkerPool
+#include "TextureCache.h" // LoadCachedTexture, HaveS3tc
+#include "Args.h" // FlagArg
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// loads assets in the background: file I/O, OBJ parsing, normals, levels of
+// detail and texture decoding and compression run on a worker pool; Update,
+// called each frame on the GL thread, uploads what is ready and hands it to
+// its callback.
+// Requests for an asset already loaded or on its way share it
+class AsyncLoader {
+public:
+    typedef std::function<void(std::shared_ptr<MeshAsset>)> MeshDone;
+    typedef std::function<void(std::shared_ptr<TextureAsset>)> TextureDone;
+
+    // start is the reference for the times FrameDone reports: with a global
+    // loader, about when the app started
+    AsyncLoader(AssetCache &assets, int nThreads = 0)
+        : assets(assets), nThreads(nThreads), start(Clock::now()) {}
+
+    // done gets the mesh (NULL if it can't be read) during a later Update,
+    // or now if the mesh is already loaded
+    void Mesh(const char *objFilename, MeshLoadOptions opts, VertexFormat format, int levels,
+              MeshDone done) {
+        string key = assets.MeshKey(objFilename, opts, format, levels);
+        if (std::shared_ptr<MeshAsset> a = assets.FindMesh(key)) {
+            done(a);
+            return;
+        }
+        vector<MeshDone> &waiting = meshWaiting[key];
+        waiting.push_back(done);
+        if (waiting.size() > 1)
+            return; // already on its way
+        nRequested++;
+        string filename(objFilename);
+        Pool().Run([=]() {
+            std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+            bool ok = PrepareMesh(filename.c_str(), opts, levels, *data);
+            Post([=]() {
+                std::shared_ptr<MeshAsset> a;
+                if (ok)
+                    a = assets.AddMesh(key, filename.c_str(), *data, format);
+                else
+                    printf("can't read %s\n", filename.c_str());
+                vector<MeshDone> callbacks;
+                callbacks.swap(meshWaiting[key]);
+                meshWaiting.erase(key);
+                for (MeshDone &d : callbacks)
+                    d(a);
+            });
+        });
+    }
+
+    // as above, for a texture
+    void Texture(const char *filename, TextureDone done) {
+        string key = CanonicalPath(filename);
+        if (std::shared_ptr<TextureAsset> a = assets.FindTexture(key)) {
+            done(a);
+            return;
+        }
+        vector<TextureDone> &waiting = textureWaiting[key];
+        waiting.push_back(done);
+        if (waiting.size() > 1)
+            return;
+        nRequested++;
+        string name(filename);
+        bool compress = HaveS3tc(); // asked here, on the GL thread
+        Pool().Run([=]() {
+            std::shared_ptr<TextureFile> file = std::make_shared<TextureFile>();
+            bool ok = LoadCachedTexture(name.c_str(), compress, *file);
+            Post([=]() {
+                std::shared_ptr<TextureAsset> a;
+                if (ok)
+                    a = assets.AddTextureFile(key, name.c_str(), *file);
+                else
+                    printf("can't read %s\n", name.c_str());
+                vector<TextureDone> callbacks;
+                callbacks.swap(textureWaiting[key]);
+                textureWaiting.erase(key);
+                for (TextureDone &d : callbacks)
+                    d(a);
+            });
+        });
+    }
+
+    // as above, for a normal map (converted and cached by the worker, if
+    // not cached already)
+    void NormalMap(const char *filename, NormalMapOptions opts, TextureDone done) {
+        string key = assets.NormalMapKey(filename, opts);
+        if (std::shared_ptr<TextureAsset> a = assets.FindTexture(key)) {
+            done(a);
+            return;
+        }
+        vector<TextureDone> &waiting = textureWaiting[key];
+        waiting.push_back(done);
+        if (waiting.size() > 1)
+            return;
+        nRequested++;
+        string name(filename);
+        Pool().Run([=]() {
+            std::shared_ptr<TextureFile> file = std::make_shared<TextureFile>();
+            bool ok = LoadNormalMap(name.c_str(), opts, *file);
+            Post([=]() {
+                std::shared_ptr<TextureAsset> a;
+                if (ok)
+                    a = assets.AddTextureFile(key, name.c_str(), *file);
+                else
+                    printf("can't read %s\n", name.c_str());
+                vector<TextureDone> callbacks;
+                callbacks.swap(textureWaiting[key]);
+                textureWaiting.erase(key);
+                for (TextureDone &d : callbacks)
+                    d(a);
+            });
+        });
+    }
+
+    // upload assets the workers have finished, swap them in; stop once
+    // budgetMs is spent (after at least one), leaving the rest for the
+    // next frame; return the number uploaded
+    int Update(double budgetMs = 4) {
+        Clock::time_point begin = Clock::now();
+        int n = 0;
+        for (;;) {
+            std::function<void()> upload;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ready.empty())
+                    break;
+                upload = std::move(ready.front());
+                ready.erase(ready.begin());
+            }
+            upload();
+            n++;
+            if (Ms(begin, Clock::now()) >= budgetMs)
+                break;
+        }
+        return n;
+    }
+
+    // assets requested but not yet swapped in
+    int Pending() const { return (int) (meshWaiting.size() + textureWaiting.size()); }
+
+    // call after each glfwSwapBuffers: reports time to the first frame and,
+    // once requests have all been served, time to the complete scene
+    void FrameDone() {
+        if (!nFrames++)
+            printf("first frame after %.0f ms\n", Ms(start, Clock::now()));
+        if (nRequested && !Pending() && !reported) {
+            reported = true;
+            printf("%d assets loaded after %.0f ms (%d frames)\n", nRequested,
+                   Ms(start, Clock::now()), nFrames);
+        }
+    }
+
+    AsyncLoader(const AsyncLoader &) = delete;
+    AsyncLoader &operator=(const AsyncLoader &) = delete;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    AssetCache &assets;
+    int nThreads;
+    Clock::time_point start;
+    int nRequested = 0, nFrames = 0;
+    bool reported = false;
+    // GL thread only
+    std::map<string, vector<MeshDone>> meshWaiting;
+    std::map<string, vector<TextureDone>> textureWaiting;
+    // uploads posted by workers
+    std::mutex mutex;
+    vector<std::function<void()>> ready;
+    // last, so its threads are joined before the above go away
+    std::unique_ptr<WorkerPool> pool;
+
+    static double Ms(Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    }
+
+    // threads start with the first request
+    WorkerPool &Pool() {
+        if (!pool)
+            pool.reset(new WorkerPool(nThreads));
+        return *pool;
+    }
+
+    void Post(std::function<void()> upload) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(std::move(upload));
+    }
+};
+
+// -async among command-line arguments
+inline bool AsyncArg(int ac, char **av) { return FlagArg(ac, av, "-async"); }
+
+#endif
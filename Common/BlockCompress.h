@@ -0,0 +1,246 @@
+// Author: Nadezhda Chernova
+// File: BlockCompress.h
+// Date: 10/16/2026
+// Block compression of texture levels on the CPU, 4x4 texels at a time,
+// in the formats GL samples directly
+
+#ifndef BLOCK_COMPRESS_HDR
+#define BLOCK_COMPRESS_HDR
+
+#include "Parallel.h" // ParallelFor
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// 16 values (a 4x4 block, row by row) as BC4 (RGTC1): two endpoint bytes,
+// then a 3-bit index per value, least significant first; with the first
+// endpoint the larger, the indices pick among the endpoints and six values
+// evenly between, so rounding each value to the nearest of eight steps
+// picks its nearest
+inline void EncodeBC4(const uint8_t v[16], uint8_t out[8]) {
+    int lo = v[0], hi = v[0];
+    for (int i = 1; i < 16; i++) {
+        lo = v[i] < lo ? v[i] : lo;
+        hi = v[i] > hi ? v[i] : hi;
+    }
+    out[0] = (uint8_t) hi;
+    out[1] = (uint8_t) lo;
+    uint64_t bits = 0;
+    if (hi > lo) {
+        int range = hi - lo;
+        for (int i = 0; i < 16; i++) {
+            // step 0 at lo, 7 at hi; step 7 is index 0, step 0 index 1, step s index 8-s
+            int s = (14 * (v[i] - lo) + range) / (2 * range);
+            uint64_t index = s == 7 ? 0 : s == 0 ? 1 : 8 - s;
+            bits |= index << (3 * i);
+        }
+    }
+    for (int k = 0; k < 6; k++)
+        out[2 + k] = (uint8_t) (bits >> (8 * k));
+}
+
+// the 16 values of a BC4 block, as a GPU decodes them
+inline void DecodeBC4(const uint8_t block[8], uint8_t v[16]) {
+    int e0 = block[0], e1 = block[1], p[8] = {e0, e1};
+    if (e0 > e1)
+        for (int i = 2; i < 8; i++)
+            p[i] = ((8 - i) * e0 + (i - 1) * e1) / 7;
+    else {
+        for (int i = 2; i < 6; i++)
+            p[i] = ((6 - i) * e0 + (i - 1) * e1) / 5;
+        p[6] = 0;
+        p[7] = 255;
+    }
+    uint64_t bits = 0;
+    for (int k = 0; k < 6; k++)
+        bits |= (uint64_t) block[2 + k] << (8 * k);
+    for (int i = 0; i < 16; i++)
+        v[i] = (uint8_t) p[(bits >> (3 * i)) & 7];
+}
+
+// 8-bit color to 5:6:5, and back (the top bits repeated below, as GPUs expand)
+inline uint16_t To565(float r, float g, float b) {
+    auto Q = [](float c, int bits) {
+        int m = (1 << bits) - 1, q = (int) lroundf(c * m / 255);
+        return q < 0 ? 0 : q > m ? m : q;
+    };
+    return (uint16_t) (Q(r, 5) << 11 | Q(g, 6) << 5 | Q(b, 5));
+}
+
+inline void From565(uint16_t c, int rgb[3]) {
+    int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+// 16 colors (a 4x4 block, channels apart) as a BC1 color block: two 5:6:5
+// endpoints, the first larger (four colors: the endpoints and two between),
+// then a 2-bit index per texel, least significant first. The endpoints lie
+// along the colors' principal axis (by power iteration), at their extremes
+// or pulled in by a sixteenth of their span, whichever decodes closer; each
+// texel takes the nearest of the four colors as decoded
+inline void EncodeBC1(const uint8_t rgb[3][16], uint8_t out[8]) {
+    float mean[3] = {0, 0, 0};
+    for (int k = 0; k < 3; k++) {
+        for (int i = 0; i < 16; i++)
+            mean[k] += rgb[k][i];
+        mean[k] /= 16;
+    }
+    float cov[6] = {0, 0, 0, 0, 0, 0}; // rr, rg, rb, gg, gb, bb
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {rgb[0][i] - mean[0], rgb[1][i] - mean[1], rgb[2][i] - mean[2]};
+        cov[0] += d[0] * d[0], cov[1] += d[0] * d[1], cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1], cov[4] += d[1] * d[2], cov[5] += d[2] * d[2];
+    }
+    float axis[3] = {1, 1, 1};
+    for (int it = 0; it < 8; it++) {
+        float a[3] = {cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                      cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                      cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+        float len = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+        if (len < 1e-6f)
+            break; // a single color: any axis will do
+        for (int k = 0; k < 3; k++)
+            axis[k] = a[k] / len;
+    }
+    float lo = 0, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        float t = 0;
+        for (int k = 0; k < 3; k++)
+            t += (rgb[k][i] - mean[k]) * axis[k];
+        lo = t < lo ? t : lo;
+        hi = t > hi ? t : hi;
+    }
+    // the block for endpoints at lo and hi along the axis, and its error
+    auto Encode = [&](float lo, float hi, uint8_t block[8]) {
+        uint16_t c0 = To565(mean[0] + hi * axis[0], mean[1] + hi * axis[1], mean[2] + hi * axis[2]);
+        uint16_t c1 = To565(mean[0] + lo * axis[0], mean[1] + lo * axis[1], mean[2] + lo * axis[2]);
+        if (c0 < c1) {
+            uint16_t c = c0;
+            c0 = c1;
+            c1 = c;
+        }
+        // with c0 == c1 every index is 0, the one color either way
+        int p[4][3];
+        From565(c0, p[0]);
+        From565(c1, p[1]);
+        for (int k = 0; k < 3; k++) {
+            p[2][k] = (2 * p[0][k] + p[1][k]) / 3;
+            p[3][k] = (p[0][k] + 2 * p[1][k]) / 3;
+        }
+        int nColors = c0 > c1 ? 4 : 1, error = 0;
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestD = 1 << 30;
+            for (int j = 0; j < nColors; j++) {
+                int dr = rgb[0][i] - p[j][0], dg = rgb[1][i] - p[j][1], db = rgb[2][i] - p[j][2];
+                int d = dr * dr + dg * dg + db * db;
+                if (d < bestD) {
+                    best = j;
+                    bestD = d;
+                }
+            }
+            bits |= (uint32_t) best << (2 * i);
+            error += bestD;
+        }
+        block[0] = (uint8_t) c0, block[1] = (uint8_t) (c0 >> 8);
+        block[2] = (uint8_t) c1, block[3] = (uint8_t) (c1 >> 8);
+        for (int k = 0; k < 4; k++)
+            block[4 + k] = (uint8_t) (bits >> (8 * k));
+        return error;
+    };
+    float inset = (hi - lo) / 16;
+    uint8_t inner[8];
+    if (Encode(lo + inset, hi - inset, inner) < Encode(lo, hi, out))
+        for (int k = 0; k < 8; k++)
+            out[k] = inner[k];
+}
+
+// the 16 colors of a BC1 block, as a GPU decodes them; in BC3 the color
+// block always has four colors
+inline void DecodeBC1(const uint8_t block[8], uint8_t rgb[3][16], bool fourColors = false) {
+    uint16_t c0 = (uint16_t) (block[0] | block[1] << 8), c1 = (uint16_t) (block[2] | block[3] << 8);
+    int p[4][3];
+    From565(c0, p[0]);
+    From565(c1, p[1]);
+    for (int k = 0; k < 3; k++)
+        if (c0 > c1 || fourColors) {
+            p[2][k] = (2 * p[0][k] + p[1][k]) / 3;
+            p[3][k] = (p[0][k] + 2 * p[1][k]) / 3;
+        }
+        else {
+            p[2][k] = (p[0][k] + p[1][k]) / 2;
+            p[3][k] = 0;
+        }
+    uint32_t bits = 0;
+    for (int k = 0; k < 4; k++)
+        bits |= (uint32_t) block[4 + k] << (8 * k);
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            rgb[k][i] = (uint8_t) p[(bits >> (2 * i)) & 3][k];
+}
+
+// channel c of the 4x4 block at (bx, by) of w x h texels of n bytes each,
+// the edge texels repeated past the image
+inline void GatherBlock(const uint8_t *texels, int w, int h, int n, int c, int bx, int by,
+                        uint8_t v[16]) {
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++) {
+            int tx = 4 * bx + x < w ? 4 * bx + x : w - 1, ty = 4 * by + y < h ? 4 * by + y : h - 1;
+            v[4 * y + x] = texels[((size_t) ty * w + tx) * n + c];
+        }
+}
+
+// bytes of a w x h level in 4x4 blocks of blockBytes each
+inline size_t BlockLevelSize(int w, int h, int blockBytes) {
+    return (size_t) ((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+}
+
+// w x h texels of n bytes each in blocks of blockBytes, by
+// Encode(v, block), v the block's channels; rows of blocks run in parallel
+template <typename F>
+void CompressBlocks(const uint8_t *texels, int w, int h, int n, int blockBytes,
+                    std::vector<uint8_t> &out, F Encode, int nThreads = 0) {
+    int bw = (w + 3) / 4, bh = (h + 3) / 4;
+    out.resize(BlockLevelSize(w, h, blockBytes));
+    ParallelFor(bh, [&](int, int begin, int end) {
+        uint8_t v[4][16];
+        for (int by = begin; by < end; by++)
+            for (int bx = 0; bx < bw; bx++) {
+                for (int c = 0; c < n; c++)
+                    GatherBlock(texels, w, h, n, c, bx, by, v[c]);
+                Encode(v, &out[blockBytes * ((size_t) by * bw + bx)]);
+            }
+    }, nThreads);
+}
+
+// two-byte texels (red, green) as BC5 (GL_COMPRESSED_RG_RGTC2): 16 bytes
+// per block, BC4 red then BC4 green
+inline void CompressBC5(const uint8_t *rg, int w, int h, std::vector<uint8_t> &out,
+                        int nThreads = 0) {
+    CompressBlocks(rg, w, h, 2, 16, out, [](const uint8_t v[4][16], uint8_t *block) {
+        EncodeBC4(v[0], block);
+        EncodeBC4(v[1], block + 8);
+    }, nThreads);
+}
+
+// RGBA texels as BC1 (DXT1, opaque), 8 bytes per block, alpha dropped
+inline void CompressBC1(const uint8_t *rgba, int w, int h, std::vector<uint8_t> &out,
+                        int nThreads = 0) {
+    CompressBlocks(rgba, w, h, 4, 8, out, [](const uint8_t v[4][16], uint8_t *block) {
+        EncodeBC1(v, block);
+    }, nThreads);
+}
+
+// RGBA texels as BC3 (DXT5): 16 bytes per block, BC4 alpha then BC1 color
+inline void CompressBC3(const uint8_t *rgba, int w, int h, std::vector<uint8_t> &out,
+                        int nThreads = 0) {
+    CompressBlocks(rgba, w, h, 4, 16, out, [](const uint8_t v[4][16], uint8_t *block) {
+        EncodeBC4(v[3], block);
+        EncodeBC1(v, block + 8);
+    }, nThreads);
+}
+
+#endif
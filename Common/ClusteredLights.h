@@ -0,0 +1,480 @@
+// Author: Nadezhda Chernova
+// File: ClusteredLights.h
+// Date: 10/16/2026
+// Clustered forward lighting: lights with a range assigned on the CPU to the
+// cells of a grid over the view volume, each pixel lit by its cell's lights
+
+#ifndef CLUSTERED_LIGHTS_HDR
+#define CLUSTERED_LIGHTS_HDR
+
+#include "glad.h"
+#include "VecMat.h"     // vec3, vec4, mat4
+#include "Simd.h"       // f4, LessMask
+#include "Parallel.h"   // ParallelFor
+#include "Program.h"    // Program, Uniform
+#include "GLState.h"    // Binds
+#include "LightBlock.h" // LightBlock
+#include "Args.h"       // IntArg
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// GLSL for pixel shaders, forward or clustered: the Lights block (as
+// LightBlock sends it), the cluster buffers (as ClusteredLights sends them),
+// and the loop over the lights of a point p in eye space:
+//     int first, n = LightCount(vPoint, first);
+//     for (int k = 0; k < n; k++) {
+//         Light light = GetLight(first, k);
+//         ...
+inline const char *LightCode() {
+    return R"(
+	struct Light {
+		vec4 position;	// eye space; w: range, 0 if unlimited
+		vec4 color;		// rgb; a: intensity
+	};
+	layout(std140) uniform Lights {
+		int nLights;
+		Light lights[256];
+	};
+	uniform bool clustered = false;			// else all of the Lights block
+	uniform samplerBuffer clusterLights;	// two texels per light, as a Light
+	uniform usamplerBuffer clusterRanges;	// per cluster: first index, count
+	uniform usamplerBuffer clusterIndices;	// lights per cluster, after those unlimited
+	uniform int nGlobalLights;				// unlimited lights, in every cluster
+	uniform vec3 clusterDims;				// tiles across, tiles down, depth slices
+	uniform vec4 clusterTiles;				// viewport origin, pixels per tile
+	uniform vec2 clusterDepth;				// first slice's far depth, slices per log depth
+
+	int LightCount(vec3 p, out int first) {
+		first = 0;
+		if (!clustered)
+			return nLights;
+		ivec3 dims = ivec3(clusterDims);
+		ivec2 t = min(ivec2((gl_FragCoord.xy-clusterTiles.xy)/clusterTiles.zw), dims.xy-1);
+		int z = clamp(int(floor(log(-p.z/clusterDepth.x)*clusterDepth.y))+1, 0, dims.z-1);
+		uvec2 r = texelFetch(clusterRanges, (z*dims.y+t.y)*dims.x+t.x).rg;
+		first = int(r.x);
+		return nGlobalLights+int(r.y);
+	}
+
+	Light GetLight(int first, int k) {
+		if (!clustered)
+			return lights[k];
+		int i = int(texelFetch(clusterIndices, k < nGlobalLights? k : first+k-nGlobalLights).r);
+		return Light(texelFetch(clusterLights, 2*i), texelFetch(clusterLights, 2*i+1));
+	}
+)";
+}
+
+// shader with LightCode after its #version line
+inline std::string AddLightCode(const char *shader) {
+    std::string s(shader);
+    size_t v = s.find("#version"), eol = v == std::string::npos ? 0 : s.find('\n', v);
+    s.insert(eol == std::string::npos ? s.size() : eol + 1, LightCode());
+    return s;
+}
+
+// the view volume split into tilesX by tilesY screen tiles and slices depth
+// slices, spaced geometrically (the first from the near plane to zNear, the
+// last from zFar to the far plane); each frame, lights with a range are
+// tested against the cells' boxes, rows of cells over threads, four at a time,
+// and the lights of each cell uploaded as a list of indices. Lights without
+// a range are in every list
+class ClusteredLights {
+public:
+    static const int tilesX = 16, tilesY = 9, slices = 24;
+    static const int tiles = tilesX * tilesY, nClusters = tiles * slices;
+    static const int maxLights = 65536; // indices are 16-bit
+    bool enabled = false;               // else lights go to the LightBlock, as many as it holds
+    float zNear = .1f, zFar = 100;      // eye depths between which slices are spaced
+    int nThreads = 0;                   // to assign lights; 0: one per core
+
+    ClusteredLights() {}
+    ClusteredLights(const ClusteredLights &) = delete;
+    ClusteredLights &operator=(const ClusteredLights &) = delete;
+
+    // locate the program's cluster uniforms, after linking (for each
+    // program lit by these lights); the buffers are read through texture
+    // units firstUnit to firstUnit+2
+    void Attach(const Program &program, int firstUnit = 4) {
+        Handles h;
+        h.program = program.id;
+        h.clustered = program.GetUniform<int>("clustered");
+        h.nGlobalLights = program.GetUniform<int>("nGlobalLights");
+        h.dims = program.GetUniform<vec3>("clusterDims");
+        h.tiles = program.GetUniform<vec4>("clusterTiles");
+        h.depth = program.GetUniform<vec2>("clusterDepth");
+        const char *samplers[] = {"clusterLights", "clusterRanges", "clusterIndices"};
+        for (int k = 0; k < 3; k++) {
+            h.units[k] = firstUnit + k;
+            h.samplers[k] = program.GetUniform<int>(samplers[k]);
+        }
+        for (Handles &a : attached)
+            if (a.program == h.program) {
+                a = h;
+                return;
+            }
+        attached.push_back(h);
+    }
+
+    // color, intensity and range (0: unlimited) of light i, as LightBlock::Set
+    void Set(int i, vec3 color, float intensity = 1, float range = 0) {
+        if (i < 0 || i >= maxLights)
+            return;
+        if (i >= (int) props.size())
+            props.resize(i + 1);
+        props[i] = {color, intensity, range};
+        propsChanged = true;
+    }
+
+    // n more lights, after those given to Update, at random in the box
+    // (lo, hi), of random hue, with ranges such that a point is lit by
+    // about overlap of them; n = 0 removes them
+    void Scatter(int n, const vec3 &lo, const vec3 &hi, float overlap = 4, unsigned seed = 1) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0, 1);
+        vec3 size = hi - lo;
+        float volume = std::max(size.x * size.y * size.z, 1e-6f);
+        float range = cbrtf(3 * overlap * volume / (4 * 3.14159265f * std::max(n, 1)));
+        scattered.resize(n);
+        scatteredProps.resize(n);
+        for (int i = 0; i < n; i++) {
+            scattered[i] = lo + vec3(unit(random) * size.x, unit(random) * size.y, unit(random) * size.z);
+            float h = 6 * unit(random);
+            vec3 hue(fabsf(h - 3) - 1, 2 - fabsf(h - 2), 2 - fabsf(h - 4));
+            for (int k = 0; k < 3; k++)
+                hue[k] = std::min(1.f, std::max(0.f, hue[k]));
+            scatteredProps[i] = {hue, 1, range};
+        }
+        propsChanged = true;
+    }
+
+    // with an attached program in use: the n lights at world positions and
+    // those scattered, sent in eye space, if enabled to the clusters, else
+    // to forward; only if a light, the camera or the viewport changed
+    void Update(LightBlock &forward, const vec3 *positions, int n, const mat4 &modelview,
+                const mat4 &persp) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        nUpdates++;
+        n = std::min(n, maxLights - (int) scattered.size());
+        bool moved = propsChanged || dirty || n != (int) last.size() ||
+                     memcmp(&modelview, &lastModelview, sizeof(mat4)) ||
+                     (n && memcmp(positions, last.data(), n * sizeof(vec3)));
+        if (moved) {
+            dirty = false;
+            last.assign(positions, positions + n);
+            lastModelview = modelview;
+            Transform();
+        }
+        if (!enabled)
+            Forward(forward, moved);
+        else if (moved || !assigned || memcmp(&persp, &lastPersp, sizeof(mat4)) ||
+                 memcmp(viewport, lastViewport, sizeof(viewport))) {
+            lastPersp = persp;
+            memcpy(lastViewport, viewport, sizeof(viewport));
+            Grid(persp, viewport);
+            Assign();
+            Upload();
+            assigned = true;
+        }
+        Use();
+    }
+
+    // transform, assign and send the lights on the next Update as if they
+    // or the camera had moved (as to time that work every frame)
+    void Dirty() { dirty = true; }
+
+    // set the cluster uniforms and bind the buffers for the attached
+    // program in use (as Update does), so that another program can be lit
+    // by the same lights
+    void Use() const {
+        GLint id = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &id);
+        const Handles *h = NULL;
+        for (const Handles &a : attached)
+            if (a.program == (GLuint) id)
+                h = &a;
+        if (!h)
+            return;
+        // samplers on their own units even when unused, as GL requires of
+        // samplers of different types
+        for (int k = 0; k < 3; k++)
+            h->samplers[k].Set(h->units[k]);
+        h->clustered.Set(enabled ? 1 : 0);
+        if (!enabled)
+            return;
+        h->nGlobalLights.Set(nGlobal);
+        h->dims.Set(vec3((float) tilesX, (float) tilesY, (float) slices));
+        h->tiles.Set(vec4((float) lastViewport[0], (float) lastViewport[1], tileWidth, tileHeight));
+        h->depth.Set(vec2(sliceNear, (slices - 2) / logf(sliceFar / sliceNear)));
+        GLuint textures[] = {lightsTexture, rangesTexture, indicesTexture};
+        for (int k = 0; k < 3; k++)
+            Binds().BindTexture(h->units[k], textures[k], GL_TEXTURE_BUFFER);
+    }
+
+    int Lights() const { return (int) eye.size(); }
+
+    // lights listed per cluster, on average, at the last assignment
+    double LightsPerCluster() const { return (double) nListed / nClusters; }
+
+    // milliseconds to assign lights, at the last assignment
+    double AssignMs() const { return lastAssignMs; }
+
+    void Report() const {
+        if (!nAssigns)
+            return;
+        printf("clustered lights: %d lights, %.3f ms to assign, %.1f per cluster (at most %d), "
+               "%ld assignments in %ld frames\n", Lights(), totalAssignMs / nAssigns,
+               (double) totalListed / nAssigns / nClusters, maxListed, nAssigns, nUpdates);
+    }
+
+    // free buffers and textures while the GL context is current
+    void Release() {
+        GLuint buffers[] = {lightsBuffer, rangesBuffer, indicesBuffer};
+        GLuint textures[] = {lightsTexture, rangesTexture, indicesTexture};
+        if (lightsBuffer) {
+            glDeleteBuffers(3, buffers);
+            glDeleteTextures(3, textures);
+        }
+        lightsBuffer = rangesBuffer = indicesBuffer = 0;
+        lightsTexture = rangesTexture = indicesTexture = 0;
+        assigned = false;
+    }
+
+private:
+    struct Props {
+        vec3 color = vec3(1, 1, 1);
+        float intensity = 1, range = 0;
+    };
+    // uniforms of an attached program, and its texture units
+    struct Handles {
+        GLuint program = 0;
+        int units[3] = {4, 5, 6};
+        Uniform<int> clustered, nGlobalLights, samplers[3];
+        Uniform<vec3> dims;
+        Uniform<vec4> tiles;
+        Uniform<vec2> depth;
+    };
+    vector<Handles> attached;
+    vector<Props> props, scatteredProps;
+    vector<vec3> scattered, last, forwardWorld;
+    mat4 lastModelview, lastPersp;
+    GLint lastViewport[4] = {0, 0, 0, 0};
+    bool propsChanged = true, assigned = false, forwardProps = false;
+    bool dirty = false;
+    // lights in eye space (w: range, 0 if unlimited), and as sent (two vec4s each)
+    vector<vec4> eye, gpuLights;
+    // grid: depth of each slice boundary, zNear and zFar within the view
+    // volume, and each cluster's box in x and y (by slice, then tile); pixels
+    // per tile
+    float depths[slices + 1], sliceNear = .1f, sliceFar = 100;
+    vector<float> loX, hiX, loY, hiY;
+    float tileWidth = 1, tileHeight = 1;
+    // lights to test per slice; light indices per cluster
+    vector<vector<uint16_t>> sliceLights, lists;
+    vector<uint16_t> indices;
+    vector<GLuint> ranges;
+    int nGlobal = 0;
+    GLuint lightsBuffer = 0, rangesBuffer = 0, indicesBuffer = 0;
+    GLuint lightsTexture = 0, rangesTexture = 0, indicesTexture = 0;
+    long nUpdates = 0, nAssigns = 0, nListed = 0, totalListed = 0;
+    int maxListed = 0;
+    double lastAssignMs = 0, totalAssignMs = 0;
+
+    const Props &PropsOf(int i) const {
+        static const Props white;
+        int n = (int) last.size();
+        if (i >= n)
+            return scatteredProps[i - n];
+        return i < (int) props.size() ? props[i] : white;
+    }
+
+    void Transform() {
+        int n = (int) last.size(), total = n + (int) scattered.size();
+        eye.resize(total);
+        gpuLights.resize(2 * total);
+        for (int i = 0; i < total; i++) {
+            const Props &p = PropsOf(i);
+            vec4 x = lastModelview * vec4(i < n ? last[i] : scattered[i - n], 1);
+            eye[i] = vec4(x.x, x.y, x.z, p.range);
+            gpuLights[2 * i] = eye[i];
+            gpuLights[2 * i + 1] = vec4(p.color, p.intensity);
+        }
+        propsChanged = false;
+        forwardProps = true;
+    }
+
+    // as many lights as the block holds
+    void Forward(LightBlock &forward, bool moved) {
+        int n = std::min(Lights(), LightBlock::maxLights);
+        if (forwardProps)
+            for (int i = 0; i < n; i++) {
+                const Props &p = PropsOf(i);
+                forward.Set(i, p.color, p.intensity, p.range);
+            }
+        forwardProps = false;
+        if (moved || forwardWorld.size() != (size_t) n) {
+            forwardWorld.resize(n);
+            for (int i = 0; i < n; i++)
+                forwardWorld[i] = i < (int) last.size() ? last[i] : scattered[i - last.size()];
+        }
+        forward.Update(forwardWorld.data(), n, lastModelview);
+    }
+
+    // slice depths and cluster boxes for persp (a perspective projection) and
+    // the viewport
+    void Grid(const mat4 &persp, const GLint viewport[4]) {
+        // near and far planes, from persp[2][2] = (n+f)/(n-f), persp[2][3] = 2nf/(n-f)
+        float a = persp[2][2], b = persp[2][3];
+        float zn = fabsf(a - 1) > 1e-9f ? b / (a - 1) : .001f;
+        float zf = fabsf(a + 1) > 1e-9f ? b / (a + 1) : 1e4f;
+        if (!(zn > 0) || !(zf > zn))
+            zn = .001f, zf = 1e4f;
+        sliceNear = std::max(zNear, zn * 1.0001f);
+        sliceFar = std::max(std::min(zFar, zf), sliceNear * 2);
+        depths[0] = zn;
+        depths[slices] = std::max(zf, sliceFar);
+        for (int s = 1; s < slices; s++)
+            depths[s] = sliceNear * powf(sliceFar / sliceNear, (float) (s - 1) / (slices - 2));
+        int w = std::max(1, (int) viewport[2]), h = std::max(1, (int) viewport[3]);
+        tileWidth = (float) ((w + tilesX - 1) / tilesX);
+        tileHeight = (float) ((h + tilesY - 1) / tilesY);
+        loX.resize(nClusters), hiX.resize(nClusters), loY.resize(nClusters), hiY.resize(nClusters);
+        for (int s = 0; s < slices; s++)
+            for (int ty = 0; ty < tilesY; ty++)
+                for (int tx = 0; tx < tilesX; tx++) {
+                    // the tile in normalized device coordinates, then the box
+                    // about its corners at either depth: x = d(ndc+m02)/m00
+                    float x0 = 2 * tx * tileWidth / w - 1, x1 = 2 * (tx + 1) * tileWidth / w - 1;
+                    float y0 = 2 * ty * tileHeight / h - 1, y1 = 2 * (ty + 1) * tileHeight / h - 1;
+                    int c = s * tiles + ty * tilesX + tx;
+                    loX[c] = loY[c] = 1e30f;
+                    hiX[c] = hiY[c] = -1e30f;
+                    for (int k = 0; k < 2; k++) {
+                        float d = depths[s + k];
+                        float xs[] = {d * (x0 + persp[0][2]) / persp[0][0], d * (x1 + persp[0][2]) / persp[0][0]};
+                        float ys[] = {d * (y0 + persp[1][2]) / persp[1][1], d * (y1 + persp[1][2]) / persp[1][1]};
+                        for (int j = 0; j < 2; j++) {
+                            loX[c] = std::min(loX[c], xs[j]), hiX[c] = std::max(hiX[c], xs[j]);
+                            loY[c] = std::min(loY[c], ys[j]), hiY[c] = std::max(hiY[c], ys[j]);
+                        }
+                    }
+                }
+    }
+
+    // slice at eye depth d
+    int Slice(float d) const {
+        if (d < depths[1])
+            return 0;
+        int s = 1 + (int) (logf(d / sliceNear) * (slices - 2) / logf(sliceFar / sliceNear));
+        return std::min(slices - 1, s);
+    }
+
+    void Assign() {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        // unlimited lights first; the others listed for the slices their
+        // spheres reach
+        sliceLights.resize(slices);
+        lists.resize(nClusters);
+        for (vector<uint16_t> &l : sliceLights)
+            l.clear();
+        indices.clear();
+        for (int i = 0; i < (int) eye.size(); i++) {
+            const vec4 &l = eye[i];
+            if (l.w <= 0) {
+                indices.push_back((uint16_t) i);
+                continue;
+            }
+            float dNear = -l.z - l.w, dFar = -l.z + l.w;
+            if (dFar < depths[0] || dNear > depths[slices])
+                continue;
+            for (int s = Slice(dNear), end = Slice(dFar); s <= end; s++)
+                sliceLights[s].push_back((uint16_t) i);
+        }
+        nGlobal = (int) indices.size();
+        // each row of a slice's clusters (rows share their y bounds) tested
+        // against the slice's lights, four clusters at a time
+        ParallelFor(slices * tilesY, [this](int, int begin, int end) {
+            for (int row = begin; row < end; row++) {
+                int s = row / tilesY, first = s * tiles + row % tilesY * tilesX;
+                vector<uint16_t> *cells = &lists[first];
+                for (int t = 0; t < tilesX; t++)
+                    cells[t].clear();
+                float zlo = -depths[s + 1], zhi = -depths[s], ylo = loY[first], yhi = hiY[first];
+                for (uint16_t i : sliceLights[s]) {
+                    const vec4 &l = eye[i];
+                    float dz = l.z < zlo ? zlo - l.z : l.z > zhi ? l.z - zhi : 0;
+                    float dy = l.y < ylo ? ylo - l.y : l.y > yhi ? l.y - yhi : 0;
+                    float left = l.w * l.w - dz * dz - dy * dy;
+                    if (left < 0)
+                        continue;
+                    f4 x(l.x), r2(left);
+                    for (int t = 0; t < tilesX; t += 4) {
+                        int c = first + t;
+                        f4 ex = x - Min(Max(x, f4::Load(&loX[c])), f4::Load(&hiX[c]));
+                        int inside = LessMask(ex * ex, r2);
+                        for (int k = 0; inside; k++, inside >>= 1)
+                            if (inside & 1)
+                                cells[t + k].push_back(i);
+                    }
+                }
+            }
+        }, nThreads);
+        // one list, each cluster's lights at first .. first+count
+        ranges.resize(2 * nClusters);
+        nListed = 0;
+        for (int c = 0; c < nClusters; c++) {
+            ranges[2 * c] = (GLuint) indices.size();
+            ranges[2 * c + 1] = (GLuint) lists[c].size();
+            indices.insert(indices.end(), lists[c].begin(), lists[c].end());
+            nListed += (long) lists[c].size();
+            maxListed = std::max(maxListed, (int) lists[c].size());
+        }
+        lastAssignMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        totalAssignMs += lastAssignMs;
+        totalListed += nListed;
+        nAssigns++;
+    }
+
+    // buffer and the texture that reads it as format
+    static void MakeBuffer(GLuint &buffer, GLuint &texture, GLenum format) {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    }
+
+    void Upload() {
+        if (!lightsBuffer) {
+            MakeBuffer(lightsBuffer, lightsTexture, GL_RGBA32F);
+            MakeBuffer(rangesBuffer, rangesTexture, GL_RG32UI);
+            MakeBuffer(indicesBuffer, indicesTexture, GL_R16UI);
+        }
+        // orphaned each time, so as not to wait on frames still reading them
+        auto Send = [](GLuint buffer, size_t size, const void *data) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t) 16), NULL, GL_STREAM_DRAW);
+            if (size)
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        };
+        Send(lightsBuffer, gpuLights.size() * sizeof(vec4), gpuLights.data());
+        Send(rangesBuffer, ranges.size() * sizeof(GLuint), ranges.data());
+        Send(indicesBuffer, indices.size() * sizeof(uint16_t), indices.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+// -lights n among command-line arguments: n, else 0
+inline int LightsArg(int ac, char **av) { return IntArg(ac, av, "-lights", 0); }
+
+#endif
@@ -0,0 +1,261 @@
+// Author: Nadezhda Chernova
+// File: Frustum.h
+// Date: 10/16/2026
+// View frustum planes; bounding spheres and boxes culled against them one at
+// a time, four at a time, or through a bounding volume hierarchy
+
+#ifndef FRUSTUM_HDR
+#define FRUSTUM_HDR
+
+#include "VecMat.h" // vec3, vec4, mat4
+#include "Simd.h"   // f4, LessMask
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+enum class Overlap { Outside, Intersects, Inside };
+
+// the six planes of the view volume, in the space m maps to clip space: for
+// persp * modelview, world space; for persp * modelview * toWorld, model
+// space, so model-space bounds need no transforming. Planes are normalized,
+// with the inside where a*x + b*y + c*z + d >= 0
+class Frustum {
+public:
+    vec4 planes[6];
+
+    Frustum() {}
+    Frustum(const mat4 &m) { Extract(m); }
+
+    void Extract(const mat4 &m) {
+        // left, right, bottom, top, near, far: row 3 plus or minus rows 0, 1, 2
+        for (int k = 0; k < 3; k++)
+            for (int s = 0; s < 2; s++) {
+                float sign = s ? -1.f : 1.f, p[4];
+                for (int j = 0; j < 4; j++)
+                    p[j] = m[3][j] + sign * m[k][j];
+                float l = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                l = l > 0 ? 1 / l : 0;
+                planes[2 * k + s] = vec4(l * p[0], l * p[1], l * p[2], l * p[3]);
+            }
+    }
+
+    // false if the sphere is wholly outside
+    bool Sphere(const vec3 &c, float r) const {
+        for (const vec4 &p : planes)
+            if (p.x * c.x + p.y * c.y + p.z * c.z + p.w < -r)
+                return false;
+        return true;
+    }
+
+    Overlap Box(const vec3 &lo, const vec3 &hi) const {
+        Overlap o = Overlap::Inside;
+        for (const vec4 &p : planes) {
+            // corners farthest along and against the plane normal
+            vec3 along(p.x >= 0 ? hi.x : lo.x, p.y >= 0 ? hi.y : lo.y, p.z >= 0 ? hi.z : lo.z);
+            vec3 against(p.x >= 0 ? lo.x : hi.x, p.y >= 0 ? lo.y : hi.y, p.z >= 0 ? lo.z : hi.z);
+            if (p.x * along.x + p.y * along.y + p.z * along.z + p.w < 0)
+                return Overlap::Outside;
+            if (p.x * against.x + p.y * against.y + p.z * against.z + p.w < 0)
+                o = Overlap::Intersects;
+        }
+        return o;
+    }
+
+    // false if the box or sphere (both bound the same thing) is wholly outside
+    bool Visible(const vec3 &lo, const vec3 &hi, const vec3 &c, float r) const {
+        return Sphere(c, r) && Box(lo, hi) != Overlap::Outside;
+    }
+};
+
+// sphere (center, radius) under m, enlarged by m's largest axis scale
+inline void TransformSphere(const mat4 &m, const vec3 &center, float radius, vec3 &c, float &r) {
+    vec4 x = m * vec4(center, 1);
+    c = vec3(x.x, x.y, x.z);
+    float scale = 0;
+    for (int j = 0; j < 3; j++)
+        scale = std::max(scale, length(vec3(m[0][j], m[1][j], m[2][j])));
+    r = radius * scale;
+}
+
+// bounding spheres, as a structure of arrays for four-wide tests
+class SphereSoA {
+public:
+    vector<float> x, y, z, r;
+
+    int Size() const { return (int) x.size(); }
+
+    void Clear() {
+        x.clear(); y.clear(); z.clear(); r.clear();
+    }
+
+    void Add(const vec3 &c, float radius) {
+        x.push_back(c.x);
+        y.push_back(c.y);
+        z.push_back(c.z);
+        r.push_back(radius);
+    }
+};
+
+// append to visible ids[i] (or i, if ids is NULL) for the spheres in
+// [first, end) that are at least partly inside f, four at a time
+inline void CullSpheres(const Frustum &f, const SphereSoA &s, int first, int end,
+                        const int *ids, vector<int> &visible) {
+    f4 a[6], b[6], c[6], d[6];
+    for (int k = 0; k < 6; k++) {
+        a[k] = f4(f.planes[k].x);
+        b[k] = f4(f.planes[k].y);
+        c[k] = f4(f.planes[k].z);
+        d[k] = f4(f.planes[k].w);
+    }
+    int i = first;
+    for (; i + 4 <= end; i += 4) {
+        f4 x = f4::Load(&s.x[i]), y = f4::Load(&s.y[i]), z = f4::Load(&s.z[i]);
+        f4 nr = f4(0) - f4::Load(&s.r[i]);
+        int outside = 0;
+        for (int k = 0; k < 6; k++)
+            outside |= LessMask(a[k] * x + b[k] * y + c[k] * z + d[k], nr);
+        if (outside == 0xf) // common for scenes mostly off screen
+            continue;
+        for (int l = 0; l < 4; l++)
+            if (!(outside & (1 << l)))
+                visible.push_back(ids ? ids[i + l] : i + l);
+    }
+    for (; i < end; i++)
+        if (f.Sphere(vec3(s.x[i], s.y[i], s.z[i]), s.r[i]))
+            visible.push_back(ids ? ids[i] : i);
+}
+
+// bounding volume hierarchy over spheres: nodes wholly outside the frustum
+// are skipped, those wholly inside taken without testing their spheres
+class SphereBvh {
+public:
+    struct Node {
+        vec3 lo, hi;
+        int first = 0, count = 0; // spheres, if a leaf (count > 0)
+        int left = 0;             // else children left and left+1
+    };
+    vector<Node> nodes;
+    SphereSoA spheres;            // ordered so each leaf's are contiguous
+    vector<int> ids;              // given index of each of spheres
+
+    int Size() const { return spheres.Size(); }
+
+    void Build(const vec3 *centers, const float *radii, int n, int leafSize = 16) {
+        nodes.clear();
+        spheres.Clear();
+        ids.resize(n);
+        for (int i = 0; i < n; i++)
+            ids[i] = i;
+        if (!n)
+            return;
+        nodes.reserve(2 * (n / leafSize + 1));
+        nodes.push_back(Node());
+        Split(0, 0, n, centers, radii, leafSize);
+        for (int i : ids)
+            spheres.Add(centers[i], radii[i]);
+    }
+
+    // ids of spheres at least partly inside f
+    void Cull(const Frustum &f, vector<int> &visible) const {
+        visible.clear();
+        if (!nodes.empty())
+            Cull(f, 0, visible);
+    }
+
+private:
+    void Split(int node, int first, int end, const vec3 *centers, const float *radii, int leafSize) {
+        // bounds of the spheres, and of their centers
+        vec3 lo = centers[ids[first]], hi = lo, clo = lo, chi = lo;
+        for (int i = first; i < end; i++) {
+            const vec3 &c = centers[ids[i]];
+            float r = radii[ids[i]];
+            for (int k = 0; k < 3; k++) {
+                lo[k] = std::min(lo[k], c[k] - r);
+                hi[k] = std::max(hi[k], c[k] + r);
+                clo[k] = std::min(clo[k], c[k]);
+                chi[k] = std::max(chi[k], c[k]);
+            }
+        }
+        nodes[node].lo = lo;
+        nodes[node].hi = hi;
+        if (end - first <= leafSize) {
+            nodes[node].first = first;
+            nodes[node].count = end - first;
+            return;
+        }
+        // median along the widest spread of centers
+        vec3 spread = chi - clo;
+        int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+        int mid = (first + end) / 2;
+        std::nth_element(ids.begin() + first, ids.begin() + mid, ids.begin() + end,
+                         [&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+        int left = (int) nodes.size();
+        nodes[node].left = left;
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        Split(left, first, mid, centers, radii, leafSize);
+        Split(left + 1, mid, end, centers, radii, leafSize);
+    }
+
+    void Cull(const Frustum &f, int node, vector<int> &visible) const {
+        const Node &n = nodes[node];
+        Overlap o = f.Box(n.lo, n.hi);
+        if (o == Overlap::Outside)
+            return;
+        if (o == Overlap::Inside) {
+            Take(node, visible);
+            return;
+        }
+        if (n.count)
+            CullSpheres(f, spheres, n.first, n.first + n.count, ids.data(), visible);
+        else {
+            Cull(f, n.left, visible);
+            Cull(f, n.left + 1, visible);
+        }
+    }
+
+    // all spheres under node
+    void Take(int node, vector<int> &visible) const {
+        const Node &n = nodes[node];
+        if (n.count)
+            visible.insert(visible.end(), ids.begin() + n.first, ids.begin() + n.first + n.count);
+        else {
+            Take(n.left, visible);
+            Take(n.left + 1, visible);
+        }
+    }
+};
+
+// meshes (or instances) left to draw and culled, per frame
+class CullStats {
+public:
+    int visible = 0, culled = 0;         // this frame
+    int lastVisible = 0, lastCulled = 0; // the frame before
+    long totalVisible = 0, totalCulled = 0, nFrames = 0;
+
+    void Count(int nVisible, int nTested) {
+        visible += nVisible;
+        culled += nTested - nVisible;
+    }
+
+    // call once per frame, after drawing; true if the counts changed
+    bool EndFrame() {
+        bool changed = visible != lastVisible || culled != lastCulled;
+        lastVisible = visible;
+        lastCulled = culled;
+        totalVisible += visible;
+        totalCulled += culled;
+        visible = culled = 0;
+        nFrames++;
+        return changed;
+    }
+
+    void Report(const char *name = "culling") const {
+        double n = nFrames ? (double) nFrames : 1, tested = (double) (totalVisible + totalCulled);
+        printf("%s: %.1f visible, %.1f culled per frame (%.0f%% culled)\n", name, totalVisible / n,
+               totalCulled / n, tested > 0 ? 100 * totalCulled / tested : 0.);
+    }
+};
+
+#endif
@@ -0,0 +1,160 @@
+// Author: Nadezhda Chernova
+// File: GBuffer.h
+// Date: 10/16/2026
+// Geometry buffer for deferred shading: albedo, packed normal and depth,
+// written by one geometry pass and read by a lighting pass
+
+#ifndef GBUFFER_HDR
+#define GBUFFER_HDR
+
+#include "glad.h"
+#include "GLState.h" // Binds
+#include "VertexLayout.h" // OctCode
+#include <stdio.h>
+#include <string>
+
+// GLSL for the lighting pass: the G-buffer's textures, and the eye-space
+// point, normal and albedo at a pixel (false if nothing was drawn there),
+// with OctDecode from OctCode; the geometry pass writes
+//     layout(location = 0) out vec4 pColor;   // albedo
+//     layout(location = 1) out vec2 gNormal;  // OctEncode(N), N in eye space
+inline const char *GBufferCode() {
+    return R"(
+	uniform sampler2D gAlbedo, gNormal, gDepth;
+	uniform mat4 persp;						// as drawn by the geometry pass
+	uniform vec4 viewport;					// as glViewport
+	// position from depth: undo the perspective's z, then x and y
+	bool GetPixel(out vec3 p, out vec3 n, out vec3 albedo) {
+		ivec2 t = ivec2(gl_FragCoord.xy-viewport.xy);
+		float d = texelFetch(gDepth, t, 0).r;
+		if (d == 1)
+			return false;
+		vec2 ndc = 2*(gl_FragCoord.xy-viewport.xy)/viewport.zw-1;
+		p.z = -persp[3][2]/(2*d-1+persp[2][2]);
+		p.x = -p.z*(ndc.x+persp[2][0])/persp[0][0];
+		p.y = -p.z*(ndc.y+persp[2][1])/persp[1][1];
+		n = OctDecode(texelFetch(gNormal, t, 0).rg);
+		albedo = texelFetch(gAlbedo, t, 0).rgb;
+		return true;
+	}
+)";
+}
+
+// shader with OctCode and GBufferCode after its #version line
+inline std::string AddGBufferCode(const char *shader) {
+    std::string s(shader);
+    size_t v = s.find("#version"), eol = v == std::string::npos ? 0 : s.find('\n', v);
+    s.insert(eol == std::string::npos ? s.size() : eol + 1, std::string(OctCode()) + GBufferCode());
+    return s;
+}
+
+// a framebuffer the size of the viewport with RGBA8 albedo, RG16F
+// octahedral normals and 24-bit depth (11 bytes per pixel; the position is
+// rebuilt from depth rather than stored):
+//     gbuffer.Begin();          // bound, cleared
+//     ...draw, writing pColor and gNormal
+//     gbuffer.End();            // back to the window
+//     gbuffer.BindTextures(12); // albedo, normal, depth on units 12-14
+class GBuffer {
+public:
+    int width = 0, height = 0;
+    GLuint framebuffer = 0, albedo = 0, normal = 0, depth = 0;
+
+    GBuffer() {}
+    GBuffer(const GBuffer &) = delete;
+    GBuffer &operator=(const GBuffer &) = delete;
+
+    // bind for drawing, remade if the viewport changed size, and clear;
+    // false if the framebuffer is incomplete
+    bool Begin() {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if (viewport[2] != width || viewport[3] != height || !framebuffer)
+            if (!Make(viewport[2], viewport[3]))
+                return false;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        // the viewport's origin is the buffer's
+        glViewport(0, 0, width, height);
+        origin[0] = viewport[0], origin[1] = viewport[1];
+        GLenum buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, buffers);
+        // cleared to nothing, the app's clear color kept
+        GLfloat clearColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+        return true;
+    }
+
+    // draw to the window again, in its viewport
+    void End() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(origin[0], origin[1], width, height);
+    }
+
+    // albedo, normal and depth textures on units firstUnit to firstUnit+2
+    void BindTextures(int firstUnit) const {
+        GLuint textures[] = {albedo, normal, depth};
+        for (int k = 0; k < 3; k++)
+            Binds().BindTexture(firstUnit + k, textures[k]);
+    }
+
+    size_t Bytes() const { return (size_t) width * height * (4 + 4 + 3); }
+
+    void Report() const {
+        printf("g-buffer: %dx%d, %.1f MB\n", width, height, Bytes() / (1024. * 1024.));
+    }
+
+    void Release() {
+        if (framebuffer)
+            glDeleteFramebuffers(1, &framebuffer);
+        GLuint textures[] = {albedo, normal, depth};
+        glDeleteTextures(3, textures);
+        framebuffer = albedo = normal = depth = 0;
+        width = height = 0;
+    }
+
+private:
+    int origin[2] = {0, 0};
+
+    // glTexImage2D, not glTexStorage2D (GL 4.2, not on macOS); format and
+    // type match internalFormat, though no pixels are sent
+    static GLuint Texture(GLenum internalFormat, GLenum format, GLenum type, int w, int h) {
+        GLuint t = 0;
+        glGenTextures(1, &t);
+        glBindTexture(GL_TEXTURE_2D, t);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, type, NULL);
+        // read with texelFetch, one texel per pixel
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return t;
+    }
+
+    bool Make(int w, int h) {
+        Release();
+        if (w <= 0 || h <= 0)
+            return false;
+        width = w, height = h;
+        albedo = Texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, w, h);
+        normal = Texture(GL_RG16F, GL_RG, GL_HALF_FLOAT, w, h);
+        depth = Texture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, w, h);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            printf("g-buffer incomplete (0x%x)\n", status);
+            Release();
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
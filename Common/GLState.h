@@ -0,0 +1,108 @@
+// Author: Nadezhda Chernova
+// File: GLState.h
+// Date: 10/16/2026
+// Program, vertex array and texture binds, counted per frame along with
+// those that rebind what is already bound; extension queries
+
+#ifndef GL_STATE_HDR
+#define GL_STATE_HDR
+
+#include "glad.h"
+#include <stdio.h>
+#include <string.h>
+
+// true if the current context lists extension name
+inline bool HasExtension(const char *name) {
+    GLint n = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+    for (int i = 0; i < n; i++) {
+        const char *e = (const char *) glGetStringi(GL_EXTENSIONS, i);
+        if (e && !strcmp(e, name))
+            return true;
+    }
+    return false;
+}
+
+// binds go to GL as asked (never skipped), counted as changes or as
+// redundant; binds made elsewhere (as by UseDrawShader) aren't seen, so
+// what is bound is forgotten at the end of each frame
+class BindCounter {
+public:
+    struct Counts {
+        long programs = 0, vertexArrays = 0, textures = 0; // state changes
+        long redundant = 0;                                // binds of what was bound
+    };
+    Counts frame, total;
+    long nFrames = 0;
+
+    BindCounter() { Forget(); }
+
+    void UseProgram(GLuint program) {
+        Count(program == boundProgram, frame.programs);
+        boundProgram = program;
+        glUseProgram(program);
+    }
+
+    void BindVertexArray(GLuint vao) {
+        Count(vao == boundVertexArray, frame.vertexArrays);
+        boundVertexArray = vao;
+        glBindVertexArray(vao);
+    }
+
+    // texture name on texture unit (as a 2D texture, unless target says)
+    void BindTexture(int unit, GLuint name, GLenum target = GL_TEXTURE_2D) {
+        if (unit != activeUnit)
+            glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        bool same = unit < maxUnits && boundTextures[unit] == name;
+        Count(same, frame.textures);
+        if (unit < maxUnits)
+            boundTextures[unit] = name;
+        glBindTexture(target, name);
+    }
+
+    // call once per frame, after drawing
+    void EndFrame() {
+        total.programs += frame.programs;
+        total.vertexArrays += frame.vertexArrays;
+        total.textures += frame.textures;
+        total.redundant += frame.redundant;
+        frame = Counts();
+        nFrames++;
+        Forget();
+    }
+
+    // average binds per frame
+    void Report() const {
+        double n = nFrames ? (double) nFrames : 1;
+        printf("binds per frame: %.1f program, %.1f vertex array, %.1f texture; %.1f redundant\n",
+               total.programs / n, total.vertexArrays / n, total.textures / n, total.redundant / n);
+    }
+
+private:
+    static const int maxUnits = 32;
+    GLuint boundProgram, boundVertexArray, boundTextures[maxUnits];
+    int activeUnit;
+
+    void Count(bool same, long &changes) {
+        if (same)
+            frame.redundant++;
+        else
+            changes++;
+    }
+
+    void Forget() {
+        boundProgram = boundVertexArray = ~0u;
+        for (GLuint &t : boundTextures)
+            t = ~0u;
+        activeUnit = -1;
+    }
+};
+
+// the counter for the GL context
+inline BindCounter &Binds() {
+    static BindCounter binds;
+    return binds;
+}
+
+#endif
@@ -0,0 +1,320 @@
+// Author: Nadezhda Chernova
+// File: GeometryArena.h
+// Date: 10/16/2026
+// Meshes sub-allocated in shared vertex and element buffers, drawn each
+// frame with a multi-draw per material from a command buffer built on the CPU
+
+#ifndef GEOMETRY_ARENA_HDR
+#define GEOMETRY_ARENA_HDR
+
+#include "glad.h"
+#include "VecMat.h"    // vec2, vec3, vec4, mat4, int3
+#include "MeshCache.h" // CachedMesh
+#include "MeshLod.h"   // LodChain
+#include "GLState.h"   // Binds
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// as glMultiDrawElementsIndirect reads them
+struct DrawCommand {
+    GLuint count;         // indices
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;  // the draw's index, read back as its draw ID
+};
+
+// glMultiDrawElementsIndirect and baseInstance (GL 4.3), not on macOS
+inline bool HaveMultiDrawIndirect() {
+#ifdef GL_VERSION_4_3
+    static bool have = glMultiDrawElementsIndirect != NULL;
+    return have;
+#else
+    return false;
+#endif
+}
+
+// a mesh's place in the arena: its vertices start at baseVertex, each level
+// of detail is a run of indices; lods keeps sizes, errors and bounds (its
+// triangles are in the arena)
+class ArenaMesh {
+public:
+    int baseVertex = 0, nPoints = 0;
+    vector<int> firstIndex; // per level
+    LodChain lods;
+
+    bool Valid() const { return !firstIndex.empty(); }
+};
+
+// vertices are interleaved floats, for every mesh alike:
+//     layout(location = 0) in vec3 point;
+//     layout(location = 1) in vec3 normal;
+//     layout(location = 2) in vec2 uv;
+//     layout(location = 9) in int drawId;          // per draw
+//     uniform samplerBuffer draws;                 // per draw data
+//     mat4 modelview = mat4(texelFetch(draws, 5*drawId), ... 5*drawId+3);
+//     int material = int(texelFetch(draws, 5*drawId+4).x);
+// samplers can't be indexed by material (not dynamically uniform within a
+// multi-draw), so Submit groups commands by material, one multi-draw each
+// buffers grow (by copying) as meshes are added
+class GeometryArena {
+public:
+    static const GLuint drawIdLocation = 9;
+
+    // copy mesh vertices and its levels of detail (triangles one level after
+    // another in lods, which moves to m) into the arena; on the GL thread
+    bool Add(const CachedMesh &mesh, LodChain &lods, ArenaMesh &m) {
+        if (!mesh.nPoints || !lods.Levels())
+            return false;
+        int nIndices = 3 * (int) lods.triangles.size();
+        Reserve(nVertices + mesh.nPoints, nIndices + this->nIndices);
+        // vertices
+        vector<Vertex> v(mesh.nPoints);
+        for (int i = 0; i < mesh.nPoints; i++) {
+            v[i].point = mesh.points[i];
+            v[i].normal = mesh.normals ? mesh.normals[i] : vec3(0, 0, 0);
+            v[i].uv = mesh.uvs ? mesh.uvs[i] : vec2(0, 0);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, nVertices * sizeof(Vertex), v.size() * sizeof(Vertex), v.data());
+        // indices, relative to the mesh's first vertex
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, this->nIndices * sizeof(GLuint), nIndices * sizeof(GLuint),
+                        lods.triangles.data());
+        m.baseVertex = nVertices;
+        m.nPoints = mesh.nPoints;
+        m.firstIndex.clear();
+        for (int level = 0, first = this->nIndices; level < lods.Levels(); level++) {
+            m.firstIndex.push_back(first);
+            first += 3 * lods.counts[level];
+        }
+        m.lods = std::move(lods);
+        m.lods.triangles = vector<int3>(); // in the arena now
+        nVertices += mesh.nPoints;
+        this->nIndices += nIndices;
+        nMeshes++;
+        return true;
+    }
+
+    // start a frame's command buffer
+    void Begin() {
+        commands.clear();
+        materials.clear();
+        drawData.clear();
+    }
+
+    // queue a level of detail of m, with its modelview and a material index
+    // for the shaders
+    void Draw(const ArenaMesh &m, int level, const mat4 &modelview, int material = 0) {
+        if (!m.Valid())
+            return;
+        level = std::max(0, std::min(level, m.lods.Levels() - 1));
+        DrawCommand c;
+        c.count = 3 * m.lods.counts[level];
+        c.instanceCount = 1;
+        c.firstIndex = m.firstIndex[level];
+        c.baseVertex = m.baseVertex;
+        c.baseInstance = (GLuint) commands.size();
+        commands.push_back(c);
+        materials.push_back(material);
+        for (int col = 0; col < 4; col++)
+            drawData.push_back(vec4(modelview[0][col], modelview[1][col], modelview[2][col], modelview[3][col]));
+        drawData.push_back(vec4((float) material, 0, 0, 0));
+    }
+
+    // send the commands and per-draw data, draw them all; the draw data is
+    // bound as a buffer texture to drawsUnit. Commands are grouped by
+    // material, and useMaterial (if given) is called before each group's
+    // draws to bind its textures
+    void Submit(int drawsUnit, const std::function<void(int material)> &useMaterial = nullptr) {
+        int n = (int) commands.size();
+        nFrames++;
+        if (!n || !VAO)
+            return;
+        // by material, keeping each command's baseInstance (its draw ID)
+        vector<int> order(n);
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return materials[a] < materials[b]; });
+        sorted.resize(n);
+        for (int i = 0; i < n; i++)
+            sorted[i] = commands[order[i]];
+        // runs of one material: [first, end)
+        auto Groups = [&](const std::function<void(int first, int end)> &draw) {
+            for (int first = 0, end = 0; first < n; first = end) {
+                int material = materials[order[first]];
+                for (end = first + 1; end < n && materials[order[end]] == material; end++)
+                    ;
+                if (useMaterial)
+                    useMaterial(material);
+                draw(first, end);
+            }
+        };
+        Upload(GL_TEXTURE_BUFFER, drawBuffer, drawCapacity, drawData.data(), drawData.size() * sizeof(vec4));
+        if (!drawTexture)
+            glGenTextures(1, &drawTexture);
+        Binds().BindTexture(drawsUnit, drawTexture, GL_TEXTURE_BUFFER);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawBuffer);
+        Binds().BindVertexArray(VAO);
+#ifdef GL_VERSION_4_3
+        if (HaveMultiDrawIndirect()) {
+            Upload(GL_DRAW_INDIRECT_BUFFER, commandBuffer, commandCapacity, sorted.data(),
+                   n * sizeof(DrawCommand));
+            EnsureDrawIds(n);
+            Groups([&](int first, int end) {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                            (void *) (first * sizeof(DrawCommand)), end - first, 0);
+                nCalls++;
+            });
+            nDraws += n;
+            return;
+        }
+#endif
+        // a draw per command, the draw ID a constant attribute
+        Groups([&](int first, int end) {
+            for (int i = first; i < end; i++) {
+                const DrawCommand &c = sorted[i];
+                glVertexAttribI1i(drawIdLocation, (GLint) c.baseInstance);
+                glDrawElementsBaseVertex(GL_TRIANGLES, c.count, GL_UNSIGNED_INT,
+                                         (void *) (c.firstIndex * sizeof(GLuint)), c.baseVertex);
+            }
+        });
+        nCalls += n;
+        nDraws += n;
+    }
+
+    // free buffers while the GL context is current
+    void Release() {
+        GLuint buffers[] = {VBO, EBO, drawIds, commandBuffer, drawBuffer};
+        for (GLuint b : buffers)
+            if (b)
+                glDeleteBuffers(1, &b);
+        if (drawTexture)
+            glDeleteTextures(1, &drawTexture);
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = drawIds = commandBuffer = drawBuffer = drawTexture = 0;
+        vertexCapacity = indexCapacity = nDrawIds = commandCapacity = drawCapacity = 0;
+        nVertices = nIndices = nMeshes = 0;
+    }
+
+    // sizes, and draws and draw calls per frame
+    void Report() const {
+        double n = nFrames ? (double) nFrames : 1, mb = 1024. * 1024.;
+        printf("arena: %d meshes, %d vertices (%.1f of %.1f MB), %d indices (%.1f of %.1f MB)\n",
+               nMeshes, nVertices, nVertices * sizeof(Vertex) / mb, vertexCapacity * sizeof(Vertex) / mb,
+               nIndices, nIndices * sizeof(GLuint) / mb, indexCapacity * sizeof(GLuint) / mb);
+        printf("arena: %.1f draws in %.1f calls per frame (%s)\n", nDraws / n, nCalls / n,
+               HaveMultiDrawIndirect() ? "multi-draw indirect" : "a draw per mesh");
+    }
+
+    GeometryArena() {}
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+private:
+    struct Vertex {
+        vec3 point, normal;
+        vec2 uv;
+    };
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint drawIds = 0;                     // 0, 1, 2 ..., a per-instance attribute
+    GLuint commandBuffer = 0, drawBuffer = 0, drawTexture = 0;
+    int vertexCapacity = 0, indexCapacity = 0, nDrawIds = 0;
+    size_t commandCapacity = 0, drawCapacity = 0;
+    int nVertices = 0, nIndices = 0, nMeshes = 0;
+    vector<DrawCommand> commands, sorted;   // as queued, and grouped by material
+    vector<int> materials;                  // per command
+    vector<vec4> drawData;                  // per draw: modelview columns, material
+    long nFrames = 0, nDraws = 0, nCalls = 0;
+
+    // grow the vertex and element buffers to hold at least the given
+    // numbers, doubling, copying what they hold
+    void Reserve(int vertices, int indices) {
+        if (!VAO)
+            glGenVertexArrays(1, &VAO);
+        bool grew = false;
+        if (vertices > vertexCapacity) {
+            int capacity = std::max(vertices, std::max(2 * vertexCapacity, 1 << 16));
+            Grow(VBO, nVertices * sizeof(Vertex), capacity * sizeof(Vertex));
+            vertexCapacity = capacity;
+            grew = true;
+        }
+        if (indices > indexCapacity) {
+            int capacity = std::max(indices, std::max(2 * indexCapacity, 1 << 18));
+            Grow(EBO, nIndices * sizeof(GLuint), capacity * sizeof(GLuint));
+            indexCapacity = capacity;
+            grew = true;
+        }
+        if (grew)
+            Capture();
+    }
+
+    // replace buffer with a larger one holding its first used bytes
+    static void Grow(GLuint &buffer, size_t used, size_t size) {
+        GLuint larger = 0;
+        glGenBuffers(1, &larger);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+        if (buffer && used) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        }
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+        buffer = larger;
+    }
+
+    // record the vertex and element buffers in the VAO
+    void Capture() {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLsizei stride = sizeof(Vertex);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *) offsetof(Vertex, point));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *) offsetof(Vertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *) offsetof(Vertex, uv));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        nDrawIds = 0; // drawIds re-pointed on the next Submit
+        glBindVertexArray(0);
+    }
+
+    // with multi-draw, the draw ID is baseInstance, read through an
+    // attribute that advances once per instance from a buffer of 0, 1, 2 ...
+    void EnsureDrawIds(int n) {
+        if (n <= nDrawIds)
+            return;
+        int count = std::max(n, 2 * nDrawIds);
+        vector<GLint> ids(count);
+        for (int i = 0; i < count; i++)
+            ids[i] = i;
+        if (!drawIds)
+            glGenBuffers(1, &drawIds);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIds);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(GLint), ids.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(drawIdLocation);
+        glVertexAttribIPointer(drawIdLocation, 1, GL_INT, 0, NULL);
+        glVertexAttribDivisor(drawIdLocation, 1);
+        nDrawIds = count;
+    }
+
+    // data to buffer, bound to target, grown if larger than capacity; the
+    // storage is orphaned each time, so as not to wait on the last frame's
+    // draws still reading it
+    static void Upload(GLenum target, GLuint &buffer, size_t &capacity, const void *data, size_t size) {
+        if (!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        if (size > capacity)
+            capacity = std::max(size, 2 * capacity);
+        glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, size, data);
+    }
+};
+
+#endif
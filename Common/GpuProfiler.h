@@ -0,0 +1,258 @@
+// Author: Nadezhda Chernova
+// File: GpuProfiler.h
+// Date: 10/16/2026
+// GPU time per named pass from timer queries, with primitives generated and
+// tessellation evaluations if asked, read back frames later without stalling
+
+#ifndef GPU_PROFILER_HDR
+#define GPU_PROFILER_HDR
+
+#include "glad.h"
+#include "Timing.h"  // FrameStats
+#include "GLState.h" // HasExtension
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+// GL 4.6 names (ARB_pipeline_statistics_query before)
+#ifndef GL_TESS_EVALUATION_SHADER_INVOCATIONS
+#define GL_TESS_EVALUATION_SHADER_INVOCATIONS 0x82F2
+#endif
+
+// what a scope counts besides time
+enum GpuStats { GpuTime = 0, GpuPrimitives = 1, GpuTessellation = 2 };
+
+// named scopes, each timed with a GL_TIME_ELAPSED query:
+//     gpu.Begin("patch", GpuPrimitives | GpuTessellation);
+//     glDrawArrays(GL_PATCHES, 0, 4);
+//     gpu.End();
+//     ...
+//     glfwSwapBuffers(w);
+//     gpu.EndFrame();
+// GL allows one query per target at a time, so scopes don't nest: a scope
+// begun within another is counted as part of it, and only the outer End
+// closes it. Results
+// are collected once the GPU has them, usually a few frames on, and never
+// waited for; averages are over the last FrameStats::capacity frames
+class GpuProfiler {
+public:
+    GpuProfiler() {}
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+    // stats not supported by the context (tessellation statistics need GL
+    // 4.6 or ARB_pipeline_statistics_query) are skipped
+    void Begin(const char *name, int stats = GpuTime) {
+        if (depth++)
+            return; // within another scope: part of it
+        if (!checked)
+            Check();
+        Sample s;
+        s.scope = Find(name);
+        s.time = Query(GL_TIME_ELAPSED);
+        if (stats & GpuPrimitives)
+            s.primitives = Query(GL_PRIMITIVES_GENERATED);
+        if ((stats & GpuTessellation) && pipelineStatistics)
+            s.evaluations = Query(GL_TESS_EVALUATION_SHADER_INVOCATIONS);
+        issued.push_back(s);
+    }
+
+    // closes the scope only if it is the outermost open
+    void End() {
+        if (!depth || --depth)
+            return;
+        const Sample &s = issued.back();
+        glEndQuery(GL_TIME_ELAPSED);
+        if (s.primitives)
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+        if (s.evaluations)
+            glEndQuery(GL_TESS_EVALUATION_SHADER_INVOCATIONS);
+    }
+
+    // call once per frame, after swapping buffers: collect the frames whose
+    // results have come back, oldest first
+    void EndFrame() {
+        // any scope left open closed
+        if (depth) {
+            depth = 1;
+            End();
+        }
+        pending.push_back(Frame());
+        pending.back().number = nFrames++;
+        pending.back().samples.swap(issued);
+        while (!pending.empty() && Available(pending.front())) {
+            Collect(pending.front());
+            pending.pop_front();
+        }
+    }
+
+    // also append a row per pass per collected frame: frame, pass, this
+    // frame's and the average milliseconds, primitives, tessellation
+    // evaluations; false if the file can't be written
+    bool WriteCsv(const char *filename) {
+        if (csv)
+            fclose(csv);
+        csv = fopen(filename, "w");
+        if (csv)
+            fprintf(csv, "frame,pass,ms,avg ms,primitives,tess evaluations\n");
+        return csv != NULL;
+    }
+
+    // rolling averages per pass
+    void Report() const {
+        for (const Scope &s : scopes) {
+            printf("gpu %s: avg %.3f ms, p99 %.3f ms", s.name.c_str(), 1000 * s.seconds.Avg(),
+                   1000 * s.seconds.Percentile(.99));
+            if (s.primitives.Count())
+                printf(", %.0f primitives", s.primitives.Avg());
+            if (s.evaluations.Count())
+                printf(", %.0f tess evaluations", s.evaluations.Avg());
+            printf(" (%d frames)\n", s.seconds.Count());
+        }
+        if (nCollected)
+            printf("gpu results read %.1f frames late on average, %d at most\n",
+                   (double) totalLate / nCollected, maxLate);
+    }
+
+    void Release() {
+        if (!names.empty())
+            glDeleteQueries((GLsizei) names.size(), names.data());
+        names.clear();
+        spare.clear();
+        issued.clear();
+        pending.clear();
+        depth = 0;
+        if (csv)
+            fclose(csv);
+        csv = NULL;
+    }
+
+private:
+    struct Scope {
+        std::string name;
+        FrameStats seconds, primitives, evaluations;
+        double frameSeconds = 0, framePrimitives = 0, frameEvaluations = 0;
+        bool counted = false, countsPrimitives = false, countsEvaluations = false;
+    };
+    struct Sample {
+        int scope = 0;
+        GLuint time = 0, primitives = 0, evaluations = 0;
+    };
+    struct Frame {
+        long number = 0;
+        std::vector<Sample> samples;
+    };
+    std::vector<Scope> scopes;
+    std::vector<Sample> issued;       // this frame's
+    std::deque<Frame> pending;        // issued, not yet collected
+    std::vector<GLuint> names, spare; // query objects made, and those not in use
+    int depth = 0;                    // scopes open, nested included
+    bool checked = false, pipelineStatistics = false;
+    long nFrames = 0, nCollected = 0, totalLate = 0;
+    int maxLate = 0;
+    FILE *csv = NULL;
+
+    void Check() {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        pipelineStatistics = major > 4 || (major == 4 && minor >= 6) ||
+                             HasExtension("GL_ARB_pipeline_statistics_query");
+        checked = true;
+    }
+
+    int Find(const char *name) {
+        for (int i = 0; i < (int) scopes.size(); i++)
+            if (scopes[i].name == name)
+                return i;
+        scopes.push_back(Scope());
+        scopes.back().name = name;
+        return (int) scopes.size() - 1;
+    }
+
+    // a query object, begun on target
+    GLuint Query(GLenum target) {
+        GLuint q = 0;
+        if (spare.empty()) {
+            glGenQueries(1, &q);
+            names.push_back(q);
+        }
+        else {
+            q = spare.back();
+            spare.pop_back();
+        }
+        glBeginQuery(target, q);
+        return q;
+    }
+
+    static bool Available(GLuint q) {
+        GLuint done = 1;
+        if (q)
+            glGetQueryObjectuiv(q, GL_QUERY_RESULT_AVAILABLE, &done);
+        return done != 0;
+    }
+
+    // queries finish in order, but all of a frame's are checked to be sure
+    static bool Available(const Frame &f) {
+        for (const Sample &s : f.samples)
+            if (!Available(s.time) || !Available(s.primitives) || !Available(s.evaluations))
+                return false;
+        return true;
+    }
+
+    // the result of q (known to be available), and q freed for reuse
+    double Result(GLuint q) {
+        GLuint64 r = 0;
+        glGetQueryObjectui64v(q, GL_QUERY_RESULT, &r);
+        spare.push_back(q);
+        return (double) r;
+    }
+
+    // passes drawn more than once a frame are summed
+    void Collect(const Frame &f) {
+        for (const Sample &s : f.samples) {
+            Scope &scope = scopes[s.scope];
+            scope.counted = true;
+            scope.frameSeconds += 1e-9 * Result(s.time);
+            if (s.primitives) {
+                scope.framePrimitives += Result(s.primitives);
+                scope.countsPrimitives = true;
+            }
+            if (s.evaluations) {
+                scope.frameEvaluations += Result(s.evaluations);
+                scope.countsEvaluations = true;
+            }
+        }
+        for (Scope &scope : scopes) {
+            if (!scope.counted)
+                continue;
+            scope.seconds.Add(scope.frameSeconds);
+            if (scope.countsPrimitives)
+                scope.primitives.Add(scope.framePrimitives);
+            if (scope.countsEvaluations)
+                scope.evaluations.Add(scope.frameEvaluations);
+            if (csv)
+                fprintf(csv, "%ld,%s,%.4f,%.4f,%.0f,%.0f\n", f.number, scope.name.c_str(),
+                        1000 * scope.frameSeconds, 1000 * scope.seconds.Avg(), scope.framePrimitives,
+                        scope.frameEvaluations);
+            scope.frameSeconds = scope.framePrimitives = scope.frameEvaluations = 0;
+            scope.counted = scope.countsPrimitives = scope.countsEvaluations = false;
+        }
+        int late = (int) (nFrames - 1 - f.number);
+        totalLate += late;
+        maxLate = late > maxLate ? late : maxLate;
+        nCollected++;
+    }
+};
+
+// -gpucsv file among command-line arguments: the file, else NULL
+inline const char *GpuCsvArg(int ac, char **av) {
+    for (int i = 1; i + 1 < ac; i++)
+        if (!strcmp(av[i], "-gpucsv"))
+            return av[i + 1];
+    return NULL;
+}
+
+#endif
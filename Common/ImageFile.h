@@ -0,0 +1,37 @@
+// Author: Nadezhda Chernova
+// File: ImageFile.h
+// Date: 10/16/2026
+// Image files decoded to RGBA pixels on any thread
+
+#ifndef IMAGE_FILE_HDR
+#define IMAGE_FILE_HDR
+
+#include "VecMat.h"     // vector
+#include "stb_image.h"  // stbi_load, as compiled into the library's IO
+#include <string.h>
+
+// RGBA pixels of an image file, bottom row first (as ReadTexture uploads them)
+class Image {
+public:
+    vector<unsigned char> pixels;
+    int width = 0, height = 0;
+};
+
+// decode an image file; safe on any thread (the rows are flipped here, as
+// stbi_set_flip_vertically_on_load is global)
+inline bool DecodeImage(const char *filename, Image &image) {
+    int w = 0, h = 0, n = 0;
+    unsigned char *data = stbi_load(filename, &w, &h, &n, 4);
+    if (!data)
+        return false;
+    size_t row = 4 * (size_t) w;
+    image.width = w;
+    image.height = h;
+    image.pixels.resize(row * h);
+    for (int y = 0; y < h; y++)
+        memcpy(&image.pixels[y * row], data + (h - 1 - y) * row, row);
+    stbi_image_free(data);
+    return true;
+}
+
+#endif
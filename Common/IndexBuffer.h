@@ -0,0 +1,188 @@
+// Author: Nadezhda Chernova
+// File: IndexBuffer.h
+// Date: 10/16/2026
+// Element buffers with 16-bit indices where possible: whole meshes of fewer
+// than 65536 vertices, else meshlets drawn with a base vertex
+
+#ifndef INDEX_BUFFER_HDR
+#define INDEX_BUFFER_HDR
+
+#include "glad.h"
+#include "VecMat.h" // vec3, int3
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// consecutive triangles whose vertex indices lie in [baseVertex, baseVertex+65535]
+struct Meshlet {
+    int firstIndex = 0, nIndices = 0; // range in the element buffer
+    int baseVertex = 0;               // added to each index
+    vec3 lo, hi;                      // bounding box
+    vec3 center;                      // bounding sphere
+    float radius = 0;
+};
+
+// triangles in a GL_ELEMENT_ARRAY_BUFFER, as GL_UNSIGNED_SHORT meshlets or,
+// if some triangle spans more than 65536 vertices, as GL_UNSIGNED_INT; the
+// buffer may hold several levels of detail, one after another, each its
+// own run of meshlets
+class IndexBuffer {
+public:
+    GLenum type = GL_UNSIGNED_INT;
+    vector<Meshlet> meshlets;
+    vector<int> levelMeshlets;  // first meshlet of each level, and end
+    vector<int> levelTriangles; // triangles in each level
+    int nTriangles = 0;         // all levels
+
+    size_t IndexSize() const { return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+    size_t Size() const { return 3 * (size_t) nTriangles * IndexSize(); }
+    int Levels() const { return (int) levelTriangles.size(); }
+
+    // split triangles into meshlets, copy them to the bound
+    // GL_ELEMENT_ARRAY_BUFFER; points, if given, set meshlet bounds
+    void Buffer(const int3 *triangles, int nTriangles, int nPoints, const vec3 *points = NULL) {
+        Buffer(triangles, vector<int>(1, nTriangles), nPoints, points);
+    }
+
+    // as above, for levels of detail stored one after another in triangles
+    void Buffer(const int3 *triangles, const vector<int> &levelCounts, int nPoints,
+                const vec3 *points = NULL) {
+        vector<uint16_t> indices;
+        if (Split(triangles, levelCounts, nPoints, indices))
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, Size(), indices.data(), GL_STATIC_DRAW);
+        else
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, Size(), triangles, GL_STATIC_DRAW);
+        if (points)
+            for (Meshlet &ml : meshlets)
+                SetBounds(ml, triangles, points);
+    }
+
+    // the meshlets and type of Buffer, without GL: indices, each less its
+    // meshlet's base vertex, if 16 bits suffice, else false (GL_UNSIGNED_INT,
+    // the triangles as given)
+    bool Split(const int3 *triangles, const vector<int> &levelCounts, int nPoints,
+               vector<uint16_t> &indices) {
+        levelTriangles = levelCounts;
+        nTriangles = 0;
+        for (int n : levelCounts)
+            nTriangles += n;
+        meshlets.clear();
+        levelMeshlets.assign(1, 0);
+        bool fits = true;
+        for (int level = 0, first = 0; level < Levels() && fits; first += levelCounts[level++]) {
+            int end = first + levelCounts[level];
+            if (nPoints <= 0x10000) {
+                // one meshlet, base vertex 0
+                Meshlet m;
+                m.firstIndex = 3 * first;
+                m.nIndices = 3 * levelCounts[level];
+                meshlets.push_back(m);
+            }
+            else {
+                // greedy: extend the current meshlet while its index span
+                // fits 16 bits; meshes reordered by OptimizeVertexFetch need few
+                Meshlet m;
+                m.firstIndex = 3 * first;
+                int lo = 0, hi = 0;
+                for (int t = first; t < end; t++) {
+                    const int3 &tri = triangles[t];
+                    int tlo = std::min(tri.i1, std::min(tri.i2, tri.i3));
+                    int thi = std::max(tri.i1, std::max(tri.i2, tri.i3));
+                    if (thi - tlo > 0xffff) {
+                        fits = false;
+                        break;
+                    }
+                    if (m.nIndices && std::max(hi, thi) - std::min(lo, tlo) > 0xffff) {
+                        meshlets.push_back(m);
+                        m = Meshlet();
+                        m.firstIndex = 3 * t;
+                    }
+                    lo = m.nIndices ? std::min(lo, tlo) : tlo;
+                    hi = m.nIndices ? std::max(hi, thi) : thi;
+                    m.baseVertex = lo;
+                    m.nIndices += 3;
+                }
+                if (m.nIndices)
+                    meshlets.push_back(m);
+            }
+            levelMeshlets.push_back((int) meshlets.size());
+        }
+        if (!fits) {
+            // 32-bit indices, as given: a meshlet per level
+            meshlets.clear();
+            levelMeshlets.assign(1, 0);
+            for (int level = 0, first = 0; level < Levels(); first += levelCounts[level++]) {
+                Meshlet m;
+                m.firstIndex = 3 * first;
+                m.nIndices = 3 * levelCounts[level];
+                meshlets.push_back(m);
+                levelMeshlets.push_back((int) meshlets.size());
+            }
+            type = GL_UNSIGNED_INT;
+            indices.clear();
+            return false;
+        }
+        type = GL_UNSIGNED_SHORT;
+        const int *ids = (const int *) triangles;
+        indices.assign(3 * (size_t) nTriangles, 0);
+        for (Meshlet &ml : meshlets)
+            for (int i = ml.firstIndex; i < ml.firstIndex + ml.nIndices; i++)
+                indices[i] = (uint16_t) (ids[i] - ml.baseVertex);
+        return true;
+    }
+
+    // draw the first n triangles (all if n < 0) of a level of detail, once
+    // per instance: a draw call per meshlet either way
+    void Draw(int n = -1, int level = 0, int nInstances = 1) const {
+        if (level < 0 || level >= Levels())
+            return;
+        const Meshlet *m = meshlets.data() + levelMeshlets[level];
+        const Meshlet *end = meshlets.data() + levelMeshlets[level + 1];
+        if (m == end)
+            return;
+        int nLevel = levelTriangles[level];
+        int last = m->firstIndex + 3 * (n < 0 || n > nLevel ? nLevel : n); // end of drawn indices
+        for (; m < end; m++) {
+            int count = std::min(m->nIndices, last - m->firstIndex);
+            if (count <= 0)
+                break;
+            void *offset = (void *) (m->firstIndex * IndexSize());
+            if (nInstances != 1) {
+                if (m->baseVertex)
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, type, offset,
+                                                      nInstances, m->baseVertex);
+                else
+                    glDrawElementsInstanced(GL_TRIANGLES, count, type, offset, nInstances);
+            }
+            else if (m->baseVertex)
+                glDrawElementsBaseVertex(GL_TRIANGLES, count, type, offset, m->baseVertex);
+            else
+                glDrawElements(GL_TRIANGLES, count, type, offset);
+        }
+    }
+
+private:
+    void SetBounds(Meshlet &m, const int3 *triangles, const vec3 *points) {
+        const int *ids = (const int *) triangles + m.firstIndex;
+        if (!m.nIndices)
+            return;
+        m.lo = m.hi = points[ids[0]];
+        for (int i = 1; i < m.nIndices; i++) {
+            const vec3 &p = points[ids[i]];
+            for (int k = 0; k < 3; k++) {
+                m.lo[k] = std::min(m.lo[k], p[k]);
+                m.hi[k] = std::max(m.hi[k], p[k]);
+            }
+        }
+        m.center = (m.lo + m.hi) / 2;
+        float r2 = 0;
+        for (int i = 0; i < m.nIndices; i++) {
+            vec3 d = points[ids[i]] - m.center;
+            r2 = std::max(r2, dot(d, d));
+        }
+        m.radius = sqrtf(r2);
+    }
+};
+
+#endif
@@ -0,0 +1,125 @@
+// Author: Nadezhda Chernova
+// File: InstanceBuffer.h
+// Date: 10/16/2026
+// Per-instance transforms and tints in a ring buffer, written through a
+// mapping each frame, read by instanced draws
+
+#ifndef INSTANCE_BUFFER_HDR
+#define INSTANCE_BUFFER_HDR
+
+#include "glad.h"
+#include "VecMat.h" // vec4, mat4
+#include <stddef.h>
+
+// the vertex shader reads, per instance:
+//     layout(location = 4) in mat4 instance;     // toWorld, locations 4-7
+//     layout(location = 8) in vec4 instanceTint; // (1, 1, 1, 1) if not given
+// the buffer is a ring of nSegments parts; each Write fills the next part
+// and fences the last, so the CPU never writes what a draw in flight reads
+class InstanceBuffer {
+public:
+    static const GLuint location = 4;     // instance matrix; tint at location+4
+    static const int nSegments = 3;       // frames the GPU may lag
+
+    int count = 0;                        // instances in the part last written
+
+    // copy n transforms, and tints if given, to the next part of the ring;
+    // call once per frame, before Attach and the draw
+    void Write(const mat4 *toWorld, const vec4 *tints, int n) {
+        if (!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        // the last part is read by draws issued since it was written
+        if (written)
+            Fence(segment);
+        size_t bytes = (size_t) n * sizeof(Instance);
+        if (bytes > segmentSize) {
+            // grow (by half again, to avoid regrowing each frame), orphaning the old store
+            segmentSize = bytes + bytes / 2;
+            glBufferData(GL_ARRAY_BUFFER, nSegments * segmentSize, NULL, GL_STREAM_DRAW);
+            for (int s = 0; s < nSegments; s++)
+                Unfence(s);
+        }
+        segment = (segment + 1) % nSegments;
+        Wait(segment);
+        count = n;
+        written = true;
+        if (!n)
+            return;
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        Instance *dst = (Instance *) glMapBufferRange(GL_ARRAY_BUFFER, Offset(), bytes, access);
+        if (!dst) {
+            count = 0;
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            // columns, as a GLSL mat4 attribute takes them
+            const mat4 &m = toWorld[i];
+            for (int c = 0; c < 4; c++)
+                dst[i].columns[c] = vec4(m[0][c], m[1][c], m[2][c], m[3][c]);
+            dst[i].tint = tints ? tints[i] : vec4(1, 1, 1, 1);
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    // point the bound VAO's instance attributes at the part last written;
+    // they advance once per instance
+    void Attach() const {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (GLuint k = 0; k < 5; k++) {
+            size_t offset = Offset() + (k < 4 ? k * sizeof(vec4) : offsetof(Instance, tint));
+            glEnableVertexAttribArray(location + k);
+            glVertexAttribPointer(location + k, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) offset);
+            glVertexAttribDivisor(location + k, 1);
+        }
+    }
+
+    // free the buffer and fences while the GL context is current
+    void Release() {
+        for (int s = 0; s < nSegments; s++)
+            Unfence(s);
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        segmentSize = 0;
+        count = 0;
+        written = false;
+    }
+
+    InstanceBuffer() {}
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+private:
+    struct Instance {
+        vec4 columns[4];
+        vec4 tint;
+    };
+    GLuint buffer = 0;
+    size_t segmentSize = 0;               // bytes per part
+    int segment = 0;                      // part last written
+    bool written = false;
+    GLsync fences[nSegments] = {};
+
+    size_t Offset() const { return segment * segmentSize; }
+
+    void Fence(int s) {
+        Unfence(s);
+        fences[s] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void Unfence(int s) {
+        if (fences[s])
+            glDeleteSync(fences[s]);
+        fences[s] = 0;
+    }
+
+    // until draws reading part s are done (at most a second)
+    void Wait(int s) {
+        if (fences[s])
+            glClientWaitSync(fences[s], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        Unfence(s);
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+// Author: Nadezhda Chernova
+// File: LightBlock.h
+// Date: 10/16/2026
+// Lights in a uniform buffer that all programs share at a fixed binding
+// point, rewritten only when a light or the camera moves
+
+#ifndef LIGHT_BLOCK_HDR
+#define LIGHT_BLOCK_HDR
+
+#include "glad.h"
+#include "VecMat.h"  // vec3, vec4, mat4
+#include "Program.h" // Program
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// the block as shaders declare it:
+//     struct Light {
+//         vec4 position; // eye space; w: range, 0 if unlimited
+//         vec4 color;    // rgb; a: intensity
+//     };
+//     layout(std140) uniform Lights {
+//         int nLights;
+//         Light lights[256];
+//     };
+// (LightCode, in ClusteredLights.h, declares it so); a light with a range
+// fades to nothing there, as (1-distance/range)^2
+class LightBlock {
+public:
+    static const int maxLights = 256;  // as shaders declare the block
+    static const GLuint binding = 0;   // uniform buffer binding point
+
+    // attach the program's Lights block to the binding point, after linking;
+    // false if the program has none
+    bool Attach(const Program &program) const { return program.BlockBinding("Lights", binding); }
+
+    // color, intensity and range (0: unlimited) of light i; positions are
+    // given to Update, lights default to white, intensity 1, unlimited
+    void Set(int i, vec3 color, float intensity = 1, float range = 0) {
+        if (i < 0 || i >= maxLights)
+            return;
+        if (i >= (int) props.size())
+            props.resize(i + 1);
+        props[i] = {color, intensity, range};
+        dirty = true;
+    }
+
+    // send n lights at world-space positions, in eye space, if a light or the
+    // camera has moved (as Mover and Camera do) since the last call; true if
+    // the buffer was rewritten
+    bool Update(const vec3 *positions, int n, const mat4 &modelview) {
+        n = n < maxLights ? n : maxLights;
+        nUpdates++;
+        if (!dirty && n == (int) last.size() && !memcmp(&modelview, &lastModelview, sizeof(mat4)) &&
+            (!n || !memcmp(positions, last.data(), n * sizeof(vec3))))
+            return false;
+        last.assign(positions, positions + n);
+        lastModelview = modelview;
+        dirty = false;
+        block.nLights = n;
+        for (int i = 0; i < n; i++) {
+            Props p = i < (int) props.size() ? props[i] : Props();
+            vec4 x = modelview * vec4(positions[i], 1);
+            block.lights[i].position = vec4(x.x, x.y, x.z, p.range);
+            block.lights[i].color = vec4(p.color, p.intensity);
+        }
+        if (!ubo) {
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+        }
+        else
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        // the count, and only the lights in use
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(Block, lights) + n * sizeof(GpuLight), &block);
+        nUploads++;
+        return true;
+    }
+
+    // force a rewrite on the next Update
+    void Dirty() { dirty = true; }
+
+    // free the buffer while the GL context is current
+    void Release() {
+        if (ubo)
+            glDeleteBuffers(1, &ubo);
+        ubo = 0;
+        dirty = true;
+    }
+
+    void Report() const {
+        printf("lights: %ld uploads in %ld frames\n", nUploads, nUpdates);
+    }
+
+    LightBlock() {}
+    LightBlock(const LightBlock &) = delete;
+    LightBlock &operator=(const LightBlock &) = delete;
+
+private:
+    struct Props {
+        vec3 color = vec3(1, 1, 1);
+        float intensity = 1, range = 0;
+    };
+    // std140: vec4s, the array starting at 16 bytes
+    struct GpuLight {
+        vec4 position, color;
+    };
+    struct Block {
+        GLint nLights;
+        GLint pad[3];
+        GpuLight lights[maxLights];
+    };
+    vector<Props> props;
+    vector<vec3> last;
+    mat4 lastModelview;
+    bool dirty = true;
+    Block block;
+    GLuint ubo = 0;
+    long nUpdates = 0, nUploads = 0;
+};
+
+#endif
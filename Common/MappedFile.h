@@ -0,0 +1,150 @@
+// Author: Nadezhda Chernova
+// File: MappedFile.h
+// Date: 10/16/2026
+// Read-only memory-mapped file
+
+#ifndef MAPPED_FILE_HDR
+#define MAPPED_FILE_HDR
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <functional>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+    // without min and max macros, which break std::min and std::max
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+// 64-bit FNV-1a, continued from hash
+inline uint64_t HashBytes(const void *data, size_t n, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char *b = (const unsigned char *) data;
+    for (size_t i = 0; i < n; i++)
+        hash = (hash ^ b[i]) * 1099511628211ull;
+    return hash;
+}
+
+// size and modification time of a file, false if it doesn't exist
+inline bool FileStamp(const char *filename, uint64_t &size, int64_t &mtime) {
+    struct stat s;
+    if (stat(filename, &s) != 0)
+        return false;
+    size = (uint64_t) s.st_size;
+    mtime = (int64_t) s.st_mtime;
+    return true;
+}
+
+// a temporary name beside filename, unique to this process and thread, for
+// writers that may race (two loads of one OBJ with different options)
+inline std::string TempName(const char *filename) {
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long) getpid();
+#endif
+    size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%lu.%zx.tmp", pid, thread);
+    return std::string(filename) + suffix;
+}
+
+// move from over to, replacing any file there (rename alone fails on
+// Windows if to exists); for caches written to a temporary, then moved into
+// place so that readers never map a partial file
+inline bool RenameReplacing(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// whole file mapped into memory, pages are read by the OS on first touch
+class MappedFile {
+public:
+    const char *data = NULL; // start of mapped bytes
+    size_t size = 0;         // number of mapped bytes
+
+    bool Open(const char *filename) {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER s;
+        if (!GetFileSizeEx(file, &s) || s.QuadPart == 0) {
+            Close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+            data = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            Close();
+            return false;
+        }
+        size = (size_t) s.QuadPart;
+#else
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat s;
+        if (fstat(fd, &s) != 0 || s.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void *p = mmap(NULL, (size_t) s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // mapping stays valid after the descriptor is closed
+        if (p == MAP_FAILED)
+            return false;
+        data = (const char *) p;
+        size = (size_t) s.st_size;
+#endif
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void *) data, size);
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    bool IsOpen() const { return data != NULL; }
+
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { Close(); }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = NULL;
+#endif
+};
+
+#endif
@@ -0,0 +1,407 @@
+// Author: Nadezhda Chernova
+// File: MeshCache.h
+// Date: 10/16/2026
+// Binary, memory-mapped cache of standardized OBJ meshes
+
+#ifndef MESH_CACHE_HDR
+#define MESH_CACHE_HDR
+
+#include "VecMat.h"     // vec2, vec3, int3
+#include "IO.h"         // ReadAsciiObj, SetVertexNormals, Standardize
+#include "MappedFile.h" // MappedFile, FileStamp, HashBytes, TempName, RenameReplacing
+#include "ObjReader.h"  // ReadAsciiObjParallel
+#include "VertexNormals.h" // SetVertexNormalsParallel
+#include "VertexTangents.h" // SetVertexTangentsParallel
+#include "MeshOptimize.h"  // OptimizeMesh, VertexCacheStats
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <string>
+
+// bump whenever the layout or the processing baked into the cache changes
+const uint32_t meshCacheVersion = 7;
+
+// processing applied before a mesh is cached; part of the cache key
+struct MeshLoadOptions {
+    float standardize = 1;  // scale given to Standardize, 0 leaves points as read
+    bool setNormals = true; // generate vertex normals if the OBJ has none
+    NormalWeight normalWeight = NormalWeight::Uniform;
+    bool optimize = true;   // reorder for vertex cache, overdraw and vertex fetch
+    bool setTangents = false; // generate tangent frames (needs normals and uvs)
+};
+
+// file layout: header, then points | normals | uvs | tangents | triangles;
+// points, normals, uvs and tangents form one block in the order the VBO
+// expects
+struct MeshCacheHeader {
+    char magic[4];                  // "MSHC"
+    uint32_t version;               // meshCacheVersion
+    uint32_t nPoints, nTriangles;
+    uint32_t nNormals, nUvs;        // either 0 or nPoints
+    uint32_t nTangents;             // either 0 or nPoints
+    float standardize;              // MeshLoadOptions used to build the cache
+    uint32_t setNormals, normalWeight, optimize, setTangents;
+    float acmrBefore, atvrBefore;   // vertex cache statistics, OBJ order
+    float acmrAfter, atvrAfter;     // and as cached
+    uint64_t sourceSize;            // OBJ size and time, to detect a stale cache
+    int64_t sourceTime;
+    uint64_t pointsOffset, normalsOffset, uvsOffset, tangentsOffset, trianglesOffset;
+};
+
+inline string MeshOptionString(const MeshLoadOptions &opts) {
+    char s[100];
+    snprintf(s, sizeof(s), "mesh %g %d %d %d %d", opts.standardize, (int) opts.setNormals,
+             (int) opts.normalWeight, (int) opts.optimize, (int) opts.setTangents);
+    return s;
+}
+
+// <objFilename>.<hash of opts>.mcache, so that apps loading one OBJ with
+// different options keep a cache each (the header still records the options)
+inline string MeshCacheName(const char *objFilename, const MeshLoadOptions &opts) {
+    string options = MeshOptionString(opts);
+    char s[32];
+    snprintf(s, sizeof(s), ".%08x.mcache", (unsigned) HashBytes(options.data(), options.size()));
+    return string(objFilename) + s;
+}
+
+// true if the header's sections follow it and each other in order, with
+// per-vertex arrays either absent or nPoints long, and end at fileSize
+inline bool MeshCacheSectionsValid(const MeshCacheHeader &h, uint64_t fileSize) {
+    for (uint32_t n : {h.nNormals, h.nUvs, h.nTangents})
+        if (n != 0 && n != h.nPoints)
+            return false;
+    struct { uint64_t offset, bytes; } sections[] = {
+        {h.pointsOffset, (uint64_t) h.nPoints * sizeof(vec3)},
+        {h.normalsOffset, (uint64_t) h.nNormals * sizeof(vec3)},
+        {h.uvsOffset, (uint64_t) h.nUvs * sizeof(vec2)},
+        {h.tangentsOffset, (uint64_t) h.nTangents * sizeof(vec4)},
+        {h.trianglesOffset, (uint64_t) h.nTriangles * sizeof(int3)}};
+    uint64_t at = sizeof(MeshCacheHeader);
+    for (auto &s : sections) {
+        // compared as differences, which can't overflow
+        if (s.offset != at || s.bytes > fileSize - at)
+            return false;
+        at += s.bytes;
+    }
+    return at == fileSize;
+}
+
+// true if header is current, was built with opts from the given OBJ, and
+// its sections account for all fileSize bytes
+inline bool MeshCacheMatches(const MeshCacheHeader &h, const MeshLoadOptions &opts,
+                             uint64_t sourceSize, int64_t sourceTime, uint64_t fileSize) {
+    return !strncmp(h.magic, "MSHC", 4) && h.version == meshCacheVersion &&
+           h.standardize == opts.standardize &&
+           h.setNormals == (uint32_t) opts.setNormals &&
+           h.normalWeight == (uint32_t) opts.normalWeight &&
+           h.optimize == (uint32_t) opts.optimize &&
+           h.setTangents == (uint32_t) opts.setTangents &&
+           h.sourceSize == sourceSize && h.sourceTime == sourceTime &&
+           MeshCacheSectionsValid(h, fileSize);
+}
+
+// mesh arrays, mapped from a cache file (or, if the cache couldn't be
+// written, held in memory); the vertex block can go straight to glBufferData
+class CachedMesh {
+public:
+    int nPoints = 0, nTriangles = 0;
+    const vec3 *points = NULL, *normals = NULL; // normals may be NULL
+    const vec2 *uvs = NULL;                     // uvs may be NULL
+    const vec4 *tangents = NULL;                // tangents may be NULL
+    const int3 *triangles = NULL;
+    const char *vertices = NULL;                // points, normals, uvs, tangents
+    size_t vertexSize = 0;                      // bytes in vertex block
+    size_t normalsOffset = 0, uvsOffset = 0, tangentsOffset = 0; // relative to vertices
+    VertexCacheStats cacheBefore, cacheAfter;   // OBJ order, cached order
+
+    size_t TrianglesSize() const { return nTriangles * sizeof(int3); }
+
+    // map cache file, false if missing, corrupt or built differently
+    bool Map(const char *cacheFilename, const MeshLoadOptions &opts,
+             uint64_t sourceSize, int64_t sourceTime) {
+        Release();
+        if (!file.Open(cacheFilename))
+            return false;
+        if (file.size < sizeof(MeshCacheHeader)) {
+            Release();
+            return false;
+        }
+        const MeshCacheHeader *h = (const MeshCacheHeader *) file.data;
+        if (!MeshCacheMatches(*h, opts, sourceSize, sourceTime, file.size)) {
+            Release();
+            return false;
+        }
+        const char *base = file.data;
+        nPoints = h->nPoints;
+        nTriangles = h->nTriangles;
+        points = (const vec3 *) (base + h->pointsOffset);
+        normals = h->nNormals ? (const vec3 *) (base + h->normalsOffset) : NULL;
+        uvs = h->nUvs ? (const vec2 *) (base + h->uvsOffset) : NULL;
+        tangents = h->nTangents ? (const vec4 *) (base + h->tangentsOffset) : NULL;
+        triangles = (const int3 *) (base + h->trianglesOffset);
+        vertices = base + h->pointsOffset;
+        vertexSize = h->trianglesOffset - h->pointsOffset;
+        normalsOffset = h->normalsOffset - h->pointsOffset;
+        uvsOffset = h->uvsOffset - h->pointsOffset;
+        tangentsOffset = h->tangentsOffset - h->pointsOffset;
+        cacheBefore.acmr = h->acmrBefore;
+        cacheBefore.atvr = h->atvrBefore;
+        cacheAfter.acmr = h->acmrAfter;
+        cacheAfter.atvr = h->atvrAfter;
+        return true;
+    }
+
+    // keep arrays in memory, laid out as in the cache
+    void Adopt(vector<vec3> &p, vector<vec3> &n, vector<vec2> &t, vector<vec4> &tan,
+               vector<int3> &tris) {
+        Release();
+        size_t sPts = p.size() * sizeof(vec3), sNrms = n.size() * sizeof(vec3);
+        size_t sUvs = t.size() * sizeof(vec2), sTans = tan.size() * sizeof(vec4);
+        block.resize(sPts + sNrms + sUvs + sTans);
+        memcpy(block.data(), p.data(), sPts);
+        memcpy(block.data() + sPts, n.data(), sNrms);
+        memcpy(block.data() + sPts + sNrms, t.data(), sUvs);
+        memcpy(block.data() + sPts + sNrms + sUvs, tan.data(), sTans);
+        ownTriangles.swap(tris);
+        nPoints = (int) p.size();
+        nTriangles = (int) ownTriangles.size();
+        vertices = block.data();
+        vertexSize = block.size();
+        normalsOffset = sPts;
+        uvsOffset = sPts + sNrms;
+        tangentsOffset = uvsOffset + sUvs;
+        points = (const vec3 *) vertices;
+        normals = sNrms ? (const vec3 *) (vertices + normalsOffset) : NULL;
+        uvs = sUvs ? (const vec2 *) (vertices + uvsOffset) : NULL;
+        tangents = sTans ? (const vec4 *) (vertices + tangentsOffset) : NULL;
+        triangles = ownTriangles.data();
+    }
+
+    void Release() {
+        file.Close();
+        block.clear();
+        ownTriangles.clear();
+        nPoints = nTriangles = 0;
+        points = normals = NULL;
+        uvs = NULL;
+        tangents = NULL;
+        triangles = NULL;
+        vertices = NULL;
+        vertexSize = normalsOffset = uvsOffset = tangentsOffset = 0;
+        cacheBefore = cacheAfter = VertexCacheStats();
+    }
+
+    CachedMesh() {}
+    CachedMesh(const CachedMesh &) = delete;
+    CachedMesh &operator=(const CachedMesh &) = delete;
+
+private:
+    MappedFile file;
+    vector<char> block;
+    vector<int3> ownTriangles;
+};
+
+inline bool WriteMeshCache(const char *cacheFilename, const MeshLoadOptions &opts,
+                           uint64_t sourceSize, int64_t sourceTime,
+                           vector<vec3> &points, vector<vec3> &normals,
+                           vector<vec2> &uvs, vector<vec4> &tangents, vector<int3> &triangles,
+                           VertexCacheStats before = VertexCacheStats(),
+                           VertexCacheStats after = VertexCacheStats()) {
+    MeshCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "MSHC", 4);
+    h.version = meshCacheVersion;
+    h.nPoints = (uint32_t) points.size();
+    h.nTriangles = (uint32_t) triangles.size();
+    h.nNormals = (uint32_t) normals.size();
+    h.nUvs = (uint32_t) uvs.size();
+    h.nTangents = (uint32_t) tangents.size();
+    h.standardize = opts.standardize;
+    h.setNormals = opts.setNormals;
+    h.normalWeight = (uint32_t) opts.normalWeight;
+    h.optimize = opts.optimize;
+    h.setTangents = opts.setTangents;
+    h.acmrBefore = before.acmr;
+    h.atvrBefore = before.atvr;
+    h.acmrAfter = after.acmr;
+    h.atvrAfter = after.atvr;
+    h.sourceSize = sourceSize;
+    h.sourceTime = sourceTime;
+    h.pointsOffset = sizeof(MeshCacheHeader);
+    h.normalsOffset = h.pointsOffset + points.size() * sizeof(vec3);
+    h.uvsOffset = h.normalsOffset + normals.size() * sizeof(vec3);
+    h.tangentsOffset = h.uvsOffset + uvs.size() * sizeof(vec2);
+    h.trianglesOffset = h.tangentsOffset + tangents.size() * sizeof(vec4);
+    // write to a temporary, then move it into place
+    string tmp = TempName(cacheFilename);
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(points.data(), sizeof(vec3), points.size(), f) == points.size() &&
+              fwrite(normals.data(), sizeof(vec3), normals.size(), f) == normals.size() &&
+              fwrite(uvs.data(), sizeof(vec2), uvs.size(), f) == uvs.size() &&
+              fwrite(tangents.data(), sizeof(vec4), tangents.size(), f) == tangents.size() &&
+              fwrite(triangles.data(), sizeof(int3), triangles.size(), f) == triangles.size();
+    ok = fclose(f) == 0 && ok;
+    if (ok)
+        ok = RenameReplacing(tmp.c_str(), cacheFilename);
+    if (!ok)
+        remove(tmp.c_str());
+    return ok;
+}
+
+// read OBJ, generate normals, standardize, optimize, generate tangents: the
+// work the cache saves
+inline bool ReadAndProcessObj(const char *objFilename, const MeshLoadOptions &opts,
+                              vector<vec3> &points, vector<vec3> &normals,
+                              vector<vec2> &uvs, vector<vec4> &tangents, vector<int3> &triangles,
+                              VertexCacheStats *before = NULL,
+                              VertexCacheStats *after = NULL) {
+    if (!ReadAsciiObjParallel(objFilename, points, triangles, &normals, &uvs))
+        return false;
+    // per-vertex arrays only
+    if (normals.size() != points.size())
+        normals.clear();
+    if (uvs.size() != points.size())
+        uvs.clear();
+    if (opts.setNormals && normals.empty())
+        SetVertexNormalsParallel(points, triangles, normals, opts.normalWeight);
+    if (opts.standardize > 0)
+        Standardize(points.data(), points.size(), opts.standardize);
+    VertexCacheStats b, a;
+    if (opts.optimize)
+        OptimizeMesh(points, normals, uvs, triangles, b, a);
+    else
+        b = a = AnalyzeVertexCache(triangles.data(), (int) triangles.size(), (int) points.size());
+    // after reordering, vertices split for mirrored uvs go at the end
+    tangents.clear();
+    if (opts.setTangents &&
+        SetVertexTangentsParallel(points, normals, uvs, triangles, tangents) > 0)
+        a = AnalyzeVertexCache(triangles.data(), (int) triangles.size(), (int) points.size());
+    if (before) *before = b;
+    if (after) *after = a;
+    return true;
+}
+
+inline void PrintVertexCacheStats(const char *objFilename, VertexCacheStats before,
+                                  VertexCacheStats after) {
+    const char *name = strrchr(objFilename, '/');
+    printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name ? name + 1 : objFilename,
+           before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+// map cached mesh for objFilename; on first load (or if the OBJ changed)
+// parse the OBJ, process it per opts and write the cache; if report, print
+// vertex cache statistics
+inline bool LoadCachedMesh(const char *objFilename, CachedMesh &mesh,
+                           MeshLoadOptions opts = MeshLoadOptions(), bool report = true) {
+    uint64_t size = 0;
+    int64_t time = 0;
+    string cacheName = MeshCacheName(objFilename, opts);
+    bool haveSource = FileStamp(objFilename, size, time);
+    if (!haveSource || !mesh.Map(cacheName.c_str(), opts, size, time)) {
+        vector<vec3> points, normals;
+        vector<vec2> uvs;
+        vector<vec4> tangents;
+        vector<int3> triangles;
+        VertexCacheStats before, after;
+        if (!haveSource || !ReadAndProcessObj(objFilename, opts, points, normals, uvs, tangents,
+                                              triangles, &before, &after))
+            return false;
+        if (!WriteMeshCache(cacheName.c_str(), opts, size, time, points, normals, uvs, tangents,
+                            triangles, before, after) ||
+            !mesh.Map(cacheName.c_str(), opts, size, time)) {
+            printf("can't write %s, using uncached mesh\n", cacheName.c_str());
+            mesh.Adopt(points, normals, uvs, tangents, triangles);
+            mesh.cacheBefore = before;
+            mesh.cacheAfter = after;
+        }
+    }
+    if (report)
+        PrintVertexCacheStats(objFilename, mesh.cacheBefore, mesh.cacheAfter);
+    return true;
+}
+
+// compare cold ASCII load (parse, normals, standardize) with warm mapped load
+inline void BenchmarkMeshCache(const char *objFilename,
+                               MeshLoadOptions opts = MeshLoadOptions(), int repeats = 5) {
+    using Clock = std::chrono::steady_clock;
+    auto Ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    double serial = 0, parallel = 0, serialNormals = 0, parallelNormals = 0;
+    double cold = 0, warm = 0, normalsDiff = 0;
+    size_t nTriangles = 0;
+    for (int i = 0; i < repeats; i++) {
+        vector<vec3> points, normals, normals2;
+        vector<vec2> uvs;
+        vector<int3> triangles;
+        Clock::time_point t0 = Clock::now();
+        ReadAsciiObj(objFilename, points, triangles, &normals, &uvs);
+        Clock::time_point t1 = Clock::now();
+        ReadAsciiObjParallel(objFilename, points, triangles, &normals, &uvs);
+        // generate normals from scratch, not over those the OBJ supplied
+        normals.clear();
+        Clock::time_point t2 = Clock::now();
+        SetVertexNormals(points, triangles, normals);
+        Clock::time_point t3 = Clock::now();
+        SetVertexNormalsParallel(points, triangles, normals2, opts.normalWeight);
+        serial += Ms(t0, t1);
+        parallel += Ms(t1, t2);
+        serialNormals += Ms(t2, t3);
+        parallelNormals += Ms(t3, Clock::now());
+        for (size_t k = 0; k < normals.size() && k < normals2.size(); k++)
+            normalsDiff = std::max(normalsDiff, (double) length(normals[k] - normals2[k]));
+    }
+    for (int i = 0; i < repeats; i++) {
+        vector<vec3> points, normals;
+        vector<vec2> uvs;
+        vector<vec4> tangents;
+        vector<int3> triangles;
+        Clock::time_point t0 = Clock::now();
+        if (!ReadAndProcessObj(objFilename, opts, points, normals, uvs, tangents, triangles)) {
+            printf("can't read %s\n", objFilename);
+            return;
+        }
+        cold += Ms(t0, Clock::now());
+        nTriangles = triangles.size();
+    }
+    CachedMesh mesh;
+    if (!LoadCachedMesh(objFilename, mesh, opts))
+        return;
+    for (int i = 0; i < repeats; i++) {
+        Clock::time_point t0 = Clock::now();
+        if (!LoadCachedMesh(objFilename, mesh, opts, false))
+            return;
+        // touch every page, as glBufferData would
+        unsigned sum = 0;
+        for (size_t k = 0; k < mesh.vertexSize; k += 4096)
+            sum += mesh.vertices[k];
+        const char *t = (const char *) mesh.triangles;
+        for (size_t k = 0; k < mesh.TrianglesSize(); k += 4096)
+            sum += t[k];
+        warm += Ms(t0, Clock::now());
+        if (sum == 1) printf(" "); // keep the loop from being optimized away
+    }
+    serial /= repeats;
+    parallel /= repeats;
+    serialNormals /= repeats;
+    parallelNormals /= repeats;
+    cold /= repeats;
+    warm /= repeats;
+    printf("%s: %zu triangles\n", objFilename, nTriangles);
+    printf("  ReadAsciiObj:         %8.3f ms\n", serial);
+    printf("  ReadAsciiObjParallel: %8.3f ms (%d threads, %.1fx faster)\n", parallel,
+           ThreadCount(), parallel > 0 ? serial / parallel : 0);
+    printf("  SetVertexNormals:     %8.3f ms\n", serialNormals);
+    printf("  ...Parallel:          %8.3f ms (%.1fx faster, max difference %g)\n",
+           parallelNormals, parallelNormals > 0 ? serialNormals / parallelNormals : 0,
+           normalsDiff);
+    printf("  cold ASCII load:      %8.3f ms\n", cold);
+    printf("  warm mmap load:       %8.3f ms (%.1fx faster)\n", warm,
+           warm > 0 ? cold / warm : 0);
+}
+
+#endif
@@ -0,0 +1,280 @@
+// Author: Nadezhda Chernova
+// File: MeshLod.h
+// Date: 10/16/2026
+// Levels of detail by quadric edge collapse, chosen by projected size
+
+#ifndef MESH_LOD_HDR
+#define MESH_LOD_HDR
+
+#include "VecMat.h"       // vec3, int3, mat4
+#include "MeshOptimize.h" // OptimizeVertexCache
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+struct Quadric {
+    double a[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0}; // xx xy xz xw yy yz yw zz zw ww
+
+    void AddPlane(const vec3 &n, float d) {
+        double p[4] = {n.x, n.y, n.z, d};
+        for (int i = 0, k = 0; i < 4; i++)
+            for (int j = i; j < 4; j++)
+                a[k++] += p[i] * p[j];
+    }
+
+    void Add(const Quadric &q) {
+        for (int k = 0; k < 10; k++)
+            a[k] += q.a[k];
+    }
+
+    double Error(const vec3 &p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x +
+                   a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y +
+                   a[7] * z * z + 2 * a[8] * z + a[9];
+        return e > 0 ? e : 0;
+    }
+};
+
+// collapse vertices of triangles into neighbors (half-edge collapse, so
+// points stay in place and all levels share one vertex buffer) until at most
+// targetTriangles remain or no collapse is allowed; returns the geometric
+// error, the largest distance from a removed vertex to its merged planes.
+// Vertices on a border, or on a seam (sharing a position with another
+// vertex, as where uvs or normals are split), are never removed. A collapse
+// is rejected if it flips a triangle; its cost grows as the normals of the
+// two vertices (if given) diverge
+inline float SimplifyMesh(const vec3 *points, const vec3 *normals, int nPoints,
+                          vector<int3> &triangles, int targetTriangles) {
+    // lock seam vertices: one id per distinct position
+    vector<int> weld(nPoints);
+    {
+        struct Hash {
+            size_t operator()(const vec3 &p) const {
+                uint32_t h[3];
+                memcpy(h, &p, sizeof(h));
+                return h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u;
+            }
+        };
+        struct Equal {
+            bool operator()(const vec3 &a, const vec3 &b) const {
+                return a.x == b.x && a.y == b.y && a.z == b.z;
+            }
+        };
+        std::unordered_map<vec3, int, Hash, Equal> first;
+        first.reserve(nPoints);
+        for (int i = 0; i < nPoints; i++)
+            weld[i] = first.emplace(points[i], i).first->second;
+    }
+    vector<char> locked(nPoints, 0);
+    for (int i = 0; i < nPoints; i++)
+        if (weld[i] != i)
+            locked[i] = locked[weld[i]] = 1;
+    // lock border vertices: welded edges used once
+    {
+        std::unordered_map<uint64_t, int> edges;
+        edges.reserve(3 * triangles.size());
+        auto Key = [](int a, int b) { return a < b ? (uint64_t) a << 32 | (uint32_t) b : (uint64_t) b << 32 | (uint32_t) a; };
+        for (int3 &t : triangles)
+            for (int k = 0; k < 3; k++)
+                edges[Key(weld[t[k]], weld[t[(k + 1) % 3]])]++;
+        for (auto &e : edges)
+            if (e.second == 1)
+                locked[e.first >> 32] = locked[(uint32_t) e.first] = 1;
+        for (int i = 0; i < nPoints; i++)
+            if (locked[weld[i]])
+                locked[i] = 1;
+    }
+    // plane quadrics per vertex
+    vector<Quadric> quadrics(nPoints);
+    for (int3 &t : triangles) {
+        vec3 n = cross(points[t[1]] - points[t[0]], points[t[2]] - points[t[0]]);
+        float len = length(n);
+        if (len <= 0)
+            continue;
+        n = n / len;
+        Quadric q;
+        q.AddPlane(n, -dot(n, points[t[0]]));
+        for (int k = 0; k < 3; k++)
+            quadrics[t[k]].Add(q);
+    }
+    struct Collapse {
+        float cost;
+        int from, to;
+    };
+    double maxCost = 0;
+    vector<Collapse> collapses;
+    vector<int> first(nPoints + 1), adjacent;
+    vector<char> touched(nPoints), dead;
+    // passes of independent collapses, cheapest first
+    while ((int) triangles.size() > targetTriangles) {
+        int nTriangles = (int) triangles.size();
+        // vertex to triangle adjacency
+        std::fill(first.begin(), first.end(), 0);
+        for (int3 &t : triangles)
+            for (int k = 0; k < 3; k++)
+                first[t[k] + 1]++;
+        for (int v = 0; v < nPoints; v++)
+            first[v + 1] += first[v];
+        adjacent.resize(3 * (size_t) nTriangles);
+        vector<int> fill(first.begin(), first.end() - 1);
+        for (int t = 0; t < nTriangles; t++)
+            for (int k = 0; k < 3; k++)
+                adjacent[fill[triangles[t][k]]++] = t;
+        // each directed edge once, as it appears in its triangle
+        collapses.clear();
+        for (int3 &t : triangles)
+            for (int k = 0; k < 3; k++) {
+                int from = t[k], to = t[(k + 1) % 3];
+                if (locked[from] || from == to)
+                    continue;
+                Quadric q = quadrics[from];
+                q.Add(quadrics[to]);
+                double cost = q.Error(points[to]);
+                if (normals) {
+                    vec3 e = points[to] - points[from];
+                    cost += (1 - dot(normals[from], normals[to])) * dot(e, e);
+                }
+                collapses.push_back({(float) cost, from, to});
+            }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+        std::fill(touched.begin(), touched.end(), 0);
+        dead.assign(nTriangles, 0);
+        int remaining = nTriangles, nCollapsed = 0;
+        for (Collapse &c : collapses) {
+            if (remaining <= targetTriangles)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+            // reject if a surviving triangle would flip or become degenerate
+            bool ok = true;
+            for (int i = first[c.from]; i < first[c.from + 1] && ok; i++) {
+                int3 t = triangles[adjacent[i]];
+                if (t[0] == c.to || t[1] == c.to || t[2] == c.to)
+                    continue;
+                vec3 before = cross(points[t[1]] - points[t[0]], points[t[2]] - points[t[0]]);
+                for (int k = 0; k < 3; k++)
+                    if (t[k] == c.from)
+                        t[k] = c.to;
+                vec3 after = cross(points[t[1]] - points[t[0]], points[t[2]] - points[t[0]]);
+                ok = dot(before, after) > .1f * length(before) * length(after);
+            }
+            if (!ok)
+                continue;
+            // collapse; its neighborhood waits for the next pass
+            for (int i = first[c.from]; i < first[c.from + 1]; i++) {
+                int3 &t = triangles[adjacent[i]];
+                for (int k = 0; k < 3; k++)
+                    touched[t[k]] = 1;
+                if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+                    if (!dead[adjacent[i]]) {
+                        dead[adjacent[i]] = 1;
+                        remaining--;
+                    }
+                }
+                for (int k = 0; k < 3; k++)
+                    if (t[k] == c.from)
+                        t[k] = c.to;
+            }
+            quadrics[c.to].Add(quadrics[c.from]);
+            maxCost = std::max(maxCost, (double) c.cost);
+            nCollapsed++;
+        }
+        if (!nCollapsed)
+            break;
+        int n = 0;
+        for (int t = 0; t < nTriangles; t++)
+            if (!dead[t])
+                triangles[n++] = triangles[t];
+        triangles.resize(n);
+    }
+    return (float) sqrt(maxCost);
+}
+
+// levels of detail sharing one vertex array: level 0 is the full mesh, each
+// next level has about half the triangles of the previous
+class LodChain {
+public:
+    vector<int3> triangles; // all levels, one after another
+    vector<int> counts;     // triangles per level
+    vector<float> errors;   // geometric error per level, in model space
+    vec3 center;            // bounding sphere, in model space
+    float radius = 0;
+    vec3 lo, hi;            // bounding box, in model space
+
+    int Levels() const { return (int) counts.size(); }
+
+    // coarsest level whose error projects to at most pixelError, given
+    // the bounding sphere's projected radius in pixels
+    int Select(float projectedRadius, float pixelError = 1) const {
+        int level = 0;
+        for (int i = 1; i < Levels(); i++)
+            if (errors[i] * projectedRadius <= pixelError * radius)
+                level = i;
+        return level;
+    }
+};
+
+// simplify until a level would have fewer than minTriangles, or would
+// drop less than a tenth of the previous level's triangles
+inline void BuildLodChain(const vec3 *points, const vec3 *normals, int nPoints,
+                          const int3 *triangles, int nTriangles, LodChain &lods,
+                          int maxLevels = 8, int minTriangles = 64) {
+    lods.triangles.assign(triangles, triangles + nTriangles);
+    lods.counts.assign(1, nTriangles);
+    lods.errors.assign(1, 0);
+    // bounding sphere: center of the box, farthest point
+    vec3 lo = nPoints ? points[0] : vec3(0, 0, 0), hi = lo;
+    for (int i = 1; i < nPoints; i++)
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], points[i][k]);
+            hi[k] = std::max(hi[k], points[i][k]);
+        }
+    lods.lo = lo;
+    lods.hi = hi;
+    lods.center = (lo + hi) / 2;
+    float r2 = 0;
+    for (int i = 0; i < nPoints; i++) {
+        vec3 d = points[i] - lods.center;
+        r2 = std::max(r2, dot(d, d));
+    }
+    lods.radius = sqrtf(r2);
+    vector<int3> level(triangles, triangles + nTriangles);
+    float error = 0;
+    while (lods.Levels() < maxLevels && (int) level.size() / 2 >= minTriangles) {
+        int before = (int) level.size();
+        // errors accumulate as levels are built from each other
+        error += SimplifyMesh(points, normals, nPoints, level, before / 2);
+        if ((int) level.size() > before - before / 10)
+            break;
+        vector<int3> ordered(level);
+        OptimizeVertexCache(ordered, nPoints);
+        lods.triangles.insert(lods.triangles.end(), ordered.begin(), ordered.end());
+        lods.counts.push_back((int) ordered.size());
+        lods.errors.push_back(error);
+    }
+}
+
+// radius in pixels of a sphere in model space, under modelview and persp,
+// for a viewport viewportHeight pixels high; large if the eye is inside
+inline float ProjectedRadius(const vec3 &center, float radius, const mat4 &modelview,
+                             const mat4 &persp, int viewportHeight) {
+    vec4 c = modelview * vec4(center, 1);
+    // largest axis scale of modelview
+    float scale = 0;
+    for (int j = 0; j < 3; j++) {
+        vec3 axis(modelview[0][j], modelview[1][j], modelview[2][j]);
+        scale = std::max(scale, length(axis));
+    }
+    float r = radius * scale, depth = -c.z;
+    if (depth <= r)
+        return 1e30f;
+    return r * persp[1][1] / depth * viewportHeight / 2;
+}
+
+#endif
@@ -0,0 +1,292 @@
+// Author: Nadezhda Chernova
+// File: MeshOptimize.h
+// Date: 10/16/2026
+// Reorder triangles for the post-transform vertex cache and for overdraw,
+// and vertices for fetch locality
+
+#ifndef MESH_OPTIMIZE_HDR
+#define MESH_OPTIMIZE_HDR
+
+#include "VecMat.h" // vec2, vec3, int3
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// ACMR: vertex shader invocations per triangle (.5 is ideal, 3 is worst)
+// ATVR: vertex shader invocations per referenced vertex (1 is ideal)
+struct VertexCacheStats {
+    float acmr = 0, atvr = 0;
+};
+
+// simulate a FIFO post-transform cache of cacheSize entries
+inline VertexCacheStats AnalyzeVertexCache(const int3 *triangles, int nTriangles, int nPoints,
+                                           int cacheSize = 16) {
+    VertexCacheStats s;
+    vector<int> stamp(nPoints, -cacheSize - 1); // when each vertex entered the cache
+    vector<char> used(nPoints, 0);
+    int misses = 0, nUsed = 0;
+    for (int t = 0; t < nTriangles; t++)
+        for (int k = 0; k < 3; k++) {
+            int v = triangles[t][k];
+            if (misses - stamp[v] > cacheSize)
+                stamp[v] = misses++;
+            if (!used[v]) {
+                used[v] = 1;
+                nUsed++;
+            }
+        }
+    s.acmr = nTriangles ? (float) misses / nTriangles : 0;
+    s.atvr = nUsed ? (float) misses / nUsed : 0;
+    return s;
+}
+
+// Forsyth's linear-speed vertex cache optimization: repeatedly emit the
+// triangle with the highest score, where vertices score for being recently
+// used (in an LRU cache model) and for having few triangles left
+inline void OptimizeVertexCache(vector<int3> &triangles, int nPoints, int cacheSize = 32) {
+    int nTriangles = (int) triangles.size();
+    if (!nTriangles)
+        return;
+    const float decayPower = 1.5f, lastTriangleScore = .75f;
+    const float valenceScale = 2, valencePower = .5f;
+    auto Score = [&](int cachePos, int valence) {
+        if (valence == 0)
+            return -1.f; // no triangles left
+        float s = 0;
+        if (cachePos >= 0)
+            s = cachePos < 3 ? lastTriangleScore // in the triangle just emitted
+                             : powf(1 - (float) (cachePos - 3) / (cacheSize - 3), decayPower);
+        return s + valenceScale * powf((float) valence, -valencePower);
+    };
+    // vertex to triangle adjacency; valence counts triangles not yet emitted
+    vector<int> valence(nPoints, 0), first(nPoints + 1, 0), adjacent(3 * (size_t) nTriangles);
+    for (int3 &t : triangles)
+        for (int k = 0; k < 3; k++)
+            valence[t[k]]++;
+    for (int v = 0; v < nPoints; v++)
+        first[v + 1] = first[v] + valence[v];
+    vector<int> fill(first.begin(), first.end() - 1);
+    for (int t = 0; t < nTriangles; t++)
+        for (int k = 0; k < 3; k++)
+            adjacent[fill[triangles[t][k]]++] = t;
+    vector<int> cachePos(nPoints, -1);
+    vector<float> vertexScore(nPoints), triangleScore(nTriangles, 0);
+    for (int v = 0; v < nPoints; v++)
+        vertexScore[v] = Score(-1, valence[v]);
+    for (int t = 0; t < nTriangles; t++)
+        for (int k = 0; k < 3; k++)
+            triangleScore[t] += vertexScore[triangles[t][k]];
+    vector<char> emitted(nTriangles, 0);
+    vector<int3> order;
+    order.reserve(nTriangles);
+    vector<int> cache, newCache;
+    int best = (int) (std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+    int cursor = 0; // lowest index that may not have been emitted
+    while ((int) order.size() < nTriangles) {
+        if (best < 0) {
+            // nothing adjacent to the cache: take the next triangle in order
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+        int3 t = triangles[best];
+        order.push_back(t);
+        emitted[best] = 1;
+        // remove triangle from its vertices' adjacency
+        for (int k = 0; k < 3; k++) {
+            int v = t[k];
+            int *a = &adjacent[first[v]], n = valence[v];
+            int *p = std::find(a, a + n, best);
+            if (p < a + n) {
+                *p = a[n - 1];
+                valence[v]--;
+            }
+        }
+        // move triangle's vertices to the front of the LRU cache; entries pushed
+        // past cacheSize drop out after their scores are updated
+        newCache.clear();
+        for (int k = 0; k < 3; k++)
+            if (std::find(newCache.begin(), newCache.end(), t[k]) == newCache.end())
+                newCache.push_back(t[k]);
+        for (int v : cache)
+            if (v != t[0] && v != t[1] && v != t[2])
+                newCache.push_back(v);
+        for (int i = 0; i < (int) newCache.size(); i++)
+            cachePos[newCache[i]] = i < cacheSize ? i : -1;
+        // rescore vertices in (or just evicted from) the cache, and their triangles
+        best = -1;
+        float bestScore = -1;
+        for (int v : newCache) {
+            float s = Score(cachePos[v], valence[v]), ds = s - vertexScore[v];
+            vertexScore[v] = s;
+            for (int i = first[v]; i < first[v] + valence[v]; i++)
+                triangleScore[adjacent[i]] += ds;
+        }
+        for (int v : newCache)
+            for (int i = first[v]; i < first[v] + valence[v]; i++) {
+                int a = adjacent[i];
+                if (triangleScore[a] > bestScore) {
+                    bestScore = triangleScore[a];
+                    best = a;
+                }
+            }
+        if ((int) newCache.size() > cacheSize)
+            newCache.resize(cacheSize);
+        cache.swap(newCache);
+    }
+    triangles.swap(order);
+}
+
+// overdraw-aware cluster order (after Sander, Nehab and Barczak): cut the
+// cache-ordered triangles into clusters where the cache would refill anyway
+// (or where a cluster's own ACMR stays within threshold of its parent's),
+// then draw outward-facing clusters first so they occlude the rest
+inline void OptimizeOverdraw(vector<int3> &triangles, const vec3 *points, int nPoints,
+                             float threshold = 1.05f, int cacheSize = 16) {
+    int nTriangles = (int) triangles.size();
+    if (nTriangles < 2)
+        return;
+    // hard boundaries: triangles with three cache misses
+    vector<int> hard(1, 0);
+    {
+        vector<int> stamp(nPoints, -cacheSize - 1);
+        int misses = 0;
+        for (int t = 0; t < nTriangles; t++) {
+            int m = 0;
+            for (int k = 0; k < 3; k++) {
+                int v = triangles[t][k];
+                if (misses - stamp[v] > cacheSize) {
+                    stamp[v] = misses++;
+                    m++;
+                }
+            }
+            if (m == 3 && t > 0)
+                hard.push_back(t);
+        }
+        hard.push_back(nTriangles);
+    }
+    // soft boundaries within each hard cluster
+    vector<int> starts;
+    vector<int> stamp(nPoints, -cacheSize - 1);
+    int clock = 0;
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        int begin = hard[h], end = hard[h + 1];
+        float clusterAcmr = AnalyzeVertexCache(&triangles[begin], end - begin, nPoints, cacheSize).acmr;
+        starts.push_back(begin);
+        int subStart = begin, subMisses = 0;
+        clock += cacheSize + 1; // flush cache
+        for (int t = begin; t < end; t++) {
+            for (int k = 0; k < 3; k++) {
+                int v = triangles[t][k];
+                if (clock - stamp[v] > cacheSize) {
+                    stamp[v] = clock++;
+                    subMisses++;
+                }
+            }
+            int n = t - subStart + 1;
+            if (t + 1 < end && n >= 8 && subMisses <= threshold * clusterAcmr * n) {
+                starts.push_back(t + 1);
+                subStart = t + 1;
+                subMisses = 0;
+                clock += cacheSize + 1;
+            }
+        }
+    }
+    starts.push_back(nTriangles);
+    // sort key: how far a cluster faces out from the mesh centroid
+    auto Area = [&](const int3 &t, vec3 &centroid) {
+        const vec3 &a = points[t[0]], &b = points[t[1]], &c = points[t[2]];
+        centroid = (a + b + c) / 3;
+        return cross(b - a, c - a);
+    };
+    vec3 meshCentroid(0, 0, 0);
+    float meshArea = 0;
+    for (int3 &t : triangles) {
+        vec3 c, n = Area(t, c);
+        float a = length(n);
+        meshCentroid += c * a;
+        meshArea += a;
+    }
+    if (meshArea > 0)
+        meshCentroid /= meshArea;
+    int nClusters = (int) starts.size() - 1;
+    vector<std::pair<float, int>> keys(nClusters);
+    for (int i = 0; i < nClusters; i++) {
+        vec3 centroid(0, 0, 0), normal(0, 0, 0);
+        float area = 0;
+        for (int t = starts[i]; t < starts[i + 1]; t++) {
+            vec3 c, n = Area(triangles[t], c);
+            float a = length(n);
+            centroid += c * a;
+            normal += n;
+            area += a;
+        }
+        if (area > 0)
+            centroid /= area;
+        float len = length(normal);
+        keys[i] = std::make_pair(len > 0 ? -dot(centroid - meshCentroid, normal / len) : 0, i);
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const std::pair<float, int> &a, const std::pair<float, int> &b) {
+                         return a.first < b.first;
+                     });
+    vector<int3> order;
+    order.reserve(nTriangles);
+    for (auto &k : keys)
+        order.insert(order.end(), triangles.begin() + starts[k.second],
+                     triangles.begin() + starts[k.second + 1]);
+    triangles.swap(order);
+}
+
+// renumber vertices in order of first use, so the vertex fetch reads memory
+// nearly sequentially; unreferenced vertices go last; normals and uvs, if
+// not empty, are permuted with points
+inline void OptimizeVertexFetch(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs,
+                                vector<int3> &triangles) {
+    int nPoints = (int) points.size(), next = 0;
+    vector<int> remap(nPoints, -1);
+    for (int3 &t : triangles)
+        for (int k = 0; k < 3; k++) {
+            int &v = t[k];
+            if (remap[v] < 0)
+                remap[v] = next++;
+            v = remap[v];
+        }
+    for (int &r : remap)
+        if (r < 0)
+            r = next++;
+    auto Permute = [&remap](auto &a) {
+        if (a.size() != remap.size())
+            return;
+        auto b = a;
+        for (size_t i = 0; i < remap.size(); i++)
+            a[remap[i]] = b[i];
+    };
+    Permute(points);
+    Permute(normals);
+    Permute(uvs);
+}
+
+// all three, in order; returns cache statistics before and after. Triangles
+// already in a better order for the cache than OptimizeVertexCache gives (as
+// for a regular grid) keep their order; the overdraw pass then runs on
+// whichever order won, and is undone if it leaves the ACMR worse than the
+// input's
+inline void OptimizeMesh(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs,
+                         vector<int3> &triangles, VertexCacheStats &before,
+                         VertexCacheStats &after) {
+    int nPoints = (int) points.size();
+    before = AnalyzeVertexCache(triangles.data(), (int) triangles.size(), nPoints);
+    vector<int3> reordered(triangles);
+    OptimizeVertexCache(reordered, nPoints);
+    if (AnalyzeVertexCache(reordered.data(), (int) reordered.size(), nPoints).acmr < before.acmr)
+        triangles.swap(reordered);
+    reordered = triangles;
+    OptimizeOverdraw(triangles, points.data(), nPoints);
+    if (AnalyzeVertexCache(triangles.data(), (int) triangles.size(), nPoints).acmr > before.acmr)
+        triangles.swap(reordered);
+    OptimizeVertexFetch(points, normals, uvs, triangles);
+    after = AnalyzeVertexCache(triangles.data(), (int) triangles.size(), nPoints);
+}
+
+#endif
@@ -0,0 +1,221 @@
+// Author: Nadezhda Chernova
+// File: MeshStream.h
+// Date: 10/16/2026
+// Out-of-core mesh loading: upload a cached mesh to the GPU a chunk at a time;
+// only the upload is bounded in memory, the first run builds the cache with
+// LoadCachedMesh, which holds the whole mesh
+
+#ifndef MESH_STREAM_HDR
+#define MESH_STREAM_HDR
+
+#include "glad.h"
+#include "MeshCache.h" // MeshCacheHeader, MeshCacheMatches, LoadCachedMesh
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// 64-bit file positions (long, as fseek takes, is 32 bits on Windows)
+inline bool Seek64(FILE *file, uint64_t offset, int origin = SEEK_SET) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64) offset, origin) == 0;
+#else
+    return fseeko(file, (off_t) offset, origin) == 0;
+#endif
+}
+
+inline uint64_t Tell64(FILE *file) {
+#ifdef _WIN32
+    return (uint64_t) _ftelli64(file);
+#else
+    return (uint64_t) ftello(file);
+#endif
+}
+
+// GPU buffers are sized for the whole mesh when opened, then each Step reads
+// one chunk of vertices and one of triangles from the cache file and appends
+// them with glBufferSubData; CPU memory is one chunk, whatever the mesh size.
+// A cache that can't be read in full stops the stream, with failed set
+class MeshStream {
+public:
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    int nPoints = 0, nTriangles = 0;         // whole mesh
+    int nPointsLoaded = 0, nTrianglesLoaded = 0;
+    int nDrawable = 0;                       // leading triangles with all vertices loaded
+    size_t normalsOffset = 0, uvsOffset = 0, tangentsOffset = 0; // in VBO, as in CachedMesh
+    bool hasNormals = false, hasUvs = false, hasTangents = false;
+    bool failed = false;                     // a read came up short
+    VertexCacheStats cacheBefore, cacheAfter;
+
+    bool Done() const { return nPointsLoaded == nPoints && nTrianglesLoaded == nTriangles; }
+
+    // open cache file, allocate GPU buffers; false if cache is missing or stale
+    bool Open(const char *cacheFilename, const MeshLoadOptions &opts, uint64_t sourceSize,
+              int64_t sourceTime, size_t chunkSize = 1 << 20) {
+        Close();
+        file = fopen(cacheFilename, "rb");
+        if (!file)
+            return false;
+        uint64_t fileSize = Seek64(file, 0, SEEK_END) ? Tell64(file) : 0;
+        if (!Seek64(file, 0) || fread(&header, sizeof(header), 1, file) != 1 ||
+            !MeshCacheMatches(header, opts, sourceSize, sourceTime, fileSize)) {
+            Close();
+            return false;
+        }
+        nPoints = header.nPoints;
+        nTriangles = header.nTriangles;
+        normalsOffset = header.normalsOffset - header.pointsOffset;
+        uvsOffset = header.uvsOffset - header.pointsOffset;
+        tangentsOffset = header.tangentsOffset - header.pointsOffset;
+        hasNormals = header.nNormals > 0;
+        hasUvs = header.nUvs > 0;
+        hasTangents = header.nTangents > 0;
+        cacheBefore.acmr = header.acmrBefore;
+        cacheBefore.atvr = header.atvrBefore;
+        cacheAfter.acmr = header.acmrAfter;
+        cacheAfter.atvr = header.atvrAfter;
+        // a chunk holds whole vertices (all attributes) or whole triangles
+        size_t vertexSize = sizeof(vec3) + (header.nNormals ? sizeof(vec3) : 0) +
+                            (header.nUvs ? sizeof(vec2) : 0) + (header.nTangents ? sizeof(vec4) : 0);
+        chunkPoints = (int) std::max<size_t>(1, chunkSize / vertexSize);
+        chunkTriangles = (int) std::max<size_t>(1, chunkSize / sizeof(int3));
+        buffer.resize(std::max(chunkPoints * vertexSize, chunkTriangles * sizeof(int3)));
+        // allocate full-size buffers, to be filled by Step
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, header.trianglesOffset - header.pointsOffset,
+                     NULL, GL_STATIC_DRAW);
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t) nTriangles * sizeof(int3),
+                     NULL, GL_STATIC_DRAW);
+        return true;
+    }
+
+    // upload next chunk of vertices and of triangles; false when done
+    bool Step() {
+        if (!file || Done() || failed)
+            return false;
+        glBindVertexArray(VAO);
+        if (nPointsLoaded < nPoints) {
+            int n = std::min(chunkPoints, nPoints - nPointsLoaded);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            // each attribute is a separate run in the file and the VBO
+            bool ok = Upload(GL_ARRAY_BUFFER, header.pointsOffset, 0, nPointsLoaded, n,
+                             sizeof(vec3));
+            if (ok && header.nNormals)
+                ok = Upload(GL_ARRAY_BUFFER, header.normalsOffset, normalsOffset, nPointsLoaded,
+                            n, sizeof(vec3));
+            if (ok && header.nUvs)
+                ok = Upload(GL_ARRAY_BUFFER, header.uvsOffset, uvsOffset, nPointsLoaded, n,
+                            sizeof(vec2));
+            if (ok && header.nTangents)
+                ok = Upload(GL_ARRAY_BUFFER, header.tangentsOffset, tangentsOffset, nPointsLoaded,
+                            n, sizeof(vec4));
+            if (!ok)
+                return Fail();
+            nPointsLoaded += n;
+        }
+        if (nTrianglesLoaded < nTriangles) {
+            int n = std::min(chunkTriangles, nTriangles - nTrianglesLoaded);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            if (!Upload(GL_ELEMENT_ARRAY_BUFFER, header.trianglesOffset, 0, nTrianglesLoaded, n,
+                        sizeof(int3)))
+                return Fail();
+            // highest vertex index used so far, per chunk
+            int maxIndex = chunkMax.empty() ? -1 : chunkMax.back().second;
+            const int *ids = (const int *) buffer.data();
+            for (int i = 0; i < 3 * n; i++)
+                maxIndex = std::max(maxIndex, ids[i]);
+            nTrianglesLoaded += n;
+            chunkMax.push_back(std::make_pair(nTrianglesLoaded, maxIndex));
+        }
+        // triangles can be drawn once every vertex they refer to is loaded
+        while (drawableChunk < (int) chunkMax.size() &&
+               chunkMax[drawableChunk].second < nPointsLoaded)
+            nDrawable = chunkMax[drawableChunk++].first;
+        if (Done())
+            CloseFile();
+        return !Done();
+    }
+
+    // close the file and free the GPU buffers while the GL context is current
+    void Close() {
+        CloseFile();
+        if (VBO) glDeleteBuffers(1, &VBO);
+        if (EBO) glDeleteBuffers(1, &EBO);
+        if (VAO) glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = 0;
+        nPoints = nTriangles = nPointsLoaded = nTrianglesLoaded = nDrawable = 0;
+        failed = false;
+        chunkMax.clear();
+        drawableChunk = 0;
+    }
+
+    MeshStream() {}
+    MeshStream(const MeshStream &) = delete;
+    MeshStream &operator=(const MeshStream &) = delete;
+    ~MeshStream() { CloseFile(); }
+
+private:
+    FILE *file = NULL;
+    MeshCacheHeader header;
+    int chunkPoints = 0, chunkTriangles = 0;
+    vector<char> buffer;                    // one chunk
+    vector<std::pair<int, int>> chunkMax;   // triangles loaded, highest index so far
+    int drawableChunk = 0;
+
+    // read n elements of given size, starting at element first, from the run
+    // at fileOffset, and copy them to the run at gpuOffset in target buffer;
+    // false if the file ends early or can't be read
+    bool Upload(GLenum target, uint64_t fileOffset, size_t gpuOffset, int first, int n,
+                size_t size) {
+        if (!Seek64(file, fileOffset + (uint64_t) first * size) ||
+            fread(buffer.data(), size, n, file) != (size_t) n)
+            return false;
+        glBufferSubData(target, gpuOffset + (size_t) first * size, n * size, buffer.data());
+        return true;
+    }
+
+    bool Fail() {
+        printf("can't read mesh cache: short read after %d of %d vertices, %d of %d triangles\n",
+               nPointsLoaded, nPoints, nTrianglesLoaded, nTriangles);
+        failed = true;
+        CloseFile();
+        return false;
+    }
+
+    void CloseFile() {
+        if (file)
+            fclose(file);
+        file = NULL;
+        buffer = vector<char>();
+    }
+};
+
+// open stream for objFilename's cache; build the cache first if need be (this
+// first run parses the whole OBJ in memory, as LoadCachedMesh does; later
+// runs stream)
+inline bool StreamCachedMesh(const char *objFilename, MeshStream &stream,
+                             MeshLoadOptions opts = MeshLoadOptions(),
+                             size_t chunkSize = 1 << 20) {
+    uint64_t size = 0;
+    int64_t time = 0;
+    string cacheName = MeshCacheName(objFilename, opts);
+    if (!FileStamp(objFilename, size, time))
+        return false;
+    if (!stream.Open(cacheName.c_str(), opts, size, time, chunkSize)) {
+        {
+            CachedMesh mesh;
+            if (!LoadCachedMesh(objFilename, mesh, opts, false))
+                return false;
+        }
+        if (!stream.Open(cacheName.c_str(), opts, size, time, chunkSize))
+            return false;
+    }
+    PrintVertexCacheStats(objFilename, stream.cacheBefore, stream.cacheAfter);
+    return true;
+}
+
+#endif
@@ -0,0 +1,185 @@
+// Author: Nadezhda Chernova
+// File: NormalMap.h
+// Date: 10/16/2026
+// Bump and height images converted once to two-channel tangent-space normal
+// maps, mipmapped, block compressed and cached on disk
+
+#ifndef NORMAL_MAP_HDR
+#define NORMAL_MAP_HDR
+
+#include "glad.h"
+#include "VecMat.h"        // vec3
+#include "ImageFile.h"     // Image, DecodeImage
+#include "BlockCompress.h" // CompressBC5
+#include "TextureFile.h"   // TextureFile, TextureLevels, TextureKey, WriteTextureFile
+#include "Parallel.h"      // ParallelFor
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+// what an image's texels hold
+enum class BumpSource {
+    Vectors, // a bump vector: x and y as 2c-1 of red and green, z as blue
+    Height   // a height, the gray level; normals from its slope
+};
+
+// processing applied before a normal map is cached; part of the cache key
+struct NormalMapOptions {
+    BumpSource source = BumpSource::Vectors;
+    float strength = 1;    // Vectors: x and y scaled; Height: slope scaled (height 1 per texel)
+    bool compress = true;  // BC5, 1 byte per texel; else RG8, 2 bytes
+};
+
+inline std::string NormalMapOptionString(const NormalMapOptions &opts) {
+    char s[100];
+    snprintf(s, sizeof(s), "normal map %d %g %d", (int) opts.source, opts.strength,
+             (int) opts.compress);
+    return s;
+}
+
+// <filename>.<hash of opts>.nmap, so that loads with different options (as
+// with and without -rg8) keep a cache each
+inline std::string NormalMapCacheName(const char *filename, const NormalMapOptions &opts) {
+    std::string options = NormalMapOptionString(opts);
+    char s[32];
+    snprintf(s, sizeof(s), ".%08x.nmap", (unsigned) HashBytes(options.data(), options.size()));
+    return std::string(filename) + s;
+}
+
+// unit normals of the image's texels, rows in parallel; height differences
+// are by Sobel filter, wrapping at the edges as the texture repeats
+inline void ImageNormals(const Image &image, const NormalMapOptions &opts, vector<vec3> &normals) {
+    int w = image.width, h = image.height;
+    const unsigned char *p = image.pixels.data();
+    normals.resize((size_t) w * h);
+    auto Height = [p, w, h](int x, int y) {
+        const unsigned char *t = p + 4 * ((size_t) ((y + h) % h) * w + (x + w) % w);
+        return (.299f * t[0] + .587f * t[1] + .114f * t[2]) / 255;
+    };
+    ParallelFor(h, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++)
+            for (int x = 0; x < w; x++) {
+                vec3 n;
+                if (opts.source == BumpSource::Vectors) {
+                    const unsigned char *t = p + 4 * ((size_t) y * w + x);
+                    float s = opts.strength;
+                    n = vec3(s * (2 * t[0] / 255.f - 1), s * (2 * t[1] / 255.f - 1), t[2] / 255.f);
+                }
+                else {
+                    float dx = (Height(x + 1, y - 1) + 2 * Height(x + 1, y) + Height(x + 1, y + 1) -
+                                Height(x - 1, y - 1) - 2 * Height(x - 1, y) - Height(x - 1, y + 1)) / 8;
+                    float dy = (Height(x - 1, y + 1) + 2 * Height(x, y + 1) + Height(x + 1, y + 1) -
+                                Height(x - 1, y - 1) - 2 * Height(x, y - 1) - Height(x + 1, y - 1)) / 8;
+                    n = vec3(-opts.strength * dx, -opts.strength * dy, 1);
+                }
+                float len = length(n);
+                normals[(size_t) y * w + x] = len > 0 ? n * (1 / len) : vec3(0, 0, 1);
+            }
+    });
+}
+
+// the next mip level of w x h unit normals: each the renormalized average
+// of the normals it covers (two by two, three along an odd side), not of
+// their encodings, so that filtering doesn't bias them toward z
+inline void DownsampleNormals(const vector<vec3> &src, int w, int h, vector<vec3> &dst,
+                              int &dw, int &dh) {
+    dw = w > 1 ? w / 2 : 1;
+    dh = h > 1 ? h / 2 : 1;
+    dst.resize((size_t) dw * dh);
+    int nw = dw, nh = dh;
+    ParallelFor(dh, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            int y0 = y * h / nh, y1 = ((y + 1) * h + nh - 1) / nh;
+            for (int x = 0; x < nw; x++) {
+                int x0 = x * w / nw, x1 = ((x + 1) * w + nw - 1) / nw;
+                vec3 sum(0, 0, 0);
+                for (int sy = y0; sy < y1; sy++)
+                    for (int sx = x0; sx < x1; sx++)
+                        sum = sum + src[(size_t) sy * w + sx];
+                float len = length(sum);
+                dst[(size_t) y * nw + x] = len > 0 ? sum * (1 / len) : vec3(0, 0, 1);
+            }
+        }
+    });
+}
+
+// x and y of unit normals, [-1, 1] to [0, 255]; the shader rebuilds z:
+//     vec2 xy = 2*texture(normalMap, uv).rg-1;
+//     vec3 n = vec3(xy, sqrt(max(0, 1-dot(xy, xy))));
+inline void EncodeNormalsRG8(const vector<vec3> &normals, vector<uint8_t> &rg) {
+    rg.resize(2 * normals.size());
+    for (size_t i = 0; i < normals.size(); i++)
+        for (int k = 0; k < 2; k++) {
+            float c = .5f * normals[i][k] + .5f;
+            rg[2 * i + k] = (uint8_t) lroundf(255 * (c < 0 ? 0 : c > 1 ? 1 : c));
+        }
+}
+
+// decode filename and build its normal map: every level, as RG8 or BC5
+inline bool BuildNormalMap(const char *filename, const NormalMapOptions &opts, TextureLevels &t) {
+    Image image;
+    if (!DecodeImage(filename, image) || !image.width || !image.height)
+        return false;
+    t.format = opts.compress ? GL_COMPRESSED_RG_RGTC2 : GL_RG8;
+    t.width = image.width;
+    t.height = image.height;
+    int nLevels = MipLevels(t.width, t.height);
+    t.levels.resize(nLevels);
+    vector<vec3> normals, next;
+    ImageNormals(image, opts, normals);
+    int w = t.width, h = t.height;
+    vector<uint8_t> rg;
+    for (int i = 0; i < nLevels; i++) {
+        if (i) {
+            int nw = 0, nh = 0;
+            DownsampleNormals(normals, w, h, next, nw, nh);
+            normals.swap(next);
+            w = nw;
+            h = nh;
+        }
+        EncodeNormalsRG8(normals, rg);
+        if (opts.compress)
+            CompressBC5(rg.data(), w, h, t.levels[i]);
+        else
+            t.levels[i] = rg;
+    }
+    return true;
+}
+
+// map the cached normal map for filename; on first load (or if the image or
+// options changed) build it and write the cache; if report, print its size
+// against that of the image as RGBA8 with mipmaps
+inline bool LoadNormalMap(const char *filename, const NormalMapOptions &opts, TextureFile &file,
+                          bool report = true) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    uint64_t key = 0;
+    if (!TextureKey(filename, NormalMapOptionString(opts).c_str(), key))
+        return false;
+    std::string cacheName = NormalMapCacheName(filename, opts);
+    bool built = false;
+    if (!file.Map(cacheName.c_str(), key)) {
+        TextureLevels t;
+        if (!BuildNormalMap(filename, opts, t))
+            return false;
+        built = true;
+        if (!WriteTextureFile(cacheName.c_str(), key, t) || !file.Map(cacheName.c_str(), key)) {
+            printf("can't write %s, using uncached normal map\n", cacheName.c_str());
+            file.Adopt(t);
+        }
+    }
+    if (report) {
+        const char *name = strrchr(filename, '/');
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        size_t rgba = (size_t) file.width * file.height * 4 * 4 / 3;
+        printf("%s: %dx%d normal map, %d levels, %s %.2f MB (RGBA8 %.2f MB), %s in %.1f ms\n",
+               name ? name + 1 : filename, file.width, file.height, file.nLevels,
+               file.format == GL_RG8 ? "RG8" : "BC5", file.Bytes() / (1024. * 1024.),
+               rgba / (1024. * 1024.), built ? "built" : "mapped", ms);
+    }
+    return true;
+}
+
+#endif
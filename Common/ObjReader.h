@@ -0,0 +1,272 @@
+// Author: Nadezhda Chernova
+// File: ObjReader.h
+// Date: 10/16/2026
+// Multithreaded OBJ reader, a drop-in alternative to ReadAsciiObj
+
+#ifndef OBJ_READER_HDR
+#define OBJ_READER_HDR
+
+#include "VecMat.h"     // vec2, vec3, int3
+#include "MappedFile.h" // MappedFile
+#include "Parallel.h"   // ParallelFor
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+// a face corner refers to a point, a texture coordinate and a normal;
+// OBJ indices count from 1, negative indices count back from the last
+// record read; a corner is stored 0-based, or, for a negative index,
+// relative to its chunk and less objRelative, so the merge can rebase it
+const int objRelative = 1 << 30, objMissing = INT_MIN;
+
+struct ObjCorner {
+    int v, t, n;
+};
+
+// records parsed from one newline-aligned piece of the file
+struct ObjChunk {
+    vector<vec3> points, normals;
+    vector<vec2> uvs;
+    vector<ObjCorner> corners; // triangle fans, three corners per triangle
+};
+
+// fast decimal parsers; advance s past the number
+inline int ObjParseInt(const char *&s) {
+    bool neg = *s == '-';
+    if (*s == '-' || *s == '+')
+        s++;
+    int i = 0;
+    while (*s >= '0' && *s <= '9')
+        i = 10 * i + (*s++ - '0');
+    return neg ? -i : i;
+}
+
+inline float ObjParseFloat(const char *&s) {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                   1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                   1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    bool neg = *s == '-';
+    if (*s == '-' || *s == '+')
+        s++;
+    uint64_t mantissa = 0;
+    int exponent = 0, nDigits = 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+        if (nDigits < 19) {
+            mantissa = 10 * mantissa + (*s - '0');
+            nDigits += mantissa > 0;
+        }
+        else
+            exponent++; // digits beyond double precision
+    if (*s == '.')
+        for (s++; *s >= '0' && *s <= '9'; s++)
+            if (nDigits < 19) {
+                mantissa = 10 * mantissa + (*s - '0');
+                nDigits += mantissa > 0;
+                exponent--;
+            }
+    if (*s == 'e' || *s == 'E') {
+        const char *e = s + 1;
+        if ((*e >= '0' && *e <= '9') || ((*e == '-' || *e == '+') && e[1] >= '0' && e[1] <= '9')) {
+            s = e;
+            exponent += ObjParseInt(s);
+        }
+    }
+    double d = (double) mantissa;
+    if (exponent < 0)
+        d = exponent >= -22 ? d / pow10[-exponent] : d * pow(10., exponent);
+    else if (exponent > 0)
+        d = exponent <= 22 ? d * pow10[exponent] : d * pow(10., exponent);
+    return (float) (neg ? -d : d);
+}
+
+inline bool ObjBlank(char c) { return c == ' ' || c == '\t'; }
+
+// parse the lines in [s, end); end is just past a newline or the file end
+inline void ParseObjChunk(const char *s, const char *end, ObjChunk &c) {
+    // resolve a 1-based or negative index against count records so far
+    auto Index = [](int i, size_t count) {
+        return i > 0 ? i - 1 : i < 0 ? (int) count + i - objRelative : objMissing;
+    };
+    // lines never run past end, because end follows a newline or is the file end;
+    // copy the final line if the file doesn't end with a newline
+    string tail;
+    const char *last = end;
+    if (end > s && end[-1] != '\n') {
+        while (last > s && last[-1] != '\n')
+            last--;
+        tail.assign(last, end);
+        end = last;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            if (tail.empty())
+                break;
+            s = tail.c_str();
+            end = s + tail.size();
+        }
+        while (s < end) {
+            while (s < end && ObjBlank(*s))
+                s++;
+            if (s >= end)
+                break;
+            if (s[0] == 'v' && ObjBlank(s[1])) {
+                s++;
+                vec3 p;
+                for (int k = 0; k < 3; k++) {
+                    while (ObjBlank(*s)) s++;
+                    p[k] = ObjParseFloat(s);
+                }
+                c.points.push_back(p);
+            }
+            else if (s[0] == 'v' && s[1] == 't' && ObjBlank(s[2])) {
+                s += 2;
+                vec2 t;
+                for (int k = 0; k < 2; k++) {
+                    while (ObjBlank(*s)) s++;
+                    t[k] = ObjParseFloat(s);
+                }
+                c.uvs.push_back(t);
+            }
+            else if (s[0] == 'v' && s[1] == 'n' && ObjBlank(s[2])) {
+                s += 2;
+                vec3 n;
+                for (int k = 0; k < 3; k++) {
+                    while (ObjBlank(*s)) s++;
+                    n[k] = ObjParseFloat(s);
+                }
+                c.normals.push_back(n);
+            }
+            else if (s[0] == 'f' && ObjBlank(s[1])) {
+                s++;
+                // triangulate polygon as a fan about its first corner
+                ObjCorner first, prev;
+                int nCorners = 0;
+                for (;;) {
+                    while (ObjBlank(*s)) s++;
+                    if (!((*s >= '0' && *s <= '9') || *s == '-'))
+                        break;
+                    ObjCorner k = {Index(ObjParseInt(s), c.points.size()), objMissing, objMissing};
+                    if (*s == '/') {
+                        s++;
+                        if (*s != '/')
+                            k.t = Index(ObjParseInt(s), c.uvs.size());
+                        if (*s == '/') {
+                            s++;
+                            k.n = Index(ObjParseInt(s), c.normals.size());
+                        }
+                    }
+                    if (nCorners == 0)
+                        first = k;
+                    if (nCorners >= 2) {
+                        c.corners.push_back(first);
+                        c.corners.push_back(prev);
+                        c.corners.push_back(k);
+                    }
+                    prev = k;
+                    nCorners++;
+                }
+            }
+            // skip rest of line (comments, groups, materials, ...)
+            while (s < end && *s != '\n')
+                s++;
+            s++;
+        }
+    }
+}
+
+// read OBJ file with nThreads threads (0: one per core); like ReadAsciiObj,
+// polygons are triangulated and normals and uvs are stored per point, so
+// points, normals and uvs are parallel arrays
+inline bool ReadAsciiObjParallel(const char *filename, vector<vec3> &points,
+                                 vector<int3> &triangles, vector<vec3> *normals = NULL,
+                                 vector<vec2> *uvs = NULL, int nThreads = 0) {
+    MappedFile file;
+    points.clear();
+    triangles.clear();
+    if (normals) normals->clear();
+    if (uvs) uvs->clear();
+    if (!file.Open(filename))
+        return false;
+    // at least a megabyte per chunk
+    size_t minChunk = 1 << 20;
+    int nChunks = (int) std::min<size_t>(ThreadCount(nThreads), file.size / minChunk + 1);
+    // newline-aligned chunk boundaries
+    vector<const char *> bounds(nChunks + 1);
+    const char *begin = file.data, *end = file.data + file.size;
+    bounds[0] = begin;
+    bounds[nChunks] = end;
+    for (int i = 1; i < nChunks; i++) {
+        const char *s = begin + file.size * i / nChunks;
+        s = std::max(s, bounds[i - 1]);
+        while (s < end && *s != '\n')
+            s++;
+        bounds[i] = s < end ? s + 1 : end;
+    }
+    // run Task(i) for i in [0, nChunks), one thread per chunk
+    auto Parallel = [nChunks](auto Task) {
+        ParallelFor(nChunks, [&Task](int i, int, int) { Task(i); }, nChunks);
+    };
+    // parse chunks concurrently
+    vector<ObjChunk> chunks(nChunks);
+    Parallel([&](int i) { ParseObjChunk(bounds[i], bounds[i + 1], chunks[i]); });
+    // prefix sums give each chunk's first global point, uv, normal, triangle
+    struct Base { size_t v, t, n, tri; };
+    vector<Base> bases(nChunks + 1, Base{0, 0, 0, 0});
+    for (int i = 0; i < nChunks; i++) {
+        bases[i + 1].v = bases[i].v + chunks[i].points.size();
+        bases[i + 1].t = bases[i].t + chunks[i].uvs.size();
+        bases[i + 1].n = bases[i].n + chunks[i].normals.size();
+        bases[i + 1].tri = bases[i].tri + chunks[i].corners.size() / 3;
+    }
+    Base total = bases[nChunks];
+    bool getUvs = uvs && total.t, getNormals = normals && total.n;
+    points.resize(total.v);
+    triangles.resize(total.tri);
+    vector<vec2> allUvs(getUvs ? total.t : 0);
+    vector<vec3> allNormals(getNormals ? total.n : 0);
+    // merge records and remap corners to global indices
+    vector<char> chunkValid(nChunks, 1);
+    Parallel([&](int i) {
+        ObjChunk &c = chunks[i];
+        Base b = bases[i];
+        std::copy(c.points.begin(), c.points.end(), points.begin() + b.v);
+        if (getUvs) std::copy(c.uvs.begin(), c.uvs.end(), allUvs.begin() + b.t);
+        if (getNormals) std::copy(c.normals.begin(), c.normals.end(), allNormals.begin() + b.n);
+        auto Global = [](int i, size_t base, size_t count) {
+            if (i == objMissing)
+                return -1;
+            size_t g = i < 0 ? (size_t) ((int64_t) base + i + objRelative) : (size_t) i;
+            return g < count ? (int) g : -2;
+        };
+        int3 *tri = triangles.data() + b.tri;
+        for (size_t k = 0; k < c.corners.size(); k++) {
+            ObjCorner &o = c.corners[k];
+            o.v = Global(o.v, b.v, total.v);
+            o.t = Global(o.t, b.t, total.t);
+            o.n = Global(o.n, b.n, total.n);
+            if (o.v < 0 || o.t == -2 || o.n == -2)
+                chunkValid[i] = 0;
+            tri[k / 3][k % 3] = o.v;
+        }
+    });
+    if (std::count(chunkValid.begin(), chunkValid.end(), 0)) {
+        printf("%s: face refers to missing vertex\n", filename);
+        return false;
+    }
+    // store uvs and normals per point, in file order so the last corner wins
+    if (getUvs) uvs->resize(total.v);
+    if (getNormals) normals->resize(total.v);
+    if (getUvs || getNormals)
+        for (ObjChunk &c : chunks)
+            for (ObjCorner &o : c.corners) {
+                if (getUvs && o.t >= 0)
+                    (*uvs)[o.v] = allUvs[o.t];
+                if (getNormals && o.n >= 0)
+                    (*normals)[o.v] = allNormals[o.n];
+            }
+    return true;
+}
+
+#endif
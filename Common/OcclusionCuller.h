@@ -0,0 +1,354 @@
+// Author: Nadezhda Chernova
+// File: OcclusionCuller.h
+// Date: 10/16/2026
+// Software occlusion culling: the largest occluders rasterized at low
+// resolution on a worker thread, bounding boxes tested against their depth
+
+#ifndef OCCLUSION_CULLER_HDR
+#define OCCLUSION_CULLER_HDR
+
+#include "VecMat.h"     // vec3, vec4, mat4, int3
+#include "Simd.h"       // f4, LessMask
+#include "MeshLod.h"    // LodChain, ProjectedRadius
+#include "WorkerPool.h" // WorkerPool
+#include <math.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// a mesh's coarsest level of detail, kept on the CPU to rasterize as an
+// occluder; shrunk inside the full mesh so that it hides only what the mesh
+// would (see MakeOccluder)
+class OccluderMesh {
+public:
+    vector<vec3> points;
+    vector<int3> triangles;
+};
+
+// from the coarsest level of lods whose error is at most maxError of the
+// bounding radius (before its triangles are dropped). The level's triangles
+// span removed vertices and may pass outside the full mesh by up to that
+// error, so each point moves inward that far: along its normal (if given),
+// else toward the bounding sphere's center; points are then clamped to the
+// bounding box
+inline std::shared_ptr<OccluderMesh> MakeOccluder(const vec3 *points, const vec3 *normals,
+                                                  const LodChain &lods, float maxError = .1f) {
+    std::shared_ptr<OccluderMesh> o = std::make_shared<OccluderMesh>();
+    int first = 0, last = lods.Levels() - 1;
+    if (last < 0 || lods.triangles.empty())
+        return o;
+    // errors only grow from level to level
+    while (last > 0 && lods.errors[last] > maxError * lods.radius)
+        last--;
+    float inset = lods.errors[last];
+    for (int level = 0; level < last; level++)
+        first += lods.counts[level];
+    // only the points the level uses, renumbered
+    vector<int> map;
+    for (int t = first; t < first + lods.counts[last]; t++) {
+        int3 tri = lods.triangles[t];
+        for (int k = 0; k < 3; k++) {
+            int i = tri[k];
+            if (i >= (int) map.size())
+                map.resize(i + 1, -1);
+            if (map[i] < 0) {
+                map[i] = (int) o->points.size();
+                vec3 p = points[i], in = normals ? -normals[i] : lods.center - p;
+                float d = length(in);
+                if (d > 0)
+                    p += std::min(inset, normals ? inset : d) / d * in;
+                for (int j = 0; j < 3; j++)
+                    p[j] = std::min(lods.hi[j], std::max(lods.lo[j], p[j]));
+                o->points.push_back(p);
+            }
+            tri[k] = map[i];
+        }
+        o->triangles.push_back(tri);
+    }
+    return o;
+}
+
+// depth of the nearest occluders, as window z in [0, 1] (1: nothing), with
+// the farthest depth in each tile for a first, coarse test
+class DepthBuffer {
+public:
+    static const int tileSize = 8;
+    int width = 0, height = 0;          // multiples of tileSize
+    vector<float> depth, tileMax;
+
+    void Clear(int w, int h) {
+        width = std::max(tileSize, w / tileSize * tileSize);
+        height = std::max(tileSize, h / tileSize * tileSize);
+        depth.assign(width * height, 1.f);
+        tileMax.assign((width / tileSize) * (height / tileSize), 1.f);
+    }
+
+    // triangles wholly beyond the near plane, four pixels at a time;
+    // those reaching past it are skipped (an occluder need not be whole)
+    void Rasterize(const mat4 &mvp, const OccluderMesh &o) {
+        int n = (int) o.points.size();
+        screen.resize(n);
+        clipped.resize(n);
+        for (int i = 0; i < n; i++)
+            clipped[i] = !Project(mvp, o.points[i], screen[i]);
+        static const float offsets[] = {.5f, 1.5f, 2.5f, 3.5f};
+        f4 laneX = f4::Load(offsets), zero(0);
+        for (const int3 &t : o.triangles) {
+            if (clipped[t[0]] || clipped[t[1]] || clipped[t[2]])
+                continue;
+            const vec3 &a = screen[t[0]], &b = screen[t[1]], &c = screen[t[2]];
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (fabsf(area) < 1e-8f)
+                continue;
+            int x0 = std::max(0, (int) floorf(std::min(a.x, std::min(b.x, c.x)))) & ~3;
+            int x1 = std::min(width - 1, (int) ceilf(std::max(a.x, std::max(b.x, c.x))));
+            int y0 = std::max(0, (int) floorf(std::min(a.y, std::min(b.y, c.y))));
+            int y1 = std::min(height - 1, (int) ceilf(std::max(a.y, std::max(b.y, c.y))));
+            if (x0 > x1 || y0 > y1)
+                continue;
+            // barycentric weights of a, b, c, each linear in x and y
+            float s = 1 / area;
+            vec3 wa((b.y - c.y) * s, (c.x - b.x) * s, (b.x * c.y - c.x * b.y) * s);
+            vec3 wb((c.y - a.y) * s, (a.x - c.x) * s, (c.x * a.y - a.x * c.y) * s);
+            vec3 wc((a.y - b.y) * s, (b.x - a.x) * s, (a.x * b.y - b.x * a.y) * s);
+            for (int y = y0; y <= y1; y++) {
+                float py = y + .5f;
+                for (int x = x0; x <= x1; x += 4) {
+                    f4 px = f4((float) x) + laneX;
+                    f4 ea = f4(wa.x) * px + f4(wa.y * py + wa.z);
+                    f4 eb = f4(wb.x) * px + f4(wb.y * py + wb.z);
+                    f4 ec = f4(wc.x) * px + f4(wc.y * py + wc.z);
+                    int outside = LessMask(ea, zero) | LessMask(eb, zero) | LessMask(ec, zero);
+                    if (outside == 0xf)
+                        continue;
+                    float z[4], *row = &depth[y * width + x];
+                    (f4(a.z) * ea + f4(b.z) * eb + f4(c.z) * ec).Store(z);
+                    for (int l = 0; l < 4 && x + l < width; l++)
+                        if (!(outside & (1 << l)))
+                            row[l] = std::min(row[l], z[l]);
+                }
+            }
+        }
+    }
+
+    // farthest depth per tile, once all occluders are drawn
+    void BuildTiles() {
+        int tilesX = width / tileSize;
+        for (int ty = 0; ty < height / tileSize; ty++)
+            for (int tx = 0; tx < tilesX; tx++) {
+                f4 farthest(0);
+                for (int y = ty * tileSize; y < (ty + 1) * tileSize; y++)
+                    for (int x = tx * tileSize; x < (tx + 1) * tileSize; x += 4)
+                        farthest = Max(farthest, f4::Load(&depth[y * width + x]));
+                float z[4];
+                farthest.Store(z);
+                tileMax[ty * tilesX + tx] = std::max(std::max(z[0], z[1]), std::max(z[2], z[3]));
+            }
+    }
+
+    // true if the box (lo, hi) under mvp is wholly behind occluders; false
+    // if it reaches past the near plane or off the buffer
+    bool Occluded(const mat4 &mvp, const vec3 &lo, const vec3 &hi) const {
+        float xmin = 1e30f, xmax = -1e30f, ymin = 1e30f, ymax = -1e30f, zmin = 1;
+        for (int i = 0; i < 8; i++) {
+            vec3 s, p(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+            if (!Project(mvp, p, s))
+                return false;
+            xmin = std::min(xmin, s.x), xmax = std::max(xmax, s.x);
+            ymin = std::min(ymin, s.y), ymax = std::max(ymax, s.y);
+            zmin = std::min(zmin, s.z);
+        }
+        int x0 = (int) floorf(xmin), x1 = (int) ceilf(xmax), y0 = (int) floorf(ymin), y1 = (int) ceilf(ymax);
+        if (x0 < 0 || y0 < 0 || x1 >= width || y1 >= height)
+            return false;
+        f4 boxNear(zmin);
+        int tilesX = width / tileSize;
+        for (int ty = y0 / tileSize; ty <= y1 / tileSize; ty++)
+            for (int tx = x0 / tileSize; tx <= x1 / tileSize; tx++) {
+                if (tileMax[ty * tilesX + tx] < zmin)
+                    continue; // the whole tile is nearer
+                // pixels of the tile within the box's rectangle
+                int ya = std::max(y0, ty * tileSize), yb = std::min(y1, (ty + 1) * tileSize - 1);
+                int xa = std::max(x0, tx * tileSize), xb = std::min(x1, (tx + 1) * tileSize - 1);
+                for (int y = ya; y <= yb; y++)
+                    for (int x = xa & ~3; x <= xb; x += 4) {
+                        int nearer = LessMask(f4::Load(&depth[y * width + x]), boxNear), lanes = 0;
+                        for (int l = 0; l < 4; l++)
+                            if (x + l >= xa && x + l <= xb)
+                                lanes |= 1 << l;
+                        if ((nearer & lanes) != lanes)
+                            return false; // a pixel with nothing nearer than the box
+                    }
+            }
+        return true;
+    }
+
+private:
+    vector<vec3> screen;
+    vector<char> clipped;
+
+    // p under mvp to pixel x, y and window z; false if not beyond the near plane
+    bool Project(const mat4 &mvp, const vec3 &p, vec3 &s) const {
+        vec4 c = mvp * vec4(p, 1);
+        if (c.w <= 0 || c.z < -c.w)
+            return false;
+        float w = 1 / c.w;
+        s = vec3((c.x * w * .5f + .5f) * width, (c.y * w * .5f + .5f) * height, c.z * w * .5f + .5f);
+        return true;
+    }
+};
+
+// each frame, the app adds its meshes (modelview, bounds, occluder, any
+// instance transforms) and submits them; a worker thread rasterizes the
+// largest occluders and tests every draw's box while the GL thread renders.
+// The next frame's draws use those results, so a mesh coming into view from
+// behind an occluder shows a frame late
+class OcclusionCuller {
+public:
+    int maxOccluders = 16;              // rasterized per frame, largest on screen
+    float minOccluderPixels = 16;       // projected radius of the smallest
+    int bufferWidth = 256;              // depth buffer width, height per aspect
+
+    // wait for the job submitted last frame, keep its results and start
+    // gathering this frame's draws
+    void Begin() {
+        Wait();
+        results.swap(job.occluded);
+        lastCounts.swap(job.counts);
+        gather.groups.clear();
+        gather.counts.clear();
+        gather.nDraws = 0;
+        stale = false;
+    }
+
+    // a mesh drawn once (instances NULL) or once per instance transform (each
+    // applied before modelview); occluder NULL if it hides nothing; returns
+    // the index of its first draw, for Occluded
+    int Add(const mat4 &modelview, const LodChain &bounds, std::shared_ptr<const OccluderMesh> occluder,
+            std::shared_ptr<const vector<mat4>> instances = NULL) {
+        Group g;
+        g.modelview = modelview;
+        g.lo = bounds.lo, g.hi = bounds.hi;
+        g.center = bounds.center, g.radius = bounds.radius;
+        g.occluder = occluder;
+        g.instances = instances;
+        g.first = gather.nDraws;
+        int count = instances ? (int) instances->size() : 1;
+        // last frame's results hold only if the draws line up
+        int k = (int) gather.counts.size();
+        if (k >= (int) lastCounts.size() || lastCounts[k] != count)
+            stale = true;
+        gather.groups.push_back(g);
+        gather.counts.push_back(count);
+        gather.nDraws += count;
+        return g.first;
+    }
+
+    // true if draw i (first + instance) was hidden last frame
+    bool Occluded(int i) const { return !stale && i >= 0 && i < (int) results.size() && results[i]; }
+
+    // hand the frame's draws to the worker, for a viewport w x h
+    void Submit(const mat4 &persp, int w, int h) {
+        Wait();
+        gather.persp = persp;
+        gather.viewportHeight = h;
+        gather.bufferHeight = w > 0 ? bufferWidth * h / w : bufferWidth;
+        std::swap(job, gather);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = true;
+        }
+        Pool().Run([this]() {
+            Run(job);
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = false;
+            done.notify_all();
+        });
+    }
+
+    // until the worker has finished the last frame submitted
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return !busy; });
+    }
+
+    OcclusionCuller() {}
+    ~OcclusionCuller() { Wait(); }
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+private:
+    struct Group {
+        mat4 modelview;
+        vec3 lo, hi, center;
+        float radius = 0;
+        std::shared_ptr<const OccluderMesh> occluder;
+        std::shared_ptr<const vector<mat4>> instances;
+        int first = 0;
+    };
+    struct Frame {
+        vector<Group> groups;
+        vector<int> counts;             // draws per group
+        int nDraws = 0;
+        mat4 persp;
+        int viewportHeight = 0, bufferHeight = 0;
+        vector<char> occluded;          // per draw, written by the worker
+    };
+    Frame gather, job;                  // this frame's draws; those the worker has
+    vector<char> results;               // from the frame before
+    vector<int> lastCounts;
+    bool stale = false;
+    DepthBuffer buffer;
+    std::mutex mutex;
+    std::condition_variable done;
+    bool busy = false;
+    std::unique_ptr<WorkerPool> pool;   // one thread, started on first use
+
+    WorkerPool &Pool() {
+        if (!pool)
+            pool.reset(new WorkerPool(1));
+        return *pool;
+    }
+
+    // on the worker: draw occluders, test every draw
+    void Run(Frame &f) {
+        buffer.Clear(bufferWidth, f.bufferHeight);
+        // occluders by radius on screen, the largest first
+        struct Candidate {
+            float pixels;
+            const Group *g;
+            mat4 modelview;
+        };
+        vector<Candidate> candidates;
+        for (const Group &g : f.groups) {
+            if (!g.occluder || g.occluder->triangles.empty())
+                continue;
+            int n = g.instances ? (int) g.instances->size() : 1;
+            for (int i = 0; i < n; i++) {
+                mat4 m = g.instances ? g.modelview * (*g.instances)[i] : g.modelview;
+                float r = ProjectedRadius(g.center, g.radius, m, f.persp, f.viewportHeight);
+                // the eye inside the bounds: not a useful occluder
+                if (r >= minOccluderPixels && r < 1e29f)
+                    candidates.push_back({r, &g, m});
+            }
+        }
+        int nOccluders = std::min(maxOccluders, (int) candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + nOccluders, candidates.end(),
+                          [](const Candidate &a, const Candidate &b) { return a.pixels > b.pixels; });
+        for (int i = 0; i < nOccluders; i++)
+            buffer.Rasterize(f.persp * candidates[i].modelview, *candidates[i].g->occluder);
+        buffer.BuildTiles();
+        // every draw's box against the nearest depths
+        f.occluded.assign(f.nDraws, 0);
+        for (const Group &g : f.groups) {
+            int n = g.instances ? (int) g.instances->size() : 1;
+            mat4 m = f.persp * g.modelview;
+            for (int i = 0; i < n; i++)
+                f.occluded[g.first + i] = buffer.Occluded(g.instances ? m * (*g.instances)[i] : m, g.lo, g.hi);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,47 @@
+// Author: Nadezhda Chernova
+// File: Parallel.h
+// Date: 10/16/2026
+// Split a loop over threads
+
+#ifndef PARALLEL_HDR
+#define PARALLEL_HDR
+
+#include <stdint.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// cap on the default thread count for loops started on this thread, 0 for
+// none; worker pools set it so that loops their tasks run don't each start
+// a thread per core
+inline int &ThreadLimit() {
+    static thread_local int limit = 0;
+    return limit;
+}
+
+// nThreads if positive, else one per core (at most this thread's ThreadLimit)
+inline int ThreadCount(int nThreads = 0) {
+    if (nThreads > 0)
+        return nThreads;
+    int n = (int) std::thread::hardware_concurrency(), limit = ThreadLimit();
+    n = n > 0 ? n : 1;
+    return limit > 0 && limit < n ? limit : n;
+}
+
+// call Task(thread, begin, end) over nThreads contiguous ranges covering [0, n);
+// the calling thread runs range 0; returns once all ranges are done
+template <typename F>
+void ParallelFor(int n, F Task, int nThreads = 0) {
+    nThreads = std::max(1, std::min(ThreadCount(nThreads), n));
+    auto Range = [n, nThreads, &Task](int t) {
+        Task(t, (int) ((int64_t) n * t / nThreads), (int) ((int64_t) n * (t + 1) / nThreads));
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < nThreads; t++)
+        threads.emplace_back(Range, t);
+    Range(0);
+    for (std::thread &t : threads)
+        t.join();
+}
+
+#endif
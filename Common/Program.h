@@ -0,0 +1,211 @@
+// Author: Nadezhda Chernova
+// File: Program.h
+// Date: 10/16/2026
+// Shader program with uniforms and attributes reflected at link time, set
+// per frame through pre-resolved handles instead of by name
+
+#ifndef PROGRAM_HDR
+#define PROGRAM_HDR
+
+#include "glad.h"
+#include "VecMat.h"  // vec2, vec3, vec4, mat4
+#include "GLXtras.h" // LinkProgramViaCode
+#include "GLState.h" // Binds
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// glUniform per C++ type; mat4 is row-major, as SetUniform sends it
+inline void UniformAt(GLint l, int n, const int *v) { glUniform1iv(l, n, v); }
+inline void UniformAt(GLint l, int n, const float *v) { glUniform1fv(l, n, v); }
+inline void UniformAt(GLint l, int n, const vec2 *v) { glUniform2fv(l, n, (const float *) v); }
+inline void UniformAt(GLint l, int n, const vec3 *v) { glUniform3fv(l, n, (const float *) v); }
+inline void UniformAt(GLint l, int n, const vec4 *v) { glUniform4fv(l, n, (const float *) v); }
+inline void UniformAt(GLint l, int n, const mat4 *m) { glUniformMatrix4fv(l, n, GL_TRUE, (const float *) m); }
+
+// whether a uniform of GL type may be set as T
+inline bool UniformType(GLenum type, const int *) {
+    switch (type) {
+        case GL_INT: case GL_BOOL: case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+    }
+    return false;
+}
+inline bool UniformType(GLenum type, const float *) { return type == GL_FLOAT; }
+inline bool UniformType(GLenum type, const vec2 *) { return type == GL_FLOAT_VEC2; }
+inline bool UniformType(GLenum type, const vec3 *) { return type == GL_FLOAT_VEC3; }
+inline bool UniformType(GLenum type, const vec4 *) { return type == GL_FLOAT_VEC4; }
+inline bool UniformType(GLenum type, const mat4 *) { return type == GL_FLOAT_MAT4; }
+
+// a uniform of the program in use, located at link time; setting one the
+// program doesn't use (location -1) does nothing
+template <typename T>
+class Uniform {
+public:
+    GLint location = -1;
+    int count = 0; // array length, 1 if not an array
+
+    void Set(const T &v) const {
+        if (location >= 0)
+            UniformAt(location, 1, &v);
+    }
+
+    // first n elements of an array, at most count
+    void Set(const T *v, int n) const {
+        if (location >= 0 && n > 0)
+            UniformAt(location, n < count ? n : count, v);
+    }
+
+    // points transformed by m, as SetUniform3v does (for vec3 only); on
+    // the stack, as called every frame, unless the array is unusually long
+    void Set(const T *points, int n, const mat4 &m) const {
+        n = n < count ? n : count;
+        if (location < 0 || n <= 0)
+            return;
+        T stack[64];
+        std::vector<T> heap(n > 64 ? n : 0);
+        T *xpoints = n > 64 ? heap.data() : stack;
+        for (int i = 0; i < n; i++) {
+            vec4 x = m * vec4(points[i], 1);
+            xpoints[i] = T(x.x, x.y, x.z);
+        }
+        Set(xpoints, n);
+    }
+};
+
+// a vertex shader input located at link time; as VertexAttribPointer,
+// without the lookup
+class Attribute {
+public:
+    GLint location = -1;
+
+    // point at the bound GL_ARRAY_BUFFER; nothing if the program doesn't use it
+    void Pointer(GLint size, GLsizei stride, const void *offset, GLenum type = GL_FLOAT,
+                 bool normalized = false) const {
+        if (location < 0)
+            return;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, size, type, normalized ? GL_TRUE : GL_FALSE, stride, offset);
+    }
+};
+
+// a linked program and what reflection found in it: every active uniform
+// and attribute, by name; Uniform and Attribute handles are looked up here
+// once, after linking, so drawing needs neither names nor glGet*Location
+class Program {
+public:
+    GLuint id = 0;
+
+    bool Link(const char **vertexCode, const char **pixelCode) {
+        id = LinkProgramViaCode(vertexCode, pixelCode);
+        Reflect();
+        return id != 0;
+    }
+
+    // with tessellation and geometry stages, any of which may be NULL
+    bool Link(const char **vertexCode, const char **tessControlCode, const char **tessEvalCode,
+              const char **geometryCode, const char **pixelCode) {
+        id = LinkProgramViaCode(vertexCode, tessControlCode, tessEvalCode, geometryCode, pixelCode);
+        Reflect();
+        return id != 0;
+    }
+
+    void Use() const { Binds().UseProgram(id); }
+
+    // handle to uniform name ("lights", not "lights[0]", for an array); the
+    // handle is unset, with a warning, if the types disagree
+    template <typename T>
+    Uniform<T> GetUniform(const char *name) const {
+        Uniform<T> u;
+        auto i = uniforms.find(name);
+        if (i == uniforms.end())
+            return u; // inactive, or not declared
+        if (!UniformType(i->second.type, (const T *) NULL)) {
+            printf("uniform %s: type 0x%x doesn't match the handle\n", name, i->second.type);
+            return u;
+        }
+        u.location = i->second.location;
+        u.count = i->second.size;
+        return u;
+    }
+
+    Attribute GetAttribute(const char *name) const {
+        Attribute a;
+        auto i = attributes.find(name);
+        if (i != attributes.end())
+            a.location = i->second.location;
+        return a;
+    }
+
+    // location of attribute name, -1 if inactive
+    GLint AttributeLocation(const char *name) const { return GetAttribute(name).location; }
+
+    // attach uniform block name to a buffer binding point (for GLSL before
+    // 4.20, which can't say so in the shader); false if there is no such block
+    bool BlockBinding(const char *name, GLuint binding) const {
+        GLuint index = id ? glGetUniformBlockIndex(id, name) : GL_INVALID_INDEX;
+        if (index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(id, index, binding);
+        return true;
+    }
+
+    void Print() const {
+        printf("program %u:\n", id);
+        for (auto &u : uniforms)
+            printf("  uniform %-16s location %2d type 0x%04x size %d\n", u.first.c_str(),
+                   u.second.location, u.second.type, u.second.size);
+        for (auto &a : attributes)
+            printf("  attribute %-14s location %2d type 0x%04x\n", a.first.c_str(),
+                   a.second.location, a.second.type);
+    }
+
+private:
+    struct Active {
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+    std::map<string, Active> uniforms, attributes;
+
+    void Reflect() {
+        uniforms.clear();
+        attributes.clear();
+        if (!id)
+            return;
+        GLint n = 0, maxLength = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &n);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        string name(maxLength + 1, 0);
+        for (GLint i = 0; i < n; i++) {
+            Active a;
+            GLsizei length = 0;
+            glGetActiveUniform(id, i, (GLsizei) name.size(), &length, &a.size, &a.type, &name[0]);
+            string s(name.c_str(), length);
+            // arrays are reported as their first element
+            if (s.size() > 3 && !s.compare(s.size() - 3, 3, "[0]"))
+                s.resize(s.size() - 3);
+            a.location = glGetUniformLocation(id, s.c_str());
+            if (a.location >= 0) // members of uniform blocks have none
+                uniforms[s] = a;
+        }
+        glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &n);
+        glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        name.assign(maxLength + 1, 0);
+        for (GLint i = 0; i < n; i++) {
+            Active a;
+            GLsizei length = 0;
+            glGetActiveAttrib(id, i, (GLsizei) name.size(), &length, &a.size, &a.type, &name[0]);
+            string s(name.c_str(), length);
+            a.location = glGetAttribLocation(id, s.c_str());
+            if (a.location >= 0) // built-ins such as gl_VertexID have none
+                attributes[s] = a;
+        }
+    }
+};
+
+#endif
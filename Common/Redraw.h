@@ -0,0 +1,87 @@
+// Author: Nadezhda Chernova
+// File: Redraw.h
+// Date: 10/16/2026
+// Redraw on demand: the event loop draws only when input, a drag or an
+// animation has marked the frame dirty, and otherwise blocks for events
+
+#ifndef REDRAW_HDR
+#define REDRAW_HDR
+
+#include "glfw3.h"
+#include "Args.h" // FlagArg
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+// an event loop:
+//     while (!glfwWindowShouldClose(w)) {
+//         Redraw().Wait(busy);
+//         if (Redraw().Due(busy)) {
+//             Display();
+//             glfwSwapBuffers(w);
+//         }
+//     }
+// where busy is true while something changes by itself (an animation, a
+// stream, assets loading) and callbacks that change the view call Dirty
+class RedrawDemand {
+public:
+    bool onDemand = true;   // false: draw every iteration
+    int trailing = 0;       // frames drawn after the last change, for effects a frame behind
+
+    // the next iteration draws
+    void Dirty() { dirty = true; }
+
+    // also when the window system asks (exposed, restored, resized)
+    void Attach(GLFWwindow *w) {
+        glfwSetWindowRefreshCallback(w, [](GLFWwindow *) { Instance().Dirty(); });
+    }
+
+    // take events, blocking until one comes if nothing is due
+    void Wait(bool busy = false) {
+        if (!onDemand || busy || dirty || left > 0) {
+            glfwPollEvents();
+            return;
+        }
+        Clock::time_point start = Clock::now();
+        glfwWaitEvents();
+        waitSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // true if this iteration should draw
+    bool Due(bool busy = false) {
+        nIterations++;
+        if (!onDemand || busy || dirty)
+            left = trailing + 1;
+        dirty = false;
+        if (left <= 0)
+            return false;
+        left--;
+        nFrames++;
+        return true;
+    }
+
+    void Report() const {
+        printf("redraw: %ld frames in %ld iterations, %.1f s waiting for events\n", nFrames,
+               nIterations, waitSeconds);
+    }
+
+    static RedrawDemand &Instance() {
+        static RedrawDemand r;
+        return r;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    bool dirty = true;      // the first frame
+    int left = 0;
+    long nFrames = 0, nIterations = 0;
+    double waitSeconds = 0;
+};
+
+// the app's redraw state
+inline RedrawDemand &Redraw() { return RedrawDemand::Instance(); }
+
+// -continuous among command-line arguments: draw every iteration
+inline bool ContinuousArg(int ac, char **av) { return FlagArg(ac, av, "-continuous"); }
+
+#endif
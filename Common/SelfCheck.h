@@ -0,0 +1,507 @@
+// Author: Nadezhda Chernova
+// File: SelfCheck.h
+// Date: 10/16/2026
+// Round-trip checks of what the apps cache and compute, run from their -bench
+// modes
+
+#ifndef SELF_CHECK_HDR
+#define SELF_CHECK_HDR
+
+#include "VecMat.h"         // vec2, vec3, vec4, int3
+#include "IO.h"             // ReadAsciiObj, SetVertexNormals
+#include "ObjReader.h"      // ReadAsciiObjParallel
+#include "MeshCache.h"      // LoadCachedMesh, ReadAndProcessObj, MeshCacheName
+#include "MeshOptimize.h"   // OptimizeMesh, VertexCacheStats
+#include "VertexNormals.h"  // SetVertexNormalsParallel, NormalWeight
+#include "VertexLayout.h"   // PackVertices, OctEncode, OctDecode, FloatToHalf, HalfToFloat
+#include "IndexBuffer.h"    // IndexBuffer, Meshlet
+#include "MeshLod.h"        // BuildLodChain, LodChain
+#include "BlockCompress.h"  // EncodeBC4, EncodeBC1, CompressBC5, DecodeBC4, DecodeBC1
+#include "Frustum.h"        // Frustum, SphereSoA, CullSpheres, SphereBvh
+#include "VertexTangents.h" // SetVertexTangentsParallel
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+inline bool CheckResult(const char *name, bool ok, const char *detail = "") {
+    printf("  %-20s %s%s%s\n", name, ok ? "ok" : "FAILED", *detail ? ": " : "", detail);
+    return ok;
+}
+
+// map the cache for objFilename (built if missing; the app's own, so left in
+// place) and compare with a fresh parse; then map a copy cut short by a
+// triangle, which must be refused
+inline bool CheckMeshCache(const char *objFilename, MeshLoadOptions opts = MeshLoadOptions()) {
+    vector<vec3> points, normals;
+    vector<vec2> uvs;
+    vector<vec4> tangents;
+    vector<int3> triangles;
+    if (!ReadAndProcessObj(objFilename, opts, points, normals, uvs, tangents, triangles))
+        return CheckResult("mesh cache", false, "can't read OBJ");
+    std::string cacheName = MeshCacheName(objFilename, opts);
+    CachedMesh written, mapped;
+    if (!LoadCachedMesh(objFilename, written, opts, false))
+        return CheckResult("mesh cache", false, "can't build cache");
+    written.Release();
+    uint64_t size = 0;
+    int64_t time = 0;
+    FileStamp(objFilename, size, time);
+    if (!mapped.Map(cacheName.c_str(), opts, size, time))
+        return CheckResult("mesh cache", false, "can't map cache");
+    auto Same = [](const void *a, const void *b, size_t n) {
+        return n == 0 || (a && b && !memcmp(a, b, n));
+    };
+    bool ok = mapped.nPoints == (int) points.size() && mapped.nTriangles == (int) triangles.size() &&
+              Same(mapped.points, points.data(), points.size() * sizeof(vec3)) &&
+              Same(mapped.normals, normals.data(), normals.size() * sizeof(vec3)) &&
+              Same(mapped.uvs, uvs.data(), uvs.size() * sizeof(vec2)) &&
+              Same(mapped.tangents, tangents.data(), tangents.size() * sizeof(vec4)) &&
+              Same(mapped.triangles, triangles.data(), triangles.size() * sizeof(int3));
+    if (!CheckResult("mesh cache", ok, ok ? "" : "mapped arrays differ from the OBJ's"))
+        return false;
+    // truncated copy
+    std::string cutName = cacheName + ".cut";
+    FILE *in = fopen(cacheName.c_str(), "rb"), *out = fopen(cutName.c_str(), "wb");
+    size_t keep = mapped.vertexSize + mapped.TrianglesSize() + sizeof(MeshCacheHeader) - sizeof(int3);
+    vector<char> bytes(keep);
+    bool copied = in && out && fread(bytes.data(), 1, keep, in) == keep &&
+                  fwrite(bytes.data(), 1, keep, out) == keep;
+    if (in) fclose(in);
+    if (out) fclose(out);
+    CachedMesh cut;
+    ok = copied && !cut.Map(cutName.c_str(), opts, size, time);
+    remove(cutName.c_str());
+    return CheckResult("truncated cache", ok, ok ? "" : "mapped anyway");
+}
+
+// parse objFilename with ReadAsciiObj and ReadAsciiObjParallel: the same
+// triangles, and points, normals and uvs equal to within float parsing
+inline bool CheckObjReader(const char *objFilename) {
+    vector<vec3> points, normals, points2, normals2;
+    vector<vec2> uvs, uvs2;
+    vector<int3> triangles, triangles2;
+    if (!ReadAsciiObj(objFilename, points, triangles, &normals, &uvs) ||
+        !ReadAsciiObjParallel(objFilename, points2, triangles2, &normals2, &uvs2))
+        return CheckResult("obj reader", false, "can't read OBJ");
+    bool same = points.size() == points2.size() && normals.size() == normals2.size() &&
+                uvs.size() == uvs2.size() && triangles.size() == triangles2.size();
+    for (size_t t = 0; t < triangles.size() && same; t++)
+        same = triangles[t][0] == triangles2[t][0] && triangles[t][1] == triangles2[t][1] &&
+             triangles[t][2] == triangles2[t][2];
+    // relative to the magnitude, as the readers may round the last digit apart
+    float worst = 0;
+    auto Err = [](float a, float b) { return fabsf(a - b) / std::max(1.f, fabsf(a)); };
+    for (size_t v = 0; v < points.size() && same; v++)
+        for (int k = 0; k < 3; k++) {
+            worst = std::max(worst, Err(points[v][k], points2[v][k]));
+            if (v < normals.size())
+                worst = std::max(worst, Err(normals[v][k], normals2[v][k]));
+            if (v < uvs.size() && k < 2)
+                worst = std::max(worst, Err(uvs[v][k], uvs2[v][k]));
+        }
+    bool ok = same && worst < 1e-6f;
+    char detail[100];
+    snprintf(detail, sizeof(detail), "%d points, %d triangles, worst error %g",
+             (int) points.size(), (int) triangles.size(), worst);
+    return CheckResult("obj reader", ok, same ? detail : "sizes or triangles differ");
+}
+
+// SIMD normals of objFilename's points against SetVertexNormals (uniform) and
+// against a scalar loop (area and angle weights)
+inline bool CheckNormals(const char *objFilename) {
+    vector<vec3> points, normals, normals2;
+    vector<int3> triangles;
+    if (!ReadAsciiObj(objFilename, points, triangles))
+        return CheckResult("vertex normals", false, "can't read OBJ");
+    auto Scalar = [&](NormalWeight weight) {
+        vector<vec3> sums(points.size(), vec3(0, 0, 0));
+        for (int3 &t : triangles) {
+            vec3 p[] = {points[t[0]], points[t[1]], points[t[2]]};
+            vec3 n = cross(p[1] - p[0], p[2] - p[1]);
+            if (weight != NormalWeight::Area)
+                n = n / std::max(length(n), 1e-30f);
+            for (int c = 0; c < 3; c++) {
+                float a = 1;
+                if (weight == NormalWeight::Angle) {
+                    vec3 e1 = normalize(p[(c + 1) % 3] - p[c]), e2 = normalize(p[(c + 2) % 3] - p[c]);
+                    a = acosf(std::max(-1.f, std::min(1.f, dot(e1, e2))));
+                }
+                sums[t[c]] += a * n;
+            }
+        }
+        for (vec3 &n : sums)
+            n = n / std::max(length(n), 1e-30f);
+        return sums;
+    };
+    const char *names[] = {"uniform", "area", "angle"};
+    NormalWeight weights[] = {NormalWeight::Uniform, NormalWeight::Area, NormalWeight::Angle};
+    bool ok = true;
+    std::string detail;
+    for (int w = 0; w < 3; w++) {
+        if (weights[w] == NormalWeight::Uniform)
+            SetVertexNormals(points, triangles, normals);
+        else
+            normals = Scalar(weights[w]);
+        SetVertexNormalsParallel(points, triangles, normals2, weights[w]);
+        bool same = normals.size() == normals2.size();
+        float worst = same ? 0 : 1;
+        for (size_t v = 0; v < normals.size() && same; v++)
+            worst = std::max(worst, length(normals[v] - normals2[v]));
+        ok = ok && worst < 1e-4f;
+        char buf[100];
+        snprintf(buf, sizeof(buf), "%s%s %g", w ? ", " : "worst error ", names[w], worst);
+        detail += buf;
+    }
+    return CheckResult("vertex normals", ok, detail.c_str());
+}
+
+// OptimizeMesh on objFilename: ACMR no worse than the OBJ's order, and the
+// same triangles (as winding-preserving position triples) drawn
+inline bool CheckOptimize(const char *objFilename) {
+    vector<vec3> points, normals;
+    vector<vec2> uvs;
+    vector<int3> triangles;
+    if (!ReadAsciiObj(objFilename, points, triangles, &normals, &uvs))
+        return CheckResult("mesh optimize", false, "can't read OBJ");
+    // each triangle's points, rotated to start at the least
+    typedef std::array<float, 9> Corners;
+    auto Triangles = [](const vector<vec3> &p, const vector<int3> &t) {
+        vector<Corners> all(t.size());
+        for (size_t i = 0; i < t.size(); i++) {
+            Corners c[3];
+            for (int r = 0; r < 3; r++)
+                for (int k = 0; k < 3; k++)
+                    for (int a = 0; a < 3; a++)
+                        c[r][3 * k + a] = p[t[i][(r + k) % 3]][a];
+            all[i] = std::min(c[0], std::min(c[1], c[2]));
+        }
+        std::sort(all.begin(), all.end());
+        return all;
+    };
+    vector<Corners> drawn = Triangles(points, triangles);
+    VertexCacheStats before, after;
+    OptimizeMesh(points, normals, uvs, triangles, before, after);
+    bool ok = after.acmr <= before.acmr && Triangles(points, triangles) == drawn;
+    char detail[100];
+    snprintf(detail, sizeof(detail), "ACMR %.3f -> %.3f", before.acmr, after.acmr);
+    return CheckResult("mesh optimize", ok, detail);
+}
+
+// every finite half through HalfToFloat and back unchanged; then vertices
+// spread over a sphere, packed Quantized and read back per the layout:
+// normals within a small angle, uvs within half precision, and points
+// within half a unorm16 step of the bounds
+inline bool CheckVertexFormats() {
+    int nHalfs = 0;
+    for (uint32_t h = 0; h < 0x10000; h++)
+        if ((h & 0x7c00) != 0x7c00 && FloatToHalf(HalfToFloat((uint16_t) h)) != h)
+            nHalfs++;
+    int n = 4096;
+    vector<vec3> points, normals;
+    vector<vec2> uvs;
+    for (int i = 0; i < n; i++) {
+        // Fibonacci sphere, so the octahedron's folds and poles are all hit
+        float z = 1 - (2 * i + 1.f) / n, r = sqrtf(1 - z * z), a = 2.39996323f * i;
+        vec3 d(r * cosf(a), r * sinf(a), z);
+        points.push_back(vec3(3 * d.x + 1, .5f * d.y - 2, 10 * d.z));
+        normals.push_back(d);
+        uvs.push_back(vec2(4 * (float) i / n, d.z));
+    }
+    vector<char> vertices;
+    VertexLayout l = PackVertices(points.data(), normals.data(), uvs.data(), n,
+                                  VertexFormat::Quantized, vertices);
+    size_t normalOffset = 0, uvOffset = 0;
+    for (const VertexAttrib &a : l.attribs) {
+        if (!strcmp(a.name, "normal")) normalOffset = a.offset;
+        if (!strcmp(a.name, "uv")) uvOffset = a.offset;
+    }
+    float angle = 0, uvError = 0, pointError = 0;
+    for (int i = 0; i < n; i++) {
+        const char *v = &vertices[i * l.vertexSize];
+        uint16_t q[3], h[2];
+        int16_t e[2];
+        memcpy(q, v, sizeof(q));
+        memcpy(e, v + normalOffset, sizeof(e));
+        memcpy(h, v + uvOffset, sizeof(h));
+        // the chord, as acosf is coarse near 1
+        angle = std::max(angle, length(OctDecode(e) - normals[i]));
+        for (int k = 0; k < 2; k++)
+            uvError = std::max(uvError, fabsf(HalfToFloat(h[k]) - uvs[i][k]) /
+                                            std::max(fabsf(uvs[i][k]), 1.f / 16384));
+        // in steps of the unorm16
+        for (int k = 0; k < 3; k++) {
+            float p = l.pointOffset[k] + l.pointScale[k] * q[k] / 65535;
+            pointError = std::max(pointError, fabsf(p - points[i][k]) / l.pointScale[k] * 65535);
+        }
+    }
+    // half: 11 significant bits; a unorm16 rounds to half a step, plus float slop
+    bool ok = !nHalfs && angle < 1e-4f && uvError <= 1.f / 2048 && pointError < .5f + 1e-2f;
+    char detail[150];
+    snprintf(detail, sizeof(detail), "%d halfs changed, normal %g rad, uv %g, point %g steps",
+             nHalfs, angle, uvError, pointError);
+    return CheckResult("vertex formats", ok, detail);
+}
+
+// meshlets of two levels over 200000 vertices, with triangles that stray
+// 40000 vertices back: meshlets tile each level in order, and every index
+// plus its meshlet's base vertex gives the triangle's vertex back; a
+// triangle spanning more than 65536 vertices falls back to 32 bits
+inline bool CheckMeshlets() {
+    int nPoints = 200000;
+    vector<int3> triangles;
+    vector<int> levelCounts;
+    for (int step = 1; step <= 4; step *= 4) {
+        size_t first = triangles.size();
+        for (int i = 40000; i + 2 * step < nPoints; i += step)
+            triangles.push_back(i % 97 ? int3(i, i + step, i + 2 * step) : int3(i, i + step, i - 40000));
+        levelCounts.push_back((int) (triangles.size() - first));
+    }
+    IndexBuffer buffer;
+    vector<uint16_t> indices;
+    bool ok = buffer.Split(triangles.data(), levelCounts, nPoints, indices) &&
+              buffer.type == GL_UNSIGNED_SHORT && indices.size() == 3 * triangles.size() &&
+              buffer.levelMeshlets.size() == levelCounts.size() + 1;
+    const int *ids = (const int *) triangles.data();
+    int wrong = 0;
+    for (int level = 0, first = 0; ok && level < buffer.Levels(); first += levelCounts[level++]) {
+        int next = 3 * first; // where the level's next meshlet must start
+        for (int m = buffer.levelMeshlets[level]; m < buffer.levelMeshlets[level + 1]; m++) {
+            const Meshlet &ml = buffer.meshlets[m];
+            ok = ok && ml.firstIndex == next && ml.nIndices > 0;
+            next = ml.firstIndex + ml.nIndices;
+            for (int i = ml.firstIndex; ok && i < next; i++)
+                if (indices[i] + ml.baseVertex != ids[i])
+                    wrong++;
+        }
+        ok = ok && next == 3 * (first + levelCounts[level]);
+    }
+    ok = ok && !wrong;
+    int nMeshlets = (int) buffer.meshlets.size();
+    // too wide for 16 bits
+    triangles.push_back(int3(0, 1, 70000));
+    levelCounts.back()++;
+    IndexBuffer wide;
+    ok = ok && !wide.Split(triangles.data(), levelCounts, nPoints, indices) &&
+         wide.type == GL_UNSIGNED_INT && (int) wide.meshlets.size() == wide.Levels();
+    char detail[100];
+    snprintf(detail, sizeof(detail), "%d meshlets, %d indices wrong", nMeshlets, wrong);
+    return CheckResult("meshlets", ok, detail);
+}
+
+// levels of detail of a bumpy 64x64 grid: each level has fewer triangles
+// than the last, with an error no smaller, all in range of the points; and
+// Select never picks a coarser level for a larger projection
+inline bool CheckLods() {
+    int n = 64;
+    vector<vec3> points;
+    vector<int3> triangles;
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++) {
+            float x = (float) i / n, y = (float) j / n;
+            points.push_back(vec3(x, y, .05f * sinf(9 * x) * cosf(7 * y)));
+        }
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++) {
+            int a = j * (n + 1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+            triangles.push_back(int3(a, b, d));
+            triangles.push_back(int3(a, d, c));
+        }
+    LodChain lods;
+    BuildLodChain(points.data(), NULL, (int) points.size(), triangles.data(),
+                  (int) triangles.size(), lods);
+    int nPoints = (int) points.size(), total = 0;
+    bool ok = lods.Levels() > 1 && (int) lods.errors.size() == lods.Levels();
+    for (int l = 0; ok && l < lods.Levels(); l++) {
+        total += lods.counts[l];
+        if (l)
+            ok = lods.counts[l] < lods.counts[l - 1] && lods.errors[l] >= lods.errors[l - 1];
+    }
+    ok = ok && total == (int) lods.triangles.size();
+    for (size_t t = 0; ok && t < lods.triangles.size(); t++)
+        for (int k = 0; k < 3; k++)
+            ok = ok && lods.triangles[t][k] >= 0 && lods.triangles[t][k] < nPoints;
+    for (float r = 1; ok && r < 1e4f; r *= 2)
+        ok = lods.Select(2 * r) <= lods.Select(r);
+    std::string detail = "triangles";
+    for (int l = 0; l < lods.Levels(); l++) {
+        char buf[50];
+        snprintf(buf, sizeof(buf), " %d (%.2g)", lods.counts[l], lods.errors[l]);
+        detail += buf;
+    }
+    return CheckResult("levels of detail", ok, detail.c_str());
+}
+
+
+// encode and decode blocks of ramps, noise and two colors; maximum errors
+// must stay within what each format's steps allow
+inline bool CheckBlockCompression() {
+    srand(1);
+    int bc4Max = 0, bc1Max = 0, bc5Max = 0;
+    bool bc4Ok = true;
+    for (int b = 0; b < 256; b++) {
+        uint8_t v[16], block[8], d[16];
+        int lo = rand() % 256, hi = lo + rand() % (256 - lo);
+        for (int i = 0; i < 16; i++)
+            v[i] = (uint8_t) (b % 2 ? lo + (hi - lo) * i / 15 : lo + rand() % (hi - lo + 1));
+        EncodeBC4(v, block);
+        DecodeBC4(block, d);
+        int range = hi - lo, err = 0;
+        for (int i = 0; i < 16; i++)
+            err = std::max(err, abs(d[i] - v[i]));
+        // half a step of seven, plus rounding
+        bc4Ok = bc4Ok && err <= range / 14 + 2;
+        bc4Max = std::max(bc4Max, err);
+    }
+    bool bc1Ok = true;
+    for (int b = 0; b < 256; b++) {
+        uint8_t rgb[3][16], block[8], d[3][16];
+        // ramp between two colors, or two colors in a pattern
+        int c0[3], c1[3], span = 0;
+        for (int k = 0; k < 3; k++) {
+            c0[k] = rand() % 256;
+            c1[k] = rand() % 256;
+            span = std::max(span, abs(c1[k] - c0[k]));
+        }
+        for (int i = 0; i < 16; i++)
+            for (int k = 0; k < 3; k++)
+                rgb[k][i] = (uint8_t) (b % 2 ? c0[k] + (c1[k] - c0[k]) * i / 15 :
+                                       (i + i / 4) % 2 ? c0[k] : c1[k]);
+        EncodeBC1(rgb, block);
+        DecodeBC1(block, d);
+        int err = 0;
+        for (int i = 0; i < 16; i++)
+            for (int k = 0; k < 3; k++)
+                err = std::max(err, abs(d[k][i] - rgb[k][i]));
+        // two colors: 5:6:5 rounding alone; a ramp: half of one of the
+        // three steps between the endpoints more
+        int bound = b % 2 ? 8 + span / 6 : 8;
+        bc1Ok = bc1Ok && err <= bound;
+        bc1Max = std::max(bc1Max, err);
+    }
+    // BC5: a smooth two-channel image with an odd size
+    int w = 37, h = 21;
+    vector<uint8_t> rg(2 * w * h), bc5;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+            rg[2 * (y * w + x)] = (uint8_t) (x * 255 / (w - 1));
+            rg[2 * (y * w + x) + 1] = (uint8_t) (128 + 100 * sinf(y * .3f));
+        }
+    CompressBC5(rg.data(), w, h, bc5);
+    bool bc5Ok = bc5.size() == BlockLevelSize(w, h, 16);
+    for (int y = 0; y < h && bc5Ok; y++)
+        for (int x = 0; x < w; x++)
+            for (int c = 0; c < 2; c++) {
+                uint8_t d[16];
+                DecodeBC4(&bc5[16 * ((y / 4) * ((w + 3) / 4) + x / 4) + 8 * c], d);
+                bc5Max = std::max(bc5Max, abs(d[4 * (y % 4) + x % 4] - rg[2 * (y * w + x) + c]));
+            }
+    bc5Ok = bc5Ok && bc5Max <= 8;
+    char detail[100];
+    snprintf(detail, sizeof(detail), "max error %d", bc4Max);
+    bool ok = CheckResult("BC4", bc4Ok, detail);
+    snprintf(detail, sizeof(detail), "max error %d", bc1Max);
+    ok = CheckResult("BC1", bc1Ok, detail) && ok;
+    snprintf(detail, sizeof(detail), "max error %d", bc5Max);
+    return CheckResult("BC5", bc5Ok, detail) && ok;
+}
+
+// spheres and boxes known to be inside, outside or across a perspective
+// view; then the four-wide test, and the hierarchy, against the
+// one-at-a-time test
+inline bool CheckFrustum() {
+    Frustum f(Perspective(60, 1, 1, 100)); // looking down -z
+    bool ok = f.Sphere(vec3(0, 0, -10), 1) && !f.Sphere(vec3(0, 0, 10), 1) &&
+              !f.Sphere(vec3(100, 0, -10), 1) && !f.Sphere(vec3(0, 0, -200), 1) &&
+              f.Sphere(vec3(0, 0, -.5f), 1) && // across the near plane
+              f.Box(vec3(-1, -1, -11), vec3(1, 1, -9)) == Overlap::Inside &&
+              f.Box(vec3(-1, -1, -101), vec3(1, 1, -99)) == Overlap::Intersects &&
+              f.Box(vec3(-1, -1, 2), vec3(1, 1, 4)) == Overlap::Outside;
+    ok = CheckResult("frustum planes", ok);
+    srand(2);
+    SphereSoA spheres;
+    vector<vec3> centers;
+    vector<float> radii;
+    vector<int> scalar, wide, bvh;
+    for (int i = 0; i < 1001; i++) {
+        vec3 c((rand() % 200 - 100) * .5f, (rand() % 200 - 100) * .5f, -(rand() % 240) * .5f);
+        float r = (rand() % 40) * .1f;
+        spheres.Add(c, r);
+        centers.push_back(c);
+        radii.push_back(r);
+        if (f.Sphere(c, r))
+            scalar.push_back(i);
+    }
+    CullSpheres(f, spheres, 0, spheres.Size(), NULL, wide);
+    ok = CheckResult("four-wide culling", wide == scalar) && ok;
+    SphereBvh tree;
+    tree.Build(centers.data(), radii.data(), (int) centers.size());
+    tree.Cull(f, bvh);
+    std::sort(bvh.begin(), bvh.end());
+    return CheckResult("hierarchy culling", bvh == scalar) && ok;
+}
+
+// a grid whose right half is mapped mirrored in u: tangents unit, at right
+// angles to the normals, handedness -1 on the mirrored half, and the seam
+// vertices split
+inline bool CheckTangents() {
+    int n = 8;
+    vector<vec3> points, normals;
+    vector<vec2> uvs;
+    vector<int3> triangles;
+    vector<vec4> tangents;
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++) {
+            float x = (float) i / n, y = (float) j / n;
+            // a gentle bump, with normals not quite unit, as OBJs may have
+            points.push_back(vec3(x, y, .1f * sinf(3 * x) * cosf(2 * y)));
+            normals.push_back(1.5f * normalize(vec3(-.3f * cosf(3 * x) * cosf(2 * y),
+                                                    .2f * sinf(3 * x) * sinf(2 * y), 1)));
+            uvs.push_back(vec2(i <= n / 2 ? x : 1 - x, y));
+        }
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++) {
+            int a = j * (n + 1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+            triangles.push_back(int3(a, b, d));
+            triangles.push_back(int3(a, d, c));
+        }
+    int nSplit = SetVertexTangentsParallel(points, normals, uvs, triangles, tangents);
+    float worst = 0;
+    bool ok = nSplit == n + 1 && tangents.size() == points.size();
+    for (size_t v = 0; v < tangents.size() && ok; v++) {
+        vec3 t(tangents[v].x, tangents[v].y, tangents[v].z);
+        worst = std::max(worst, fabsf(dot(t, normalize(normals[v]))));
+        worst = std::max(worst, fabsf(length(t) - 1));
+        ok = fabsf(tangents[v].w) == 1;
+    }
+    // handedness of a vertex inside each half
+    ok = ok && tangents[n / 4].w == 1 && tangents[3 * n / 4].w == -1 && worst < 1e-4f;
+    char detail[100];
+    snprintf(detail, sizeof(detail), "%d split, worst error %g", nSplit, worst);
+    return CheckResult("tangent frames", ok, detail);
+}
+
+// all of the above (those of a mesh only if given an OBJ); false if any failed
+inline bool RunSelfChecks(const char *objFilename = NULL, MeshLoadOptions opts = MeshLoadOptions()) {
+    printf("self checks:\n");
+    bool ok = true;
+    if (objFilename) {
+        ok = CheckMeshCache(objFilename, opts) && ok;
+        ok = CheckObjReader(objFilename) && ok;
+        ok = CheckNormals(objFilename) && ok;
+        ok = CheckOptimize(objFilename) && ok;
+    }
+    ok = CheckVertexFormats() && ok;
+    ok = CheckMeshlets() && ok;
+    ok = CheckLods() && ok;
+    ok = CheckBlockCompression() && ok;
+    ok = CheckFrustum() && ok;
+    ok = CheckTangents() && ok;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,115 @@
+// Author: Nadezhda Chernova
+// File: Simd.h
+// Date: 10/16/2026
+// Four-wide float vector: SSE on x86, NEON on ARM, scalar otherwise
+
+#ifndef SIMD_HDR
+#define SIMD_HDR
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define SIMD_NEON 1
+#endif
+
+// operations are lane-wise, with IEEE results identical to scalar float math
+struct f4 {
+#if SIMD_SSE
+    __m128 v;
+    f4(__m128 v) : v(v) {}
+    f4(float s = 0) : v(_mm_set1_ps(s)) {}
+    static f4 Load(const float *p) { return _mm_loadu_ps(p); }
+    void Store(float *p) const { _mm_storeu_ps(p, v); }
+    f4 operator+(f4 b) const { return _mm_add_ps(v, b.v); }
+    f4 operator-(f4 b) const { return _mm_sub_ps(v, b.v); }
+    f4 operator*(f4 b) const { return _mm_mul_ps(v, b.v); }
+    f4 operator/(f4 b) const { return _mm_div_ps(v, b.v); }
+    friend f4 Sqrt(f4 a) { return _mm_sqrt_ps(a.v); }
+    friend f4 Min(f4 a, f4 b) { return _mm_min_ps(a.v, b.v); }
+    friend f4 Max(f4 a, f4 b) { return _mm_max_ps(a.v, b.v); }
+    // bit mask of lanes where a < b
+    friend int LessMask(f4 a, f4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+#elif SIMD_NEON
+    float32x4_t v;
+    f4(float32x4_t v) : v(v) {}
+    f4(float s = 0) : v(vdupq_n_f32(s)) {}
+    static f4 Load(const float *p) { return vld1q_f32(p); }
+    void Store(float *p) const { vst1q_f32(p, v); }
+    f4 operator+(f4 b) const { return vaddq_f32(v, b.v); }
+    f4 operator-(f4 b) const { return vsubq_f32(v, b.v); }
+    f4 operator*(f4 b) const { return vmulq_f32(v, b.v); }
+    friend f4 Min(f4 a, f4 b) { return vminq_f32(a.v, b.v); }
+    friend f4 Max(f4 a, f4 b) { return vmaxq_f32(a.v, b.v); }
+    #if defined(__aarch64__)
+    f4 operator/(f4 b) const { return vdivq_f32(v, b.v); }
+    friend f4 Sqrt(f4 a) { return vsqrtq_f32(a.v); }
+    #else
+    f4 operator/(f4 b) const { return Lanes([](float a, float b) { return a / b; }, b); }
+    friend f4 Sqrt(f4 a) { return a.Lanes([](float a, float) { return sqrtf(a); }, a); }
+    template <typename F> f4 Lanes(F op, f4 b) const {
+        float x[4], y[4];
+        Store(x);
+        b.Store(y);
+        for (int i = 0; i < 4; i++)
+            x[i] = op(x[i], y[i]);
+        return Load(x);
+    }
+    #endif
+    friend int LessMask(f4 a, f4 b) {
+        uint32x4_t m = vcltq_f32(a.v, b.v);
+        return (vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) |
+               (vgetq_lane_u32(m, 2) & 4) | (vgetq_lane_u32(m, 3) & 8);
+    }
+#else
+    float v[4];
+    f4(float s = 0) { v[0] = v[1] = v[2] = v[3] = s; }
+    static f4 Load(const float *p) { f4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+    void Store(float *p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+    template <typename F> f4 Lanes(F op, f4 b) const {
+        f4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = op(v[i], b.v[i]);
+        return r;
+    }
+    f4 operator+(f4 b) const { return Lanes([](float a, float b) { return a + b; }, b); }
+    f4 operator-(f4 b) const { return Lanes([](float a, float b) { return a - b; }, b); }
+    f4 operator*(f4 b) const { return Lanes([](float a, float b) { return a * b; }, b); }
+    f4 operator/(f4 b) const { return Lanes([](float a, float b) { return a / b; }, b); }
+    friend f4 Sqrt(f4 a) { return a.Lanes([](float a, float) { return sqrtf(a); }, a); }
+    friend f4 Min(f4 a, f4 b) { return a.Lanes([](float a, float b) { return a < b ? a : b; }, b); }
+    friend f4 Max(f4 a, f4 b) { return a.Lanes([](float a, float b) { return a > b ? a : b; }, b); }
+    friend int LessMask(f4 a, f4 b) {
+        int m = 0;
+        for (int i = 0; i < 4; i++)
+            m |= (a.v[i] < b.v[i]) << i;
+        return m;
+    }
+#endif
+};
+
+// three-component vectors, four at a time (structure of arrays)
+struct vec3x4 {
+    f4 x, y, z;
+    vec3x4(f4 x = 0, f4 y = 0, f4 z = 0) : x(x), y(y), z(z) {}
+    vec3x4 operator+(const vec3x4 &b) const { return vec3x4(x + b.x, y + b.y, z + b.z); }
+    vec3x4 operator-(const vec3x4 &b) const { return vec3x4(x - b.x, y - b.y, z - b.z); }
+    vec3x4 operator*(f4 s) const { return vec3x4(x * s, y * s, z * s); }
+    vec3x4 operator/(f4 s) const { return vec3x4(x / s, y / s, z / s); }
+};
+
+inline f4 Dot(const vec3x4 &a, const vec3x4 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline vec3x4 Cross(const vec3x4 &a, const vec3x4 &b) {
+    return vec3x4(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// unit length; zero vectors stay zero
+inline vec3x4 Normalize(const vec3x4 &a) {
+    return a / Max(Sqrt(Dot(a, a)), f4(1e-30f));
+}
+
+#endif
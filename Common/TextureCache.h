@@ -0,0 +1,240 @@
+// Author: Nadezhda Chernova
+// File: TextureCache.h
+// Date: 10/16/2026
+// Color textures decoded once, mipmapped and block compressed, then mapped
+// from a cache file and uploaded as they are on later runs
+
+#ifndef TEXTURE_CACHE_HDR
+#define TEXTURE_CACHE_HDR
+
+#include "glad.h"
+#include "GLState.h"       // HasExtension
+#include "IO.h"            // ReadTexture
+#include "ImageFile.h"     // Image, DecodeImage
+#include "BlockCompress.h" // CompressBC1, CompressBC3
+#include "TextureFile.h"   // TextureFile, TextureLevels, TextureKey, WriteTextureFile
+#include "Parallel.h"      // ParallelFor
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+// true if the GL samples S3TC (BC1, BC3); on the GL thread, once a context is current
+inline bool HaveS3tc() {
+    static int have = -1;
+    if (have < 0)
+        have = HasExtension("GL_EXT_texture_compression_s3tc") ||
+               HasExtension("GL_EXT_texture_compression_dxt1");
+    return have == 1;
+}
+
+// part of the cache key
+inline const char *TextureOptionString(bool compress) {
+    return compress ? "texture s3tc" : "texture rgba8";
+}
+
+inline std::string TextureCacheName(const char *filename) {
+    return std::string(filename) + ".tcache";
+}
+
+// the next mip level of w x h RGBA texels: each the average of those it
+// covers (two by two, three along an odd side), the color averaged in
+// linear light rather than as stored (sRGB), so that levels don't darken
+inline void DownsampleRgba(const vector<unsigned char> &src, int w, int h,
+                           vector<unsigned char> &dst, int &dw, int &dh) {
+    static float linear[256];
+    static std::once_flag once;
+    std::call_once(once, []() {
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.f;
+            linear[i] = c <= .04045f ? c / 12.92f : powf((c + .055f) / 1.055f, 2.4f);
+        }
+    });
+    auto Srgb = [](float c) {
+        c = c <= .0031308f ? 12.92f * c : 1.055f * powf(c, 1 / 2.4f) - .055f;
+        return (unsigned char) lroundf(255 * (c < 0 ? 0 : c > 1 ? 1 : c));
+    };
+    dw = w > 1 ? w / 2 : 1;
+    dh = h > 1 ? h / 2 : 1;
+    dst.resize(4 * (size_t) dw * dh);
+    int nw = dw, nh = dh;
+    ParallelFor(dh, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            int y0 = y * h / nh, y1 = ((y + 1) * h + nh - 1) / nh;
+            for (int x = 0; x < nw; x++) {
+                int x0 = x * w / nw, x1 = ((x + 1) * w + nw - 1) / nw;
+                float sum[4] = {0, 0, 0, 0};
+                for (int sy = y0; sy < y1; sy++)
+                    for (int sx = x0; sx < x1; sx++) {
+                        const unsigned char *t = &src[4 * ((size_t) sy * w + sx)];
+                        for (int k = 0; k < 3; k++)
+                            sum[k] += linear[t[k]];
+                        sum[3] += t[3];
+                    }
+                float n = (float) ((x1 - x0) * (y1 - y0));
+                unsigned char *d = &dst[4 * ((size_t) y * nw + x)];
+                for (int k = 0; k < 3; k++)
+                    d[k] = Srgb(sum[k] / n);
+                d[3] = (unsigned char) lroundf(sum[3] / n);
+            }
+        }
+    });
+}
+
+// decode filename and build every level: if compress, BC1 for an opaque
+// image (half a byte per texel) or BC3 if any alpha is below 255 (one
+// byte), else RGBA8
+inline bool BuildTexture(const char *filename, bool compress, TextureLevels &t) {
+    Image image;
+    if (!DecodeImage(filename, image) || !image.width || !image.height)
+        return false;
+    bool opaque = true;
+    for (size_t i = 3; i < image.pixels.size() && opaque; i += 4)
+        opaque = image.pixels[i] == 255;
+    t.format = !compress ? GL_RGBA8 :
+               opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    t.width = image.width;
+    t.height = image.height;
+    int nLevels = MipLevels(t.width, t.height);
+    t.levels.resize(nLevels);
+    vector<unsigned char> next;
+    int w = t.width, h = t.height;
+    for (int i = 0; i < nLevels; i++) {
+        if (i) {
+            int nw = 0, nh = 0;
+            DownsampleRgba(image.pixels, w, h, next, nw, nh);
+            image.pixels.swap(next);
+            w = nw;
+            h = nh;
+        }
+        if (!compress)
+            t.levels[i].assign(image.pixels.begin(), image.pixels.end());
+        else if (opaque)
+            CompressBC1(image.pixels.data(), w, h, t.levels[i]);
+        else
+            CompressBC3(image.pixels.data(), w, h, t.levels[i]);
+    }
+    return true;
+}
+
+// totals over the textures loaded through LoadCachedTexture, from any thread
+class TextureCacheStats {
+public:
+    int nBuilt = 0, nMapped = 0;
+    size_t rgbaBytes = 0, storedBytes = 0; // as RGBA8 with mipmaps, and as cached
+    double buildMs = 0, mapMs = 0;
+
+    void Add(bool built, size_t rgba, size_t stored, double ms) {
+        std::lock_guard<std::mutex> lock(mutex);
+        (built ? nBuilt : nMapped)++;
+        (built ? buildMs : mapMs) += ms;
+        rgbaBytes += rgba;
+        storedBytes += stored;
+    }
+
+    void Report() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!nBuilt && !nMapped)
+            return;
+        printf("texture cache: %d built (%.1f ms), %d mapped (%.1f ms); %.2f MB uploaded, "
+               "%.2f MB saved against RGBA8\n", nBuilt, buildMs, nMapped, mapMs,
+               storedBytes / (1024. * 1024.), (rgbaBytes - storedBytes) / (1024. * 1024.));
+    }
+
+private:
+    std::mutex mutex;
+};
+
+inline TextureCacheStats &TextureStats() {
+    static TextureCacheStats stats;
+    return stats;
+}
+
+// map the cached levels of filename; on first load (or if the image or
+// compress changed) build them and write the cache. compress should be
+// HaveS3tc(), found on the GL thread; this may run on any
+inline bool LoadCachedTexture(const char *filename, bool compress, TextureFile &file) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    uint64_t key = 0;
+    if (!TextureKey(filename, TextureOptionString(compress), key))
+        return false;
+    std::string cacheName = TextureCacheName(filename);
+    bool built = false;
+    if (!file.Map(cacheName.c_str(), key)) {
+        TextureLevels t;
+        if (!BuildTexture(filename, compress, t))
+            return false;
+        built = true;
+        if (!WriteTextureFile(cacheName.c_str(), key, t) || !file.Map(cacheName.c_str(), key)) {
+            printf("can't write %s, using uncached texture\n", cacheName.c_str());
+            file.Adopt(t);
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    size_t rgba = 0;
+    for (int i = 0; i < file.nLevels; i++)
+        rgba += 4 * (size_t) (file.width >> i > 0 ? file.width >> i : 1) *
+                (file.height >> i > 0 ? file.height >> i : 1);
+    TextureStats().Add(built, rgba, file.Bytes(), ms);
+    return true;
+}
+
+// in place of ReadTexture: a new texture of filename's cached levels, 0 if
+// unreadable; on the GL thread
+inline GLuint CachedTexture(const char *filename) {
+    TextureFile file;
+    if (!LoadCachedTexture(filename, HaveS3tc(), file)) {
+        printf("can't read %s\n", filename);
+        return 0;
+    }
+    return file.Upload();
+}
+
+// time loading filename as ReadTexture does (decode, upload RGBA8, generate
+// mipmaps) against mapping its cache and uploading the levels as stored,
+// each run through glFinish, best of repeats; on the GL thread
+inline void BenchmarkTextureCache(const char *filename, int repeats = 5) {
+    using Clock = std::chrono::steady_clock;
+    auto Ms = [](Clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+    };
+    TextureFile file;
+    bool compress = HaveS3tc();
+    if (!LoadCachedTexture(filename, compress, file)) {
+        printf("can't read %s\n", filename);
+        return;
+    }
+    int width = file.width, height = file.height;
+    GLenum format = file.format;
+    size_t stored = file.Bytes(), rgba = (size_t) width * height * 4 * 4 / 3;
+    std::string cacheName = TextureCacheName(filename);
+    uint64_t key = 0;
+    double decode = 1e9, cached = 1e9;
+    for (int r = 0; r < repeats; r++) {
+        Clock::time_point t = Clock::now();
+        GLuint name = 0;
+        ReadTexture(filename, &name);
+        glFinish();
+        decode = fmin(decode, Ms(t));
+        glDeleteTextures(1, &name);
+        t = Clock::now();
+        if (TextureKey(filename, TextureOptionString(compress), key) &&
+            file.Map(cacheName.c_str(), key))
+            name = file.Upload();
+        glFinish();
+        cached = fmin(cached, Ms(t));
+        glDeleteTextures(1, &name);
+        file.Release();
+    }
+    const char *formatName = format == GL_RGBA8 ? "RGBA8" :
+                             format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? "BC1" : "BC3";
+    printf("%s: %dx%d; decode and upload %.1f ms, %.2f MB; cached %s %.1f ms, %.2f MB; "
+           "saved %.1f ms, %.2f MB\n", filename, width, height, decode, rgba / (1024. * 1024.),
+           formatName, cached, stored / (1024. * 1024.), decode - cached,
+           ((double) rgba - stored) / (1024. * 1024.));
+}
+
+#endif
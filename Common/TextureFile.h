@@ -0,0 +1,236 @@
+// Author: Nadezhda Chernova
+// File: TextureFile.h
+// Date: 10/16/2026
+// Binary, memory-mapped cache of processed textures: every mip level, in
+// the format GL takes, keyed by a hash of the source file and options
+
+#ifndef TEXTURE_FILE_HDR
+#define TEXTURE_FILE_HDR
+
+#include "glad.h"
+#include "MappedFile.h"    // MappedFile, HashBytes, TempName, RenameReplacing
+#include "BlockCompress.h" // BlockLevelSize
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// S3TC formats, absent from core GL headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// bump whenever the layout or the processing baked into the files changes
+const uint32_t textureFileVersion = 1;
+
+// file layout: header, then each level, largest first
+struct TextureFileHeader {
+    char magic[4];                 // "TEXF"
+    uint32_t version;              // textureFileVersion
+    uint64_t key;                  // TextureKey of the source and options
+    uint32_t format;               // GL internal format
+    uint32_t width, height, levels;
+    uint32_t pad;
+    uint64_t offsets[16], sizes[16]; // per level, from the start of the file
+};
+
+// hash of the bytes of filename and the options its cache was built with;
+// false if the file can't be read
+inline bool TextureKey(const char *filename, const char *options, uint64_t &key) {
+    MappedFile file;
+    if (!file.Open(filename))
+        return false;
+    key = HashBytes(file.data, file.size);
+    key = HashBytes(options, strlen(options), key);
+    return true;
+}
+
+// true for the formats uploaded with glCompressedTexImage2D
+inline bool CompressedFormat(GLenum format) {
+    return format == GL_COMPRESSED_RG_RGTC2 || format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+           format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+// bytes of a w x h level of format, 0 if not a format the cache holds
+inline size_t TextureLevelSize(GLenum format, int w, int h) {
+    switch (format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return BlockLevelSize(w, h, 8);
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2: return BlockLevelSize(w, h, 16);
+        case GL_RGBA8: return 4 * (size_t) w * h;
+        case GL_RG8: return 2 * (size_t) w * h;
+        default: return 0;
+    }
+}
+
+// a mip chain built in memory, to be written to a file or uploaded as is
+class TextureLevels {
+public:
+    GLenum format = GL_RGBA8;
+    int width = 0, height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+
+    size_t Bytes() const {
+        size_t n = 0;
+        for (const std::vector<uint8_t> &l : levels)
+            n += l.size();
+        return n;
+    }
+};
+
+inline bool WriteTextureFile(const char *filename, uint64_t key, const TextureLevels &t) {
+    TextureFileHeader h;
+    memset(&h, 0, sizeof(h));
+    if (t.levels.size() > 16)
+        return false;
+    memcpy(h.magic, "TEXF", 4);
+    h.version = textureFileVersion;
+    h.key = key;
+    h.format = t.format;
+    h.width = t.width;
+    h.height = t.height;
+    h.levels = (uint32_t) t.levels.size();
+    uint64_t offset = sizeof(h);
+    for (uint32_t i = 0; i < h.levels; i++) {
+        h.offsets[i] = offset;
+        h.sizes[i] = t.levels[i].size();
+        offset += h.sizes[i];
+    }
+    // write to a temporary, then rename, so readers never map a partial file
+    std::string tmp = TempName(filename);
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (const std::vector<uint8_t> &l : t.levels)
+        ok = ok && fwrite(l.data(), 1, l.size(), f) == l.size();
+    ok = fclose(f) == 0 && ok;
+    if (ok)
+        ok = RenameReplacing(tmp.c_str(), filename);
+    if (!ok)
+        remove(tmp.c_str());
+    return ok;
+}
+
+// levels mapped from a texture file (or, if the file couldn't be written,
+// held in memory), uploaded level by level without conversion
+class TextureFile {
+public:
+    GLenum format = 0;
+    int width = 0, height = 0, nLevels = 0;
+
+    // map filename, false if missing, corrupt or not built from key; each
+    // level must lie within the file and be the size its format and
+    // dimensions call for
+    bool Map(const char *filename, uint64_t key) {
+        Release();
+        if (!file.Open(filename) || file.size < sizeof(TextureFileHeader)) {
+            Release();
+            return false;
+        }
+        const TextureFileHeader *h = (const TextureFileHeader *) file.data;
+        bool ok = !strncmp(h->magic, "TEXF", 4) && h->version == textureFileVersion &&
+                  h->key == key && h->levels >= 1 && h->levels <= 16 &&
+                  h->width >= 1 && h->width <= 1u << 16 && h->height >= 1 && h->height <= 1u << 16;
+        for (uint32_t i = 0; ok && i < h->levels; i++) {
+            int w = h->width >> i > 0 ? h->width >> i : 1, hi = h->height >> i > 0 ? h->height >> i : 1;
+            size_t expected = TextureLevelSize(h->format, w, hi);
+            // within the file, compared so that nothing can overflow
+            ok = expected && h->sizes[i] == expected && h->offsets[i] <= file.size &&
+                 h->sizes[i] <= file.size - h->offsets[i];
+        }
+        if (!ok) {
+            Release();
+            return false;
+        }
+        format = h->format;
+        width = h->width;
+        height = h->height;
+        nLevels = h->levels;
+        for (int i = 0; i < nLevels; i++) {
+            data[i] = (const uint8_t *) file.data + h->offsets[i];
+            sizes[i] = (size_t) h->sizes[i];
+        }
+        return true;
+    }
+
+    // keep levels in memory
+    void Adopt(TextureLevels &t) {
+        Release();
+        own.swap(t.levels);
+        format = t.format;
+        width = t.width;
+        height = t.height;
+        nLevels = (int) own.size() < 16 ? (int) own.size() : 16;
+        for (int i = 0; i < nLevels; i++) {
+            data[i] = own[i].data();
+            sizes[i] = own[i].size();
+        }
+    }
+
+    size_t Bytes() const {
+        size_t n = 0;
+        for (int i = 0; i < nLevels; i++)
+            n += sizes[i];
+        return n;
+    }
+
+    // a new texture with all levels, mipmapped and repeating; 0 if none
+    GLuint Upload() const {
+        if (!nLevels)
+            return 0;
+        GLuint t = 0;
+        glGenTextures(1, &t);
+        glBindTexture(GL_TEXTURE_2D, t);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int i = 0; i < nLevels; i++) {
+            int w = width >> i > 0 ? width >> i : 1, h = height >> i > 0 ? height >> i : 1;
+            if (CompressedFormat(format))
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, format, w, h, 0, (GLsizei) sizes[i], data[i]);
+            else
+                glTexImage2D(GL_TEXTURE_2D, i, format, w, h, 0, format == GL_RG8 ? GL_RG : GL_RGBA,
+                             GL_UNSIGNED_BYTE, data[i]);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, nLevels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        nLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        return t;
+    }
+
+    void Release() {
+        file.Close();
+        own.clear();
+        format = 0;
+        width = height = nLevels = 0;
+    }
+
+    TextureFile() {}
+    TextureFile(const TextureFile &) = delete;
+    TextureFile &operator=(const TextureFile &) = delete;
+
+private:
+    MappedFile file;
+    std::vector<std::vector<uint8_t>> own;
+    const uint8_t *data[16] = {};
+    size_t sizes[16] = {};
+};
+
+// levels to cover a w x h image down to 1 x 1
+inline int MipLevels(int w, int h) {
+    int n = 1;
+    while (w > 1 || h > 1) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        n++;
+    }
+    return n;
+}
+
+#endif
@@ -0,0 +1,154 @@
+// Author: Nadezhda Chernova
+// File: Timing.h
+// Date: 10/16/2026
+// Wall-clock time, fixed-step simulation with interpolation for drawing,
+// pause, scale and single-step controls, and frame time statistics
+
+#ifndef TIMING_HDR
+#define TIMING_HDR
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// monotonic seconds since the first call (wall time, unlike clock(), which
+// counts the process's CPU time)
+inline double Seconds() {
+    typedef std::chrono::steady_clock Clock;
+    static const Clock::time_point start = Clock::now();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// the last frames' times, in seconds
+class FrameStats {
+public:
+    static const int capacity = 256;
+
+    void Add(double seconds) {
+        if ((int) times.size() < capacity)
+            times.push_back(seconds);
+        else
+            times[next] = seconds;
+        next = (next + 1) % capacity;
+        nFrames++;
+    }
+
+    int Count() const { return (int) times.size(); }
+    double Min() const { return times.empty() ? 0 : *std::min_element(times.begin(), times.end()); }
+    double Max() const { return times.empty() ? 0 : *std::max_element(times.begin(), times.end()); }
+
+    double Avg() const {
+        double sum = 0;
+        for (double t : times)
+            sum += t;
+        return times.empty() ? 0 : sum / times.size();
+    }
+
+    // the time a fraction p (in [0, 1]) of frames take at most
+    double Percentile(double p) const {
+        if (times.empty())
+            return 0;
+        std::vector<double> sorted(times);
+        size_t i = std::min(sorted.size() - 1, (size_t) (p * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + i, sorted.end());
+        return sorted[i];
+    }
+
+    void Report(const char *name = "frames") const {
+        printf("%s: min %.2f, avg %.2f, p99 %.2f ms over the last %d of %ld\n", name, 1000 * Min(),
+               1000 * Avg(), 1000 * Percentile(.99), Count(), nFrames);
+    }
+
+private:
+    std::vector<double> times;
+    int next = 0;
+    long nFrames = 0;
+};
+
+// simulation time in fixed steps, however long frames take: each frame,
+// Tick returns the steps due, the app advances its state by step seconds
+// that many times, then draws between the last two states, Alpha of the
+// way (or at RenderTime, for state that is a function of time)
+class SimClock {
+public:
+    double step = 1 / 120.;    // simulated seconds per step
+    double scale = 1;          // simulated seconds per real second
+    int maxSteps = 12;         // per frame; beyond, time is dropped rather than caught up
+    bool paused = false;
+    double time = 0;           // simulated seconds, through the last step
+    FrameStats frames;         // real time between Ticks
+
+    // call once per frame; the number of steps due
+    int Tick() {
+        double now = Seconds();
+        if (ticked)
+            frames.Add(now - last);
+        double real = ticked ? now - last : 0;
+        last = now;
+        ticked = true;
+        if (!paused)
+            accumulator += real * scale;
+        int n = (int) (accumulator / step);
+        if (n > maxSteps) {
+            accumulator -= (n - maxSteps) * step;
+            n = maxSteps;
+        }
+        accumulator -= n * step;
+        // single steps, when paused, don't touch the accumulator
+        n += singleSteps;
+        singleSteps = 0;
+        time += n * step;
+        return n;
+    }
+
+    // fraction of a step past the last, in [0, 1)
+    double Alpha() const { return accumulator / step; }
+
+    // a step behind, so that drawing falls between two simulated states
+    double RenderTime() const { return std::max(0., time - step + Alpha() * step); }
+
+    void Pause(bool p) { paused = p; }
+    void SetScale(double s) { scale = std::max(1 / 64., std::min(64., s)); }
+
+    // one step on the next Tick, if paused
+    void Step() {
+        if (paused)
+            singleSteps++;
+    }
+
+private:
+    double last = 0, accumulator = 0;
+    bool ticked = false;
+    int singleSteps = 0;
+};
+
+// keys for a SimClock: space pauses, - and = halve and double speed, . steps
+// when paused, T prints frame times; true if k was one of them
+inline bool SimClockKey(SimClock &c, int k) {
+    if (k == ' ')
+        c.Pause(!c.paused);
+    else if (k == '-' || k == '=')
+        c.SetScale(k == '-' ? c.scale / 2 : c.scale * 2);
+    else if (k == '.')
+        c.Step();
+    else if (k == 'T')
+        c.frames.Report();
+    else
+        return false;
+    if (k != 'T')
+        printf("time %s, x%g\n", c.paused ? "paused" : "running", c.scale);
+    return true;
+}
+
+// the above, for a usage message
+inline const char *SimClockUsage() {
+    return R"(
+    Space: pause or resume animation
+    -/=: animate at half or double speed
+    .: step (when paused)
+    T: print frame times (min, average, 99th percentile)
+)";
+}
+
+#endif
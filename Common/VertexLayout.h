@@ -0,0 +1,365 @@
+// Author: Nadezhda Chernova
+// File: VertexLayout.h
+// Date: 10/16/2026
+// Vertex buffer formats: separate float arrays, or interleaved and quantized,
+// with attribute pointers set from a layout descriptor
+
+#ifndef VERTEX_LAYOUT_HDR
+#define VERTEX_LAYOUT_HDR
+
+#include "glad.h"
+#include "VecMat.h"    // vec2, vec3
+#include "Program.h"   // Program, Uniform
+#include "MeshCache.h" // CachedMesh
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// bytes per vertex are for point, normal and uv; a tangent adds 16 bytes
+// to Separate, 4 (packed 10:10:10:2) to the others
+enum class VertexFormat {
+    Separate,    // float arrays one after another, as in the mesh cache: 32 bytes
+    Interleaved, // float point, octahedral snorm16 normal, half float uv: 20 bytes
+    Quantized    // as Interleaved, with unorm16 points scaled to the mesh bounds: 16 bytes
+};
+
+// attribute locations shared by all programs, so a VAO set up once serves
+// any of them; vertex shaders declare, e.g., layout(location = 0) in vec3 point;
+// the tangent follows the instance attributes (4-8) and draw id (9)
+inline GLint AttribLocation(const char *name) {
+    static const char *names[] = {"point", "normal", "uv", "color", "tangent"};
+    static const GLint locations[] = {0, 1, 2, 3, 10};
+    for (int i = 0; i < 5; i++)
+        if (!strcmp(name, names[i]))
+            return locations[i];
+    return -1;
+}
+
+// one shader input: glVertexAttribPointer arguments other than the stride
+struct VertexAttrib {
+    const char *name;
+    GLint location;  // per AttribLocation
+    int size;        // components
+    GLenum type;     // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_SHORT, GL_INT_2_10_10_10_REV
+    bool normalized; // integers map to [0,1] or [-1,1]
+    size_t offset;   // from the start of the buffer
+};
+
+// bytes per component (a packed 10:10:10:2 attribute's four share 4 bytes)
+inline size_t AttribTypeSize(GLenum type) {
+    if (type == GL_INT_2_10_10_10_REV)
+        return 1;
+    return type == GL_FLOAT ? 4 : type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1 : 2;
+}
+
+// separate attribute format and binding (GL 4.3), not on macOS
+inline bool HaveAttribBinding() {
+#ifdef GL_VERSION_4_3
+    static bool have = glVertexAttribFormat && glVertexAttribBinding && glBindVertexBuffer;
+    return have;
+#else
+    return false;
+#endif
+}
+
+// how vertices are laid out in a VBO, and what the vertex shader needs to
+// undo quantization:
+//     uniform vec3 pointScale = vec3(1), pointOffset = vec3(0);
+//     uniform bool octNormals = false;
+//     vec3 p = pointOffset + pointScale * point;
+//     vec3 n = octNormals ? OctDecode(normal.xy) : normal;
+// with OctDecode from OctCode (see AddOctCode)
+class VertexLayout {
+public:
+    VertexFormat format = VertexFormat::Separate;
+    vector<VertexAttrib> attribs;
+    int stride = 0;                                      // 0 if not interleaved
+    size_t vertexSize = 0;                               // bytes per vertex
+    vec3 pointScale = vec3(1, 1, 1), pointOffset = vec3(0, 0, 0);
+    bool octNormals = false;
+
+    void Add(const char *name, int size, GLenum type, bool normalized, size_t offset) {
+        attribs.push_back({name, AttribLocation(name), size, type, normalized, offset});
+    }
+
+    // record the attributes, sourced from vbo, in the bound VAO, once, at
+    // upload; drawing then needs only the VAO bound
+    void Capture(GLuint vbo) const {
+#ifdef GL_VERSION_4_3
+        if (HaveAttribBinding()) {
+            // interleaved vertices share binding 0, separate arrays get one each
+            if (stride)
+                glBindVertexBuffer(0, vbo, 0, stride);
+            for (size_t i = 0; i < attribs.size(); i++) {
+                const VertexAttrib &a = attribs[i];
+                if (a.location < 0)
+                    continue;
+                GLuint binding = stride ? 0 : (GLuint) i;
+                if (!stride)
+                    glBindVertexBuffer(binding, vbo, a.offset, (GLsizei) (a.size * AttribTypeSize(a.type)));
+                glEnableVertexAttribArray(a.location);
+                glVertexAttribFormat(a.location, a.size, a.type, a.normalized ? GL_TRUE : GL_FALSE,
+                                     stride ? (GLuint) a.offset : 0);
+                glVertexAttribBinding(a.location, binding);
+            }
+            return;
+        }
+#endif
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        for (const VertexAttrib &a : attribs) {
+            if (a.location < 0)
+                continue;
+            glEnableVertexAttribArray(a.location);
+            glVertexAttribPointer(a.location, a.size, a.type, a.normalized ? GL_TRUE : GL_FALSE,
+                                  stride, (void *) a.offset);
+        }
+    }
+
+    // dequantization uniforms
+    void SetUniforms(const Program &program) const {
+        Resolve(program);
+        pointScaleU.Set(pointScale);
+        pointOffsetU.Set(pointOffset);
+        octNormalsU.Set((int) octNormals);
+    }
+
+private:
+    // uniforms in the program last used, from its reflection
+    mutable GLuint resolved = 0;
+    mutable Uniform<vec3> pointScaleU, pointOffsetU;
+    mutable Uniform<int> octNormalsU;
+
+    void Resolve(const Program &program) const {
+        if (resolved == program.id)
+            return;
+        resolved = program.id;
+        pointScaleU = program.GetUniform<vec3>("pointScale");
+        pointOffsetU = program.GetUniform<vec3>("pointOffset");
+        octNormalsU = program.GetUniform<int>("octNormals");
+    }
+};
+
+// IEEE half float, rounded to nearest even
+inline uint16_t FloatToHalf(float f) {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000, m = x & 0x7fffff;
+    int e = (int) ((x >> 23) & 0xff) - 127 + 15;
+    if (((x >> 23) & 0xff) == 0xff)
+        return (uint16_t) (sign | 0x7c00 | (m ? 0x200 : 0)); // inf, nan
+    if (e >= 31)
+        return (uint16_t) (sign | 0x7c00);                   // overflow to inf
+    if (e <= 0) {
+        // subnormal half, or zero
+        if (e < -10)
+            return (uint16_t) sign;
+        m |= 0x800000;
+        int shift = 14 - e;
+        uint32_t h = m >> shift, rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1)))
+            h++;
+        return (uint16_t) (sign | h);
+    }
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t h = ((uint32_t) e << 10) | (m >> 13), rem = m & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        h++;
+    return (uint16_t) (sign | h);
+}
+
+// the inverse, exact for every half
+inline float HalfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16, e = (h >> 10) & 0x1f, m = h & 0x3ff, x;
+    if (e == 31)
+        x = sign | 0x7f800000 | (m << 13);     // inf, nan
+    else if (e)
+        x = sign | ((e + 112) << 23) | (m << 13);
+    else {
+        float f = ldexpf((float) m, -24);       // subnormal, or zero
+        return sign ? -f : f;
+    }
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+}
+
+inline int16_t FloatToSnorm16(float f) {
+    f = f < -1 ? -1 : f > 1 ? 1 : f;
+    return (int16_t) lroundf(f * 32767);
+}
+
+// as a normalized GL_SHORT attribute reads
+inline float Snorm16ToFloat(int16_t s) {
+    return std::max(s / 32767.f, -1.f);
+}
+
+// octahedral encoding: project unit n onto the octahedron |x|+|y|+|z| = 1,
+// fold the lower half over the upper, keep x and y
+inline void OctEncode(const vec3 &n, int16_t e[2]) {
+    float s = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float x = s > 0 ? n.x / s : 0, y = s > 0 ? n.y / s : 0;
+    if (n.z < 0) {
+        float fx = (1 - fabsf(y)) * (x >= 0 ? 1 : -1), fy = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = fx;
+        y = fy;
+    }
+    e[0] = FloatToSnorm16(x);
+    e[1] = FloatToSnorm16(y);
+}
+
+// unfold, as OctDecode in OctCode does on the GPU
+inline vec3 OctDecode(const int16_t e[2]) {
+    vec3 n(Snorm16ToFloat(e[0]), Snorm16ToFloat(e[1]), 0);
+    n.z = 1 - fabsf(n.x) - fabsf(n.y);
+    float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0 ? -t : t;
+    n.y += n.y >= 0 ? -t : t;
+    return normalize(n);
+}
+
+// GLSL for octahedral normals: OctEncode as above (on a unit n), and
+// OctDecode, its inverse
+inline const char *OctCode() {
+    return R"(
+	vec2 OctEncode(vec3 n) {
+		n /= abs(n.x)+abs(n.y)+abs(n.z);
+		vec2 e = n.xy;
+		if (n.z < 0) e = (1-abs(n.yx))*vec2(e.x >= 0? 1 : -1, e.y >= 0? 1 : -1);
+		return e;
+	}
+	vec3 OctDecode(vec2 e) {
+		vec3 n = vec3(e, 1-abs(e.x)-abs(e.y));
+		float t = max(-n.z, 0);
+		n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+		return normalize(n);
+	}
+)";
+}
+
+// shader with OctCode after its #version line
+inline std::string AddOctCode(const char *shader) {
+    std::string s(shader);
+    size_t v = s.find("#version"), eol = v == std::string::npos ? 0 : s.find('\n', v);
+    s.insert(eol == std::string::npos ? s.size() : eol + 1, OctCode());
+    return s;
+}
+
+// tangent xyz as signed 10-bit, handedness w as signed 2-bit (1 or -1),
+// packed for a normalized GL_INT_2_10_10_10_REV attribute
+inline uint32_t PackTangent(const vec4 &t) {
+    uint32_t p = 0;
+    for (int k = 0; k < 3; k++) {
+        float f = t[k] < -1 ? -1 : t[k] > 1 ? 1 : t[k];
+        p |= ((uint32_t) lroundf(f * 511) & 0x3ff) << (10 * k);
+    }
+    return p | (t.w < 0 ? 3u : 1u) << 30;
+}
+
+// layout of the mesh cache's vertex block
+inline VertexLayout SeparateLayout(int nPoints, bool normals, bool uvs, bool tangents = false) {
+    VertexLayout l;
+    l.format = VertexFormat::Separate;
+    size_t normalsSize = normals ? sizeof(vec3) : 0, uvsSize = uvs ? sizeof(vec2) : 0;
+    l.vertexSize = sizeof(vec3) + normalsSize + uvsSize + (tangents ? sizeof(vec4) : 0);
+    l.Add("point", 3, GL_FLOAT, false, 0);
+    if (normals)
+        l.Add("normal", 3, GL_FLOAT, false, nPoints * sizeof(vec3));
+    if (uvs)
+        l.Add("uv", 2, GL_FLOAT, false, nPoints * (sizeof(vec3) + normalsSize));
+    if (tangents)
+        l.Add("tangent", 4, GL_FLOAT, false, nPoints * (sizeof(vec3) + normalsSize + uvsSize));
+    return l;
+}
+
+// interleave points, normals, uvs and tangents (all but points may be NULL)
+// into vertices, per format (Interleaved or Quantized); return the layout
+inline VertexLayout PackVertices(const vec3 *points, const vec3 *normals, const vec2 *uvs,
+                                 int nPoints, VertexFormat format, vector<char> &vertices,
+                                 const vec4 *tangents = NULL) {
+    VertexLayout l;
+    l.format = format;
+    bool quantize = format == VertexFormat::Quantized;
+    // point: 3 unorm16 padded to 8 bytes, or 3 floats
+    size_t pointSize = quantize ? 4 * sizeof(uint16_t) : sizeof(vec3);
+    size_t normalOffset = pointSize, uvOffset = normalOffset + (normals ? 2 * sizeof(int16_t) : 0);
+    size_t tangentOffset = uvOffset + (uvs ? 2 * sizeof(uint16_t) : 0);
+    l.vertexSize = tangentOffset + (tangents ? sizeof(uint32_t) : 0);
+    l.stride = (int) l.vertexSize;
+    l.Add("point", 3, quantize ? GL_UNSIGNED_SHORT : GL_FLOAT, quantize, 0);
+    if (normals) {
+        l.Add("normal", 2, GL_SHORT, true, normalOffset);
+        l.octNormals = true;
+    }
+    if (uvs)
+        l.Add("uv", 2, GL_HALF_FLOAT, false, uvOffset);
+    if (tangents)
+        l.Add("tangent", 4, GL_INT_2_10_10_10_REV, true, tangentOffset);
+    // bounds map to [0,1], the range of a normalized unorm16
+    vec3 lo(0, 0, 0), hi(0, 0, 0);
+    if (quantize && nPoints) {
+        lo = hi = points[0];
+        for (int i = 1; i < nPoints; i++)
+            for (int k = 0; k < 3; k++) {
+                lo[k] = std::min(lo[k], points[i][k]);
+                hi[k] = std::max(hi[k], points[i][k]);
+            }
+        l.pointOffset = lo;
+        for (int k = 0; k < 3; k++)
+            l.pointScale[k] = hi[k] > lo[k] ? hi[k] - lo[k] : 1;
+    }
+    vertices.assign(nPoints * l.vertexSize, 0);
+    for (int i = 0; i < nPoints; i++) {
+        char *v = &vertices[i * l.vertexSize];
+        if (quantize) {
+            uint16_t q[4] = {0, 0, 0, 0};
+            for (int k = 0; k < 3; k++)
+                q[k] = (uint16_t) lroundf((points[i][k] - lo[k]) / l.pointScale[k] * 65535);
+            memcpy(v, q, sizeof(q));
+        }
+        else
+            memcpy(v, &points[i], sizeof(vec3));
+        if (normals) {
+            int16_t e[2];
+            OctEncode(normals[i], e);
+            memcpy(v + normalOffset, e, sizeof(e));
+        }
+        if (uvs) {
+            uint16_t h[2] = {FloatToHalf(uvs[i].x), FloatToHalf(uvs[i].y)};
+            memcpy(v + uvOffset, h, sizeof(h));
+        }
+        if (tangents) {
+            uint32_t t = PackTangent(tangents[i]);
+            memcpy(v + tangentOffset, &t, sizeof(t));
+        }
+    }
+    return l;
+}
+
+// copy mesh vertices, per format, to the bound GL_ARRAY_BUFFER
+inline VertexLayout BufferMeshVertices(const CachedMesh &mesh, VertexFormat format) {
+    if (format == VertexFormat::Separate) {
+        // the mapped cache block as is
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertexSize, mesh.vertices, GL_STATIC_DRAW);
+        return SeparateLayout(mesh.nPoints, mesh.normals != NULL, mesh.uvs != NULL,
+                              mesh.tangents != NULL);
+    }
+    vector<char> vertices;
+    VertexLayout l = PackVertices(mesh.points, mesh.normals, mesh.uvs, mesh.nPoints, format,
+                                  vertices, mesh.tangents);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+    return l;
+}
+
+// -separate, -interleaved or -quantized among command-line arguments, else fallback
+inline VertexFormat VertexFormatArg(int ac, char **av, VertexFormat fallback = VertexFormat::Quantized) {
+    for (int i = 1; i < ac; i++) {
+        if (!strcmp(av[i], "-separate")) return VertexFormat::Separate;
+        if (!strcmp(av[i], "-interleaved")) return VertexFormat::Interleaved;
+        if (!strcmp(av[i], "-quantized")) return VertexFormat::Quantized;
+    }
+    return fallback;
+}
+
+#endif
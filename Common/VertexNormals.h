@@ -0,0 +1,147 @@
+// Author: Nadezhda Chernova
+// File: VertexNormals.h
+// Date: 10/16/2026
+// Parallel, SIMD replacement for SetVertexNormals
+
+#ifndef VERTEX_NORMALS_HDR
+#define VERTEX_NORMALS_HDR
+
+#include "VecMat.h"   // vec3, int3
+#include "Parallel.h" // ParallelFor, ThreadCount
+#include "Simd.h"     // f4, vec3x4
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// how face normals are weighted when summed at a vertex
+enum class NormalWeight {
+    Uniform, // unit face normals, as SetVertexNormals
+    Area,    // face normals scaled by triangle area
+    Angle    // unit face normals scaled by the corner angle at the vertex
+};
+
+// vertex normal = normalized sum of adjacent face normals; runs in three
+// parallel passes without atomics:
+//   faces: face normals (and corner angles), four triangles per SIMD step
+//   bucket: triangle corners are counting-sorted into buckets of vertices
+//   gather: each thread sums the corners of its buckets, then normalizes;
+// corners stay in triangle order within a bucket, so each vertex sum is
+// formed in the same order as the serial routine
+inline void SetVertexNormalsParallel(const vec3 *points, int nPoints, const int3 *triangles,
+                                     int nTriangles, vector<vec3> &normals,
+                                     NormalWeight weight = NormalWeight::Uniform,
+                                     int nThreads = 0) {
+    nThreads = ThreadCount(nThreads);
+    normals.assign(nPoints, vec3(0, 0, 0));
+    if (!nPoints || !nTriangles)
+        return;
+    // structure of arrays: face normals padded to a multiple of four, and,
+    // for angle weighting, three corner angles per face
+    int nFaces4 = (nTriangles + 3) & ~3;
+    vector<float> fx(nFaces4), fy(nFaces4), fz(nFaces4);
+    vector<float> angles(weight == NormalWeight::Angle ? 3 * (size_t) nFaces4 : 0);
+    ParallelFor(nFaces4 / 4, [&](int, int begin, int end) {
+        float p[3][3][4]; // [corner][axis][lane]
+        for (int b = begin; b < end; b++) {
+            for (int lane = 0; lane < 4; lane++) {
+                int f = 4 * b + lane;
+                for (int c = 0; c < 3; c++) {
+                    const vec3 &v = f < nTriangles ? points[triangles[f][c]] : points[0];
+                    for (int k = 0; k < 3; k++)
+                        p[c][k][lane] = v[k];
+                }
+            }
+            vec3x4 p1(f4::Load(p[0][0]), f4::Load(p[0][1]), f4::Load(p[0][2]));
+            vec3x4 p2(f4::Load(p[1][0]), f4::Load(p[1][1]), f4::Load(p[1][2]));
+            vec3x4 p3(f4::Load(p[2][0]), f4::Load(p[2][1]), f4::Load(p[2][2]));
+            vec3x4 n = Cross(p2 - p1, p3 - p2);
+            if (weight != NormalWeight::Area)
+                n = Normalize(n);
+            n.x.Store(&fx[4 * b]);
+            n.y.Store(&fy[4 * b]);
+            n.z.Store(&fz[4 * b]);
+            if (weight == NormalWeight::Angle) {
+                // unit edges leaving each corner; angle = acos of their dot
+                vec3x4 e12 = Normalize(p2 - p1), e23 = Normalize(p3 - p2), e31 = Normalize(p1 - p3);
+                f4 cosines[] = {f4(0) - Dot(e12, e31), f4(0) - Dot(e23, e12), f4(0) - Dot(e31, e23)};
+                for (int c = 0; c < 3; c++) {
+                    float cs[4];
+                    cosines[c].Store(cs);
+                    for (int lane = 0; lane < 4; lane++)
+                        angles[3 * (4 * b + lane) + c] = acosf(cs[lane] < -1 ? -1 : cs[lane] > 1 ? 1 : cs[lane]);
+                }
+            }
+        }
+    }, nThreads);
+    // counting sort of corners into vertex buckets; each thread counts its
+    // triangles' corners per bucket, prefix sums give each (bucket, thread)
+    // a private output range
+    int nBuckets = std::min(nPoints, 4 * nThreads);
+    auto Bucket = [nPoints, nBuckets](int v) { return (int) ((int64_t) v * nBuckets / nPoints); };
+    vector<vector<int64_t>> counts(nThreads, vector<int64_t>(nBuckets + 1, 0));
+    ParallelFor(nTriangles, [&](int t, int begin, int end) {
+        for (int f = begin; f < end; f++)
+            for (int c = 0; c < 3; c++)
+                counts[t][Bucket(triangles[f][c])]++;
+    }, nThreads);
+    vector<int64_t> bucketStart(nBuckets + 1, 0);
+    int64_t offset = 0;
+    for (int b = 0; b < nBuckets; b++) {
+        bucketStart[b] = offset;
+        for (int t = 0; t < nThreads; t++) {
+            int64_t n = counts[t][b];
+            counts[t][b] = offset;
+            offset += n;
+        }
+    }
+    bucketStart[nBuckets] = offset;
+    // corner = vertex and 3*face+corner
+    vector<std::pair<int, int>> corners(3 * (size_t) nTriangles);
+    ParallelFor(nTriangles, [&](int t, int begin, int end) {
+        for (int f = begin; f < end; f++)
+            for (int c = 0; c < 3; c++) {
+                int v = triangles[f][c];
+                corners[counts[t][Bucket(v)]++] = std::make_pair(v, 3 * f + c);
+            }
+    }, nThreads);
+    // sum per vertex; a bucket's vertices belong to one thread only
+    vector<float> nx(nPoints + 4, 0), ny(nPoints + 4, 0), nz(nPoints + 4, 0);
+    ParallelFor(nBuckets, [&](int, int begin, int end) {
+        for (int64_t i = bucketStart[begin]; i < bucketStart[end]; i++) {
+            int v = corners[i].first, fc = corners[i].second, f = fc / 3;
+            if (weight == NormalWeight::Angle) {
+                float a = angles[fc];
+                nx[v] += a * fx[f];
+                ny[v] += a * fy[f];
+                nz[v] += a * fz[f];
+            }
+            else {
+                nx[v] += fx[f];
+                ny[v] += fy[f];
+                nz[v] += fz[f];
+            }
+        }
+    }, nThreads);
+    // normalize, four at a time
+    ParallelFor((nPoints + 3) / 4, [&](int, int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            vec3x4 n = Normalize(vec3x4(f4::Load(&nx[4 * b]), f4::Load(&ny[4 * b]), f4::Load(&nz[4 * b])));
+            float x[4], y[4], z[4];
+            n.x.Store(x);
+            n.y.Store(y);
+            n.z.Store(z);
+            for (int lane = 0; lane < 4 && 4 * b + lane < nPoints; lane++)
+                normals[4 * b + lane] = vec3(x[lane], y[lane], z[lane]);
+        }
+    }, nThreads);
+}
+
+// same arguments as SetVertexNormals
+inline void SetVertexNormalsParallel(vector<vec3> &points, vector<int3> &triangles,
+                                     vector<vec3> &normals,
+                                     NormalWeight weight = NormalWeight::Uniform) {
+    SetVertexNormalsParallel(points.data(), (int) points.size(), triangles.data(),
+                             (int) triangles.size(), normals, weight);
+}
+
+#endif
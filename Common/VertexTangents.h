@@ -0,0 +1,149 @@
+// Author: Nadezhda Chernova
+// File: VertexTangents.h
+// Date: 10/16/2026
+// Per-vertex tangent frames for normal and bump mapping, as MikkTSpace
+// computes them, found in parallel at mesh load
+
+#ifndef VERTEX_TANGENTS_HDR
+#define VERTEX_TANGENTS_HDR
+
+#include "VecMat.h"   // vec2, vec3, vec4, int3
+#include "Parallel.h" // ParallelFor, ThreadCount
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// a tangent perpendicular to unit n, for vertices whose uvs give none
+inline vec3 AnyTangent(const vec3 &n) {
+    vec3 a = fabsf(n.x) < .9f ? vec3(1, 0, 0) : vec3(0, 1, 0);
+    return normalize(a - n * dot(a, n));
+}
+
+// tangent xyz (the direction of increasing u, in the plane of the vertex
+// normal) and handedness w (1 or -1), so that the bitangent is
+//     w * cross(normal, tangent)
+// as MikkTSpace defines them, without its optional splitting of vertices at
+// sharp tangent changes. Each corner contributes its triangle's tangent,
+// projected on the vertex normal's plane and weighted by the corner angle
+// there. Vertices already differ across uv seams; a vertex shared by
+// triangles of both orientations in uv (on the line of a mirrored uv
+// layout) is split, the copy taking the triangles mapped mirrored, so that
+// the two frames are not averaged. Triangles with no uv area contribute
+// nothing. Per-triangle and per-vertex passes run in parallel; returns the
+// number of vertices split (appended to points, normals and uvs)
+inline int SetVertexTangentsParallel(vector<vec3> &points, vector<vec3> &normals,
+                                     vector<vec2> &uvs, vector<int3> &triangles,
+                                     vector<vec4> &tangents, int nThreads = 0) {
+    nThreads = ThreadCount(nThreads);
+    int nPoints = (int) points.size(), nTriangles = (int) triangles.size();
+    tangents.clear();
+    if (!nPoints || (int) normals.size() != nPoints || (int) uvs.size() != nPoints)
+        return 0;
+    // per triangle: orientation in uv (1, -1, or 0 if degenerate); per
+    // corner: the projected tangent, weighted by angle
+    vector<int8_t> orientation(nTriangles);
+    vector<vec3> corners(3 * (size_t) nTriangles);
+    ParallelFor(nTriangles, [&](int, int begin, int end) {
+        for (int f = begin; f < end; f++) {
+            const int3 &t = triangles[f];
+            vec3 d1 = points[t[1]] - points[t[0]], d2 = points[t[2]] - points[t[0]];
+            vec2 t21 = uvs[t[1]] - uvs[t[0]], t31 = uvs[t[2]] - uvs[t[0]];
+            float area = t21.x * t31.y - t21.y * t31.x; // twice the signed uv area
+            vec3 os = d1 * t31.y - d2 * t21.y;
+            float len = length(os);
+            bool degenerate = fabsf(area) < 1e-20f || len < 1e-20f;
+            orientation[f] = degenerate ? 0 : area > 0 ? 1 : -1;
+            if (!degenerate)
+                os = os * ((area > 0 ? 1 : -1) / len);
+            for (int c = 0; c < 3; c++) {
+                corners[3 * f + c] = vec3(0, 0, 0);
+                if (degenerate)
+                    continue;
+                int v = t[c];
+                vec3 n = normalize(normals[v]); // as read, normals may not be unit
+                // edges leaving the corner and tangent, in the normal's plane
+                vec3 e1 = points[t[(c + 1) % 3]] - points[v], e2 = points[t[(c + 2) % 3]] - points[v];
+                e1 = e1 - n * dot(n, e1);
+                e2 = e2 - n * dot(n, e2);
+                vec3 ts = os - n * dot(n, os);
+                float l1 = length(e1), l2 = length(e2), ls = length(ts);
+                if (l1 < 1e-20f || l2 < 1e-20f || ls < 1e-20f)
+                    continue;
+                float cosine = dot(e1, e2) / (l1 * l2);
+                float angle = acosf(cosine < -1 ? -1 : cosine > 1 ? 1 : cosine);
+                corners[3 * f + c] = ts * (angle / ls);
+            }
+        }
+    }, nThreads);
+    // corners per vertex (counting sort)
+    vector<int> start(nPoints + 1, 0), cornerList(3 * (size_t) nTriangles);
+    for (const int3 &t : triangles)
+        for (int c = 0; c < 3; c++)
+            start[t[c] + 1]++;
+    for (int v = 0; v < nPoints; v++)
+        start[v + 1] += start[v];
+    vector<int> next(start.begin(), start.end() - 1);
+    for (int f = 0; f < nTriangles; f++)
+        for (int c = 0; c < 3; c++)
+            cornerList[next[triangles[f][c]]++] = 3 * f + c;
+    // sum each vertex's corners by orientation; split if it has both
+    vector<vec3> positive(nPoints), negative(nPoints);
+    vector<int8_t> sides(nPoints); // bit 0: positive corners, bit 1: negative
+    ParallelFor(nPoints, [&](int, int begin, int end) {
+        for (int v = begin; v < end; v++) {
+            vec3 p(0, 0, 0), m(0, 0, 0);
+            int8_t s = 0;
+            for (int i = start[v]; i < start[v + 1]; i++) {
+                int fc = cornerList[i], o = orientation[fc / 3];
+                if (o > 0) {
+                    p = p + corners[fc];
+                    s |= 1;
+                }
+                if (o < 0) {
+                    m = m + corners[fc];
+                    s |= 2;
+                }
+            }
+            positive[v] = p;
+            negative[v] = m;
+            sides[v] = s;
+        }
+    }, nThreads);
+    vector<int> copy(nPoints, -1);
+    for (int v = 0; v < nPoints; v++)
+        if (sides[v] == 3) {
+            copy[v] = (int) points.size();
+            points.push_back(points[v]);
+            normals.push_back(normals[v]);
+            uvs.push_back(uvs[v]);
+        }
+    int nSplit = (int) points.size() - nPoints;
+    // mirrored triangles to the copies
+    if (nSplit)
+        ParallelFor(nTriangles, [&](int, int begin, int end) {
+            for (int f = begin; f < end; f++)
+                if (orientation[f] < 0)
+                    for (int c = 0; c < 3; c++)
+                        if (copy[triangles[f][c]] >= 0)
+                            triangles[f][c] = copy[triangles[f][c]];
+        }, nThreads);
+    // normalize: a vertex with only mirrored corners is left-handed
+    tangents.resize(points.size());
+    auto Frame = [&normals](const vec3 &sum, int v, float w) {
+        float len = length(sum);
+        return vec4(len > 1e-20f ? sum * (1 / len) : AnyTangent(normalize(normals[v])), w);
+    };
+    ParallelFor(nPoints, [&](int, int begin, int end) {
+        for (int v = begin; v < end; v++) {
+            if (sides[v] == 2)
+                tangents[v] = Frame(negative[v], v, -1);
+            else
+                tangents[v] = Frame(positive[v], v, 1);
+            if (copy[v] >= 0)
+                tangents[copy[v]] = Frame(negative[v], v, -1);
+        }
+    }, nThreads);
+    return nSplit;
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Author: Nadezhda Chernova
+// File: WorkerPool.h
+// Date: 10/16/2026
+// Threads that run queued tasks in the background
+
+#ifndef WORKER_POOL_HDR
+#define WORKER_POOL_HDR
+
+#include "Parallel.h" // ThreadCount, ThreadLimit
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// tasks run in the order queued, on whichever thread is free; the cores
+// are shared among the threads, so a task's ParallelFor gets its share
+// rather than a thread per core. The destructor drops tasks not yet started
+// and joins once those running finish
+class WorkerPool {
+public:
+    WorkerPool(int nThreads = 0) {
+        nThreads = ThreadCount(nThreads);
+        int share = std::max(1, ThreadCount() / nThreads);
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back([this, share]() {
+                ThreadLimit() = share;
+                Work();
+            });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+            tasks.clear();
+        }
+        wake.notify_all();
+        for (std::thread &t : threads)
+            t.join();
+    }
+
+    void Run(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+
+    void Work() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return quit || !tasks.empty(); });
+                if (quit)
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+#endif